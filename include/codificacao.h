@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ---------------------------------------------------------------
+// CODIFICAÇÃO DE URL E JSON EM UMA PASSADA
+// ---------------------------------------------------------------
+// Classe de cada caractere ASCII para os codificadores de uma passada (URL e JSON).
+// Bytes a partir de 0x80 (UTF-8, emojis) são codificados na URL e copiados no JSON.
+// Fica fora do firmware para o teste e o benchmark no PC (test/test_codificacao).
+const uint8_t URL_LIVRE = 1;            // Não reservado (RFC 3986): copiado como está
+const uint8_t MARKDOWN_RESERVADO = 2;   // Precisa de '\' antes no MarkdownV2 do Telegram
+const uint8_t JSON_ESCAPE = 4;          // Precisa de escape em uma string JSON
+const uint8_t classeCaractere[128] = {
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x00  controles
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  // 0x10  controles
+  0, 2, 4, 2, 0, 0, 0, 0, 2, 2, 2, 2, 0, 3, 3, 0,  // 0x20  ! " # ( ) * + - .
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 2, 2, 0,  // 0x30  0-9 = >
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x40  A-O
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 6, 2, 0, 3,  // 0x50  P-Z [ \ ] _
+  2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // 0x60  ` a-o
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 3, 0,  // 0x70  p-z { | } ~
+};
+
+// Codifica o texto para uma query string em uma única passada, com o escape do
+// MarkdownV2 opcional na mesma passada ("a.b" vira "a%5C.b"). Escreve em destino
+// (terminado em '\0', sem cortar uma sequência ao meio) e, como o snprintf, devolve
+// o tamanho completo da saída: com destino nullptr só mede.
+inline size_t codificarUrl(const char* texto, char* destino, size_t capacidade, bool escaparMarkdown) {
+  static const char hex[] = "0123456789ABCDEF";
+  size_t tamanho = 0;
+  size_t escrito = 0;
+  bool cheio = destino == nullptr || capacidade == 0;
+  for (const uint8_t* c = (const uint8_t*)texto; *c != '\0'; c++) {
+    uint8_t classe = *c < 0x80 ? classeCaractere[*c] : 0;
+    char saida[6];
+    size_t n = 0;
+    if (escaparMarkdown && (classe & MARKDOWN_RESERVADO)) {
+      saida[n++] = '%';
+      saida[n++] = '5';
+      saida[n++] = 'C';
+    }
+    if (classe & URL_LIVRE) {
+      saida[n++] = *c;
+    } else {
+      saida[n++] = '%';
+      saida[n++] = hex[*c >> 4];
+      saida[n++] = hex[*c & 0x0F];
+    }
+    if (!cheio && escrito + n < capacidade) {
+      memcpy(destino + escrito, saida, n);
+      escrito += n;
+    } else {
+      cheio = true;
+    }
+    tamanho += n;
+  }
+  if (destino != nullptr && capacidade > 0) {
+    destino[escrito] = '\0';
+  }
+  return tamanho;
+}
+
+// Codifica o texto como conteúdo de uma string JSON (sem as aspas), com o escape do
+// MarkdownV2 opcional na mesma passada, e o entrega a escreverTls(*escrita, ...) (no
+// firmware, a escrita em blocos do socket TLS): os trechos que não precisam de escape
+// saem de uma vez, não byte a byte. Devolve o tamanho da saída; com escrita nullptr
+// só mede (para o Content-Length).
+template <typename Escrita>
+size_t codificarJson(const char* texto, Escrita* escrita, bool escaparMarkdown) {
+  static const char hex[] = "0123456789ABCDEF";
+  size_t tamanho = 0;
+  const uint8_t* inicioTrecho = (const uint8_t*)texto;  // Início do trecho copiado como está
+  const uint8_t* c = inicioTrecho;
+  for (; *c != '\0'; c++) {
+    uint8_t classe = *c < 0x80 ? classeCaractere[*c] : 0;
+    bool markdown = escaparMarkdown && (classe & MARKDOWN_RESERVADO);
+    if (!markdown && !(classe & JSON_ESCAPE)) {
+      tamanho++;
+      continue;
+    }
+    if (escrita != nullptr && c > inicioTrecho) {
+      escreverTls(*escrita, (const char*)inicioTrecho, c - inicioTrecho);
+    }
+    inicioTrecho = c + 1;
+
+    char saida[8];
+    size_t n = 0;
+    if (markdown) {
+      saida[n++] = '\\';  // A barra do MarkdownV2, escapada para o JSON
+      saida[n++] = '\\';
+    }
+    if (!(classe & JSON_ESCAPE)) {
+      saida[n++] = *c;
+    } else if (*c == '"' || *c == '\\') {
+      saida[n++] = '\\';
+      saida[n++] = *c;
+    } else if (*c == '\n') {
+      saida[n++] = '\\';
+      saida[n++] = 'n';
+    } else {
+      memcpy(saida + n, "\\u00", 4);
+      n += 4;
+      saida[n++] = hex[*c >> 4];
+      saida[n++] = hex[*c & 0x0F];
+    }
+    if (escrita != nullptr) {
+      escreverTls(*escrita, saida, n);
+    }
+    tamanho += n;
+  }
+  if (escrita != nullptr && c > inicioTrecho) {
+    escreverTls(*escrita, (const char*)inicioTrecho, c - inicioTrecho);
+  }
+  return tamanho;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// ---------------------------------------------------------------
+// CONTROLE DE IRRIGAÇÃO (MÁQUINA DE ESTADOS DA BOMBA)
+// ---------------------------------------------------------------
+// Só as decisões e as transições: histerese, tempo máximo ligada e repouso mínimo.
+// Nada aqui toca no relé, nos sensores ou no Telegram; atualizarIrrigacaoZona()
+// executa a ação devolvida por decidirIrrigacao(), e ligarBomba()/desligarBomba()
+// registram a transição com registrarBombaLigada()/registrarBombaDesligada(). Assim a
+// mesma lógica roda no PC contra um modelo de solo e bomba (test/test_irrigacao,
+// "pio test -e native").
+//
+// Os tempos são uint32_t em ms, a largura do millis() do ESP32: as subtrações dão a
+// volta a cada ~49 dias do mesmo jeito no firmware e no PC.
+
+enum EstadoBomba {
+  BOMBA_DESLIGADA,   // Relé desligado e pronta para ligar
+  BOMBA_LIGADA,      // Relé ligado
+  BOMBA_REPOUSO      // Relé desligado, aguardando o tempo mínimo antes de religar
+};
+
+enum OrigemBomba {
+  ORIGEM_MANUAL,     // Web, Telegram
+  ORIGEM_AUTOMATICA  // Controle por umidade do solo
+};
+
+// O que a máquina de estados deve fazer agora
+enum AcaoIrrigacao {
+  ACAO_NENHUMA,
+  ACAO_LIGAR,                 // Automático: solo abaixo do limite de ligar
+  ACAO_DESLIGAR_ALVO,         // Automático: umidade alvo atingida
+  ACAO_DESLIGAR_SEM_LEITURA,  // Automático: sensores de solo sem leitura com a bomba ligada
+  ACAO_DESLIGAR_TEMPO,        // Duração programada (no máximo tempoMaximoLigada) esgotada
+  ACAO_FIM_REPOUSO            // Repouso mínimo cumprido: pode religar
+};
+
+// Estado e parâmetros da irrigação de uma zona
+struct Irrigacao {
+  EstadoBomba estado;
+  OrigemBomba origem;
+  uint32_t inicioEstado;               // millis() da última transição de estado
+  uint32_t ultimaLeituraSolo;          // millis() da última leitura do solo com a bomba ligada
+  bool modoAutomatico;                 // Liga/desliga a bomba pela umidade do solo
+  float limiteLigar;                   // Liga quando a umidade média do solo fica abaixo deste valor (%)
+  float limiteDesligar;                // Desliga quando a umidade média do solo atinge este valor (%)
+  uint32_t tempoMaximoLigada;          // Tempo máximo de funcionamento contínuo (ms)
+  uint32_t tempoMinimoDesligada;       // Repouso mínimo entre dois acionamentos (ms)
+  uint32_t duracaoProgramada;          // Duração do acionamento atual (ms, até tempoMaximoLigada)
+  AcaoIrrigacao motivoDesligamento;    // Último desligamento (ACAO_NENHUMA = pedido manual)
+};
+
+const uint32_t intervaloLeituraSoloIrrigando = 2000; // Com a bomba ligada, lê o solo a cada 2 s
+
+// Com a bomba ligada pelo automático, o solo é amostrado com mais frequência para parar no alvo
+inline bool leituraSoloDevida(const Irrigacao& irrigacao, uint32_t agora) {
+  return irrigacao.estado == BOMBA_LIGADA && irrigacao.origem == ORIGEM_AUTOMATICA &&
+         agora - irrigacao.ultimaLeituraSolo >= intervaloLeituraSoloIrrigando;
+}
+
+// Próxima ação para o estado atual. soloLido indica que a umidade acabou de ser lida
+// (porque leituraSoloDevida() pediu); com a bomba ligada só leituras novas a desligam.
+// umidadeSolo NAN ou leituraValida false nunca ligam a bomba.
+inline AcaoIrrigacao decidirIrrigacao(const Irrigacao& irrigacao, uint32_t agora,
+                                      bool soloLido, bool leituraValida, float umidadeSolo) {
+  uint32_t decorrido = agora - irrigacao.inicioEstado;
+  switch (irrigacao.estado) {
+    case BOMBA_LIGADA:
+      if (decorrido >= irrigacao.duracaoProgramada) {
+        return ACAO_DESLIGAR_TEMPO;
+      }
+      if (soloLido) {
+        if (!leituraValida || isnan(umidadeSolo)) {
+          return ACAO_DESLIGAR_SEM_LEITURA;
+        }
+        if (umidadeSolo >= irrigacao.limiteDesligar) {
+          return ACAO_DESLIGAR_ALVO;
+        }
+      }
+      return ACAO_NENHUMA;
+
+    case BOMBA_REPOUSO:
+      return decorrido >= irrigacao.tempoMinimoDesligada ? ACAO_FIM_REPOUSO : ACAO_NENHUMA;
+
+    case BOMBA_DESLIGADA:
+    default:
+      if (irrigacao.modoAutomatico && leituraValida && !isnan(umidadeSolo) &&
+          umidadeSolo < irrigacao.limiteLigar) {
+        return ACAO_LIGAR;
+      }
+      return ACAO_NENHUMA;
+  }
+}
+
+// Tempo de repouso que ainda falta para religar (0 fora do repouso)
+inline uint32_t repousoRestante(const Irrigacao& irrigacao, uint32_t agora) {
+  uint32_t decorrido = agora - irrigacao.inicioEstado;
+  if (irrigacao.estado != BOMBA_REPOUSO || decorrido >= irrigacao.tempoMinimoDesligada) {
+    return 0;
+  }
+  return irrigacao.tempoMinimoDesligada - decorrido;
+}
+
+// Bomba ligada em "agora": duracaoMs = 0 usa o tempo máximo; valores maiores são
+// limitados a ele. Devolve a duração programada.
+inline uint32_t registrarBombaLigada(Irrigacao& irrigacao, OrigemBomba origem, uint32_t duracaoMs, uint32_t agora) {
+  if (duracaoMs == 0 || duracaoMs > irrigacao.tempoMaximoLigada) {
+    duracaoMs = irrigacao.tempoMaximoLigada;
+  }
+  irrigacao.origem = origem;
+  irrigacao.duracaoProgramada = duracaoMs;
+  irrigacao.ultimaLeituraSolo = agora;
+  irrigacao.estado = BOMBA_LIGADA;
+  irrigacao.inicioEstado = agora;
+  return duracaoMs;
+}
+
+// Bomba desligada em "agora" (o instante do corte real): o repouso mínimo conta daí
+inline void registrarBombaDesligada(Irrigacao& irrigacao, AcaoIrrigacao motivo, uint32_t agora) {
+  irrigacao.estado = BOMBA_REPOUSO;
+  irrigacao.inicioEstado = agora;
+  irrigacao.motivoDesligamento = motivo;
+}
+
+// Repouso cumprido (ACAO_FIM_REPOUSO): pronta para ligar de novo
+inline void registrarFimRepouso(Irrigacao& irrigacao) {
+  irrigacao.estado = BOMBA_DESLIGADA;
+}
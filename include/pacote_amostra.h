@@ -0,0 +1,47 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// ---------------------------------------------------------------
+// PACOTE BINÁRIO DE AMOSTRA (INGESTÃO)
+// ---------------------------------------------------------------
+// Tamanho fixo, little-endian (ordem nativa do ESP32) e valores em ponto fixo com
+// as casas decimais do registro de sensores. O receptor confere versao e
+// numSensores; nomes e casas dos campos, na ordem do registro, estão em
+// /api/esquema. Decodificador: tools/ingest_growmonitor.py. A codificação fica
+// aqui, fora do firmware, para o teste no PC (test/test_pacote) gerar os mesmos
+// bytes que o ESP32 envia.
+
+const uint8_t VERSAO_PACOTE = 1;
+const int16_t VALOR_AUSENTE_PACOTE = INT16_MIN;  // Canal com falha (NAN)
+
+template <int numeroSensores>
+struct __attribute__((packed)) PacoteAmostraSensores {
+  uint8_t versao;
+  uint8_t numSensores;
+  uint8_t zona;                        // Índice da zona (0 = primeira)
+  uint8_t reservado;
+  uint32_t epoch;                      // Segundos UTC (0 = relógio sem hora)
+  int16_t valores[numeroSensores];     // valor x 10^casas, saturado em ±32767
+};
+
+// Valor em ponto fixo para o pacote binário (NAN vira VALOR_AUSENTE_PACOTE)
+inline int16_t valorPontoFixo(float valor, int casas) {
+  if (isnan(valor)) {
+    return VALOR_AUSENTE_PACOTE;
+  }
+  float escalado = roundf(valor * powf(10.0f, casas));
+  if (escalado > 32767.0f) return 32767;
+  if (escalado < -32767.0f) return -32767;
+  return (int16_t)escalado;
+}
+
+template <int numeroSensores>
+void preencherCabecalhoPacote(PacoteAmostraSensores<numeroSensores>& pacote, uint8_t zona, uint32_t epoch) {
+  pacote.versao = VERSAO_PACOTE;
+  pacote.numSensores = numeroSensores;
+  pacote.zona = zona;
+  pacote.reservado = 0;
+  pacote.epoch = epoch;
+}
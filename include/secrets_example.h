@@ -4,9 +4,19 @@ const char* password = "senharede";
 
 const char* scriptURL = "endereçodoscriptdogoogle";
 
+// Endpoint de ingestão binária (deixe vazio para desativar), ex.: tools/ingest_growmonitor.py
+// Só http:// na rede local (ex.: "http://192.168.0.10:8090/"): o pacote vai sem TLS
+const char* ingestURL = "";
+
 const char* botToken = "bottokeTelegram";
 const char* chatID   = "chatIDTelegram";
 
+// Broker MQTT (deixe mqttServer vazio para desativar)
+const char* mqttServer   = "192.168.0.10";
+const int mqttPort       = 1883;
+const char* mqttUser     = "usuariomqtt";
+const char* mqttPassword = "senhamqtt";
+
 #define BLYNK_TEMPLATE_ID "TemplateID"
 #define BLYNK_TEMPLATE_NAME "TemplateName"
 #define BLYNK_AUTH_TOKEN "seu_token_blynk"
@@ -11,6 +11,10 @@
 // INCLUSÃO DE BIBLIOTECAS
 // ---------------------------------------------------------------
 #include "secrets.h"
+#include "certificados.h"         // CAs raiz fixadas para as conexões HTTPS
+#include "controle_irrigacao.h"    // Decisões da máquina de estados da bomba (testadas no PC)
+#include "pacote_amostra.h"        // Pacote binário de ingestão (testado no PC contra o decodificador)
+#include "codificacao.h"           // Codificação de URL e JSON em uma passada (testada e medida no PC)
 #include <Arduino.h>
 #include <Wire.h>
 #include <LiquidCrystal_I2C.h>    // Biblioteca para LCD via I2C
@@ -18,25 +22,90 @@
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include <WiFi.h>
-#include <WiFiUdp.h>
-#include <NTPClient.h>
+#include <time.h>
+#include "esp_sntp.h"             // Sincronização do relógio do sistema via SNTP
 #include <BlynkSimpleEsp32.h>
 #include <WiFiClientSecure.h>
 #include <HTTPClient.h>           // Para fazer requisição HTTP
-#include <WebServer.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>    // Servidor HTTP assíncrono (roda na task do LwIP/AsyncTCP)
 #include "FS.h"
 #include "LittleFS.h"
 #include <ArduinoOTA.h>
 #include <ESPmDNS.h>  // Adicione essa linha junto aos outros includes
 #include <ArduinoJson.h>
+#include <Preferences.h>          // Configurações persistentes na NVS
+#include <PubSubClient.h>         // Cliente MQTT (Home Assistant / Node-RED)
+#include "esp_timer.h"          // Timer de alta resolução para o corte da bomba
+#include "driver/gpio.h"
+#include "esp_sleep.h"            // Light-sleep e deep-sleep entre medições
 
 
 // ---------------------------------------------------------------
 // DEFINIÇÕES E CONFIGURAÇÕES DE HARDWARE
 // ---------------------------------------------------------------
 
-// Instancia o servidor web na porta 80
-WebServer server(80);
+// Instancia o servidor web assíncrono na porta 80
+AsyncWebServer server(80);
+
+// Os handlers do servidor rodam na task do AsyncTCP e não podem bloquear
+// (Telegram, TLS, sensores). Ações com efeito colateral são enfileiradas
+// e executadas pelo loop() em processarComandosWeb(). O callback do MQTT usa
+// a mesma fila: ele roda dentro de mqtt.loop() e também não pode bloquear.
+enum TipoComandoWeb {
+  CMD_ALTERNAR_BOMBA,
+  CMD_BOMBA_MQTT,      // valor1: 1 liga, 0 desliga
+  CMD_LIMITE_TEMPERATURA,
+  CMD_LIMITE_UMIDADE,
+  CMD_LIMITES_IRRIGACAO,
+  CMD_MODO_IRRIGACAO,
+  CMD_BLYNK,
+  CMD_PAINEL_TELEGRAM
+};
+
+struct ComandoWeb {
+  TipoComandoWeb tipo;
+  int zona;          // Índice em zonas[] (comandos de bomba, limites e irrigação)
+  float valor1;
+  float valor2;
+  bool respostaMqtt; // Veio do MQTT: publica o estado da zona depois de executar
+};
+
+QueueHandle_t filaComandosWeb = nullptr;
+const int tamanhoFilaComandosWeb = 8;
+
+// ---------------------------------------------------------------
+// ARQUIVOS ESTÁTICOS (LittleFS, pasta data/)
+// ---------------------------------------------------------------
+// Cada arquivo é lido uma vez no boot para calcular o ETag (If-None-Match → 304); os
+// pequenos ficam em RAM. Se existir "<caminho>.gz" ele é enviado com Content-Encoding:
+// gzip (gerado por tools/preparar_assets.py). URLs versionadas levam cache imutável de
+// um ano; as demais são revalidadas pelo ETag a cada uso.
+struct ArquivoEstatico {
+  const char* url;
+  const char* caminho;        // No LittleFS, sem o ".gz"
+  const char* tipo;
+  bool imutavel;              // A URL muda junto com o conteúdo (versão no nome)
+  // Preenchidos por carregarArquivosEstaticos()
+  bool existe;
+  bool gzip;
+  size_t tamanho;
+  char etag[11];              // "\"xxxxxxxx\"" (FNV-1a do conteúdo)
+  uint8_t* cache;             // Conteúdo em RAM (nullptr se maior que limiteCacheEstatico)
+};
+
+ArquivoEstatico arquivosEstaticos[] = {
+  { "/favicon.png",            "/favicon.png",         "image/png",              false },
+  { "/js/chart-4.4.0.min.js",  "/chart-4.4.0.min.js",  "application/javascript", true  },
+};
+const size_t limiteCacheEstatico = 12 * 1024;  // O favicon (9 KB) fica em RAM; o Chart.js é lido da flash
+
+uint32_t estaticosNaoModificados = 0;  // Respostas 304
+uint32_t estaticosRam = 0;
+uint32_t estaticosFlash = 0;
+
+// Configurações que sobrevivem a reinicializações (NVS)
+Preferences preferencias;
 
 // --- Configuração do Sensor DHT11 ---
 #define DHTPIN 4                            // Pino de dados do DHT11
@@ -47,6 +116,11 @@ DHT dht(DHTPIN, DHTTYPE);
 #define ONE_WIRE_BUS 19                     // Pino de dados do sensor DS18B20
 OneWire oneWire(ONE_WIRE_BUS);
 DallasTemperature sensors(&oneWire); //
+const uint8_t MAX_SONDAS = 8;               // Sondas DS18B20 atendidas no barramento
+DeviceAddress enderecosSondas[MAX_SONDAS];  // Endereços ROM, na ordem gravada na NVS
+uint8_t numeroSondas = 0;
+unsigned long tempoConversaoSondasUs = 0;   // Duração da última conversão do barramento
+unsigned long tempoLeituraSondasUs = 0;     // Soma das leituras por endereço da última amostra
 
 // --- Configuração do LCD 20x4 via I2C ---
 // O endereço do LCD geralmente é 0x27. O display possui 20 colunas e 4 linhas.
@@ -71,19 +145,603 @@ float converterParaPorcentagem(int leitura, int seco, int umido) {
 }
 
 
+// ---------------------------------------------------------------
+// REGISTRO DE SENSORES
+// ---------------------------------------------------------------
+// Tabela única (X-macro) da qual são gerados, em tempo de compilação, os
+// campos da struct Medicao, o registro do histórico em flash e todos os
+// serializadores (/dados, /sensor-data, LCD, Telegram, Sheets, Firestore,
+// Blynk, MQTT, gráfico e CSV), além dos alertas, da leitura do solo para a
+// irrigação e do painel web (via /api/esquema). Cada expansão vira código linear, sem
+// ponteiros de função nem laços sobre descritores em tempo de execução.
+// Para adicionar um sensor basta uma linha aqui e a sua função de leitura.
+//
+// X(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento,
+//   pinoBlynk, chaveSheets, chaveDados, classeHa, cor, minimo, maximo, travamento, barramento, papel)
+//   campo        Nome do campo em Medicao, /sensor-data e Firestore
+//   chave        Chave curta (MQTT e CSV do histórico)
+//   rotulo       Nome completo (Telegram, gráfico e Home Assistant)
+//   rotuloLcd    Rótulo curto para o LCD 20x4
+//   casas        Casas decimais em todas as saídas de texto
+//   leitura      Função float(const Zona&) que lê o sensor da zona (NAN se a leitura falhou,
+//                LEITURA_DESCONECTADA se o sensor não está no barramento)
+//   escala, deslocamento   Calibração linear: leitura * escala + deslocamento
+//   pinoBlynk    Pino virtual do Blynk
+//   chaveSheets  Campo esperado pelo Apps Script ("" = não enviado)
+//   chaveDados   Chave no JSON de /dados (usada pelo painel web)
+//   classeHa     device_class do Home Assistant
+//   cor          Cor da série nos gráficos
+//   minimo, maximo  Faixa física do sensor; fora dela o canal é marcado com falha
+//   travamento   Leituras idênticas seguidas que indicam sensor travado (0 = não verifica)
+//   barramento   Barramento reiniciado quando o canal falha
+//   papel        Alerta e controle de que o canal participa (PAPEL_SOLO também entra
+//                na umidade média usada pela irrigação); PAPEL_NENHUM = só exibido
+#define SENSORES(X) \
+  X(temperaturaInterna, "ti", "Temperatura Interna", "Temp Int", "🌡️", "°C", 1, lerTemperaturaInterna, 1.0f, 0.0f, \
+    V0, "temperatura_sensor", "tempInterna", "temperature", "red", -55.0f, 125.0f, 30, BARRAMENTO_ONEWIRE, \
+    PAPEL_TEMPERATURA) \
+  X(temperaturaExterna, "te", "Temperatura Externa", "Temp Ext", "🌡️", "°C", 1, lerTemperaturaExterna, 1.0f, 0.0f, \
+    V1, "temperatura", "tempExterna", "temperature", "blue", 0.0f, 50.0f, 0, BARRAMENTO_DHT, PAPEL_NENHUM) \
+  X(umidadeExterna, "ue", "Umidade Externa", "Umid Ext", "💧", "%", 1, lerUmidadeExterna, 1.0f, 0.0f, \
+    V2, "umidade", "umidadeExterna", "humidity", "green", 0.0f, 100.0f, 0, BARRAMENTO_DHT, PAPEL_UMIDADE_AR) \
+  X(umidadeSolo1, "s1", "Umidade do Solo (Sensor Atual)", "Solo 1", "🌱", "%", 1, lerSolo1, 1.0f, 0.0f, \
+    V5, "umidade_solo", "umidadeSolo1", "moisture", "brown", 0.0f, 100.0f, 30, BARRAMENTO_ADC, PAPEL_SOLO) \
+  X(umidadeSolo2, "s2", "Umidade do Solo (S12)", "Solo S12", "🌱", "%", 1, lerSolo2, 1.0f, 0.0f, \
+    V6, "", "umidadeSolo2", "moisture", "orange", 0.0f, 100.0f, 30, BARRAMENTO_ADC, PAPEL_SOLO)
+
+// Próximos sensores previstos (descomentar a linha e implementar a leitura):
+//  X(co2, "co2", "CO2", "CO2", "🫧", "ppm", 0, lerCo2, 1.0f, 0.0f, V9, "", "co2", "carbon_dioxide", "gray", 400.0f, 5000.0f, 30, BARRAMENTO_ADC, PAPEL_NENHUM)
+//  X(luminosidade, "lux", "Luminosidade", "Luz", "💡", "lx", 0, lerLuminosidade, 1.0f, 0.0f, V10, "", "luminosidade", "illuminance", "gold", 0.0f, 65535.0f, 0, BARRAMENTO_ADC, PAPEL_NENHUM)
+
+#define SENSOR_CONTAR(...) + 1
+const int NUM_SENSORES = 0 SENSORES(SENSOR_CONTAR);
+#undef SENSOR_CONTAR
+
+// Campo float por sensor (usado em Medicao e RegistroHistorico)
+#define SENSOR_CAMPO(campo, ...) float campo;
+
+// Canais com falha ficam NAN na medição: nos JSONs saem como null e nos textos como "--"
+String valorJson(float valor, int casas) {
+  return isnan(valor) ? String("null") : String(valor, casas);
+}
+
+String valorTexto(float valor, int casas, const String& unidade) {
+  return isnan(valor) ? String("--") : String(valor, casas) + unidade;
+}
+
+// --- Saúde dos sensores ---
+// Cada canal de cada zona é avaliado a cada medição; um canal com falha fica
+// fora da amostra sem descartar os outros e o seu barramento é reiniciado.
+enum Barramento { BARRAMENTO_ONEWIRE, BARRAMENTO_DHT, BARRAMENTO_ADC, NUM_BARRAMENTOS };
+
+// Papel do canal nos alertas da zona e no controle de irrigação (coluna papel do registro)
+enum PapelSensor {
+  PAPEL_NENHUM,
+  PAPEL_TEMPERATURA,   // Alerta acima do limite de temperatura da zona
+  PAPEL_UMIDADE_AR,    // Alerta abaixo de limiteUmidadeArAlerta
+  PAPEL_SOLO           // Alerta abaixo do limite de solo da zona; média alimenta a irrigação
+};
+
+const float limiteUmidadeArAlerta = 20.0;  // Umidade do ar baixa (%)
+
+enum FalhaSensor { FALHA_NENHUMA, FALHA_NAN, FALHA_DESCONECTADO, FALHA_FORA_FAIXA, FALHA_TRAVADO };
+
+// Devolvido pelas funções de leitura quando o sensor não está no barramento
+const float LEITURA_DESCONECTADA = DEVICE_DISCONNECTED_C;
+
+struct SaudeSensor {
+  FalhaSensor falha;          // Resultado da última leitura
+  uint8_t falhasSeguidas;
+  uint16_t repeticoes;        // Leituras seguidas com o mesmo valor
+  float ultimoValor;
+  float taxaFalhas;           // Média móvel (0 a 1) das leituras com falha
+  bool avisada;               // Falha já notificada no Telegram
+};
+
+// Saúde de 0 a 100 publicada em /metrics, no MQTT e no /saude do Telegram
+int pontuacaoSaude(const SaudeSensor& saude) {
+  return (int)roundf(100.0f * (1.0f - saude.taxaFalhas));
+}
+
+const char* descreverFalha(FalhaSensor falha) {
+  switch (falha) {
+    case FALHA_NAN:          return "sem resposta";
+    case FALHA_DESCONECTADO: return "desconectado";
+    case FALHA_FORA_FAIXA:   return "fora da faixa";
+    case FALHA_TRAVADO:      return "valor travado";
+    default:                 return "ok";
+  }
+}
+
+struct RecuperacaoBarramento {
+  unsigned long ultimaTentativa;  // millis() da última reinicialização
+  unsigned long intervalo;        // 0 enquanto o barramento está saudável
+};
+
+const uint8_t falhasParaAvisar = 2;                      // Leituras seguidas com falha antes de avisar no Telegram
+const unsigned long intervaloRecuperacaoMin = 30000;     // Primeira espera entre reinicializações (30 s)
+const unsigned long intervaloRecuperacaoMax = 1800000;   // Espera máxima entre reinicializações (30 min)
+const unsigned long intervaloNovaTentativaMedicao = 30000; // Se nenhum sensor respondeu, mede de novo em 30 s
+
+
+
+// ---------------------------------------------------------------
+// LOG DE DIAGNÓSTICO
+// ---------------------------------------------------------------
+// Todo diagnóstico passa por logErro/logAviso/logInfo/logDebug: a linha vai para a
+// Serial e para um anel em RAM com as últimas entradas, consultado sob demanda em
+// /logs e pelo comando /log do Telegram. Nada é enviado pela rede por conta própria.
+// Com /log arquivo on as entradas também são gravadas em lotes no LittleFS.
+enum NivelLog : uint8_t { LOG_DEBUG, LOG_INFO, LOG_AVISO, LOG_ERRO };
+const char* const nomesNivelLog[] = { "debug", "info", "aviso", "erro" };
+
+const int CAPACIDADE_LOG = 40;
+const int TAMANHO_TEXTO_LOG = 128;   // Bytes por entrada (o resto da mensagem vai só para a Serial)
+struct EntradaLog {
+  uint32_t sequencia;                // Crescente desde o boot (a primeira é 1)
+  uint32_t ms;                       // millis() no registro
+  time_t epoch;                      // time() no registro (sem hora se o relógio não sincronizou)
+  NivelLog nivel;
+  char texto[TAMANHO_TEXTO_LOG];
+};
+EntradaLog anelLog[CAPACIDADE_LOG];
+uint32_t proximaSequenciaLog = 1;
+portMUX_TYPE muxLog = portMUX_INITIALIZER_UNLOCKED;  // Também há registros vindos da task do AsyncTCP
+NivelLog nivelMinimoLog = LOG_INFO;  // Abaixo dele só vai para a Serial (/log nivel, salvo na NVS)
+
+// Cópia opcional em flash: "/log.txt", rotacionado para "/log.old" ao passar do limite
+#define ARQUIVO_LOG "/log.txt"
+#define ARQUIVO_LOG_ANTIGO "/log.old"
+const size_t tamanhoMaximoArquivoLog = 64 * 1024;
+const unsigned long intervaloGravacaoLog = 10000;    // Agrupa as gravações em flash
+bool logEmArquivo = false;                           // /log arquivo on|off, salvo na NVS
+uint32_t ultimaSequenciaGravadaLog = 0;
+unsigned long ultimaGravacaoLog = 0;
+uint32_t entradasLogPerdidas = 0;                    // Sobrescritas no anel antes de ir para o arquivo
+
+void registrarLog(NivelLog nivel, const String& mensagem) {
+  Serial.println(mensagem);
+  if (nivel < nivelMinimoLog) {
+    return;
+  }
+  // Quebras de linha iniciais só espaçam a Serial
+  const char* texto = mensagem.c_str();
+  while (*texto == '\n') {
+    texto++;
+  }
+  size_t tamanho = strlen(texto);
+  if (tamanho >= (size_t)TAMANHO_TEXTO_LOG) {
+    tamanho = TAMANHO_TEXTO_LOG - 1;
+    while (tamanho > 0 && ((uint8_t)texto[tamanho] & 0xC0) == 0x80) {
+      tamanho--;  // Não corta um caractere UTF-8 ao meio
+    }
+  }
+  time_t agora = time(nullptr);
+  portENTER_CRITICAL(&muxLog);
+  EntradaLog& entrada = anelLog[(proximaSequenciaLog - 1) % CAPACIDADE_LOG];
+  entrada.sequencia = proximaSequenciaLog++;
+  entrada.ms = millis();
+  entrada.epoch = agora;
+  entrada.nivel = nivel;
+  memcpy(entrada.texto, texto, tamanho);
+  entrada.texto[tamanho] = '\0';
+  portEXIT_CRITICAL(&muxLog);
+}
+
+inline void logErro(const String& mensagem) { registrarLog(LOG_ERRO, mensagem); }
+inline void logAviso(const String& mensagem) { registrarLog(LOG_AVISO, mensagem); }
+inline void logInfo(const String& mensagem) { registrarLog(LOG_INFO, mensagem); }
+inline void logDebug(const String& mensagem) { registrarLog(LOG_DEBUG, mensagem); }
+
 
 // ---------------------------------------------------------------
 // CONFIGURAÇÃO DE CONEXÃO E TEMPO
 // ---------------------------------------------------------------
 
-// Configuração NTP para obter a hora atual
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, "pool.ntp.org", -10800, 60000);  // Offset de -10800 segundos (UTC-3), atualiza a cada 60 segundos
+// Relógio do sistema sincronizado pelo serviço SNTP do ESP-IDF (configTzTime).
+// A ressincronização roda em segundo plano; os intervalos do firmware continuam
+// em millis()/esp_timer, que são monotônicos e não pulam quando a hora é ajustada.
+#define FUSO_HORARIO "<-03>3"                       // UTC-3 (Brasília), sem horário de verão
+#define SERVIDOR_NTP_1 "pool.ntp.org"
+#define SERVIDOR_NTP_2 "a.st1.ntp.br"
+const uint32_t intervaloSincronizacaoNtp = 3600000;  // Ressincroniza a cada 1 h
+const time_t epochMinimoValido = 1704067200;         // 01/01/2024: antes disso o relógio não foi ajustado
+volatile uint32_t sincronizacoesNtp = 0;
+
+// Carimbo de tempo de uma amostra, formatado uma única vez e compartilhado
+// por LCD, Telegram, Sheets, Firestore e histórico
+struct CarimboTempo {
+  time_t epoch;     // Segundos UTC (0 enquanto o relógio não estiver sincronizado)
+  char hora[9];     // "HH:MM:SS" no horário local
+  char iso[21];     // "AAAA-MM-DDTHH:MM:SSZ" em UTC
+};
+
+// Chamado pelo SNTP a cada sincronização bem-sucedida
+void callbackSincronizacaoNtp(struct timeval*) {
+  sincronizacoesNtp++;
+}
+
+void configurarRelogio() {
+  sntp_set_sync_interval(intervaloSincronizacaoNtp);
+  sntp_set_time_sync_notification_cb(callbackSincronizacaoNtp);
+  configTzTime(FUSO_HORARIO, SERVIDOR_NTP_1, SERVIDOR_NTP_2);
+  logInfo("🕒 SNTP iniciado (" SERVIDOR_NTP_1 ", " SERVIDOR_NTP_2 ")");
+}
+
+bool relogioSincronizado() {
+  return time(nullptr) >= epochMinimoValido;
+}
+
+// Formata os campos do carimbo para um instante (anterior a epochMinimoValido = sem hora)
+void preencherCarimboTempo(CarimboTempo& carimbo, time_t agora) {
+  if (agora < epochMinimoValido) {
+    carimbo.epoch = 0;
+    strcpy(carimbo.hora, "--:--:--");
+    carimbo.iso[0] = '\0';
+    return;
+  }
+  struct tm local;
+  struct tm utc;
+  localtime_r(&agora, &local);
+  gmtime_r(&agora, &utc);
+  carimbo.epoch = agora;
+  strftime(carimbo.hora, sizeof(carimbo.hora), "%H:%M:%S", &local);
+  strftime(carimbo.iso, sizeof(carimbo.iso), "%Y-%m-%dT%H:%M:%SZ", &utc);
+}
+
+// Lê o relógio do sistema (sem rede) e formata os campos do carimbo
+void gerarCarimboTempo(CarimboTempo& carimbo) {
+  preencherCarimboTempo(carimbo, time(nullptr));
+}
 
 // ---------------------------------------------------------------
-// CONFIGURAÇÃO PARA TELEGRAM
+// CONEXÕES HTTPS (TELEGRAM, FIRESTORE E GOOGLE SHEETS)
 // ---------------------------------------------------------------
-std::unique_ptr<WiFiClientSecure> telegramClient;  // Cliente seguro para conexões HTTPS
+// Conexões TLS persistentes, autenticadas pelas raízes de certificados.h (sem
+// setInsecure()). O WiFiClientSecure do Arduino não expõe a sessão do mbedTLS para
+// retomada, então a economia vem de manter a conexão aberta (HTTP/1.1 keep-alive):
+// o handshake completo só se repete quando o servidor fecha a conexão ociosa ou
+// depois de uma queda do Wi-Fi.
+//
+// Os clientes ficam em um pool fixo de slots, alocado estaticamente: no máximo
+// NUM_SLOTS_TLS contextos do mbedTLS existem ao mesmo tempo (cada um com ~16 KB de
+// buffer de entrada, ~4 KB de saída e o estado do handshake). O slot 0 é só do
+// Telegram, que faz polling a cada segundo e perderia a conexão (um handshake novo a
+// cada medição) se disputasse o pool; os outros hosts dividem os demais slots e, com
+// eles cheios, o que precisa de conexão toma o usado há mais tempo.
+enum HostTls { HOST_TELEGRAM, HOST_FIRESTORE, HOST_SHEETS, NUM_HOSTS_TLS };
+
+const int NUM_SLOTS_TLS = 2;          // Telegram (polling) + um envio de medição por vez
+const int SLOT_TLS_TELEGRAM = 0;      // Reservado para HOST_TELEGRAM
+static_assert(NUM_SLOTS_TLS >= 2, "O Telegram reserva um slot TLS; os envios precisam de outro");
+// Slots ociosos (Firestore e Sheets entre medições) são liberados; o do Telegram
+// segue vivo com o polling.
+const unsigned long tempoMaximoOciosoTls = 60000;
+
+struct ConexaoTls {
+  const char* host;
+  const char* ca;                      // Raízes aceitas (PEM)
+  uint32_t handshakes;
+  uint32_t reutilizacoes;              // Requisições feitas sem novo handshake
+  uint32_t falhas;
+  unsigned long ultimoHandshakeMs;
+  unsigned long somaHandshakeMs;
+};
+
+ConexaoTls conexoesTls[NUM_HOSTS_TLS] = {
+  { "api.telegram.org", CA_TELEGRAM },
+  { "firestore.googleapis.com", CA_GOOGLE },
+  { "script.google.com", CA_GOOGLE },
+};
+
+struct SlotTls {
+  WiFiClientSecure cliente;
+  int8_t host;                         // HostTls que ocupa o slot (-1 = livre)
+  unsigned long ultimoUso;             // millis() da última requisição
+};
+
+SlotTls slotsTls[NUM_SLOTS_TLS];
+int maximoSlotsTlsOcupados = 0;        // Pico de ocupação do pool desde o boot
+uint32_t despejosTls = 0;              // Conexões fechadas para ceder o slot a outro host
+uint32_t memoriaConexaoTls = 0;        // Heap consumido pelo último handshake (bytes)
+
+void configurarConexoesTls() {
+  for (SlotTls& slot : slotsTls) {
+    slot.host = -1;
+  }
+}
+
+int slotsTlsOcupados() {
+  int ocupados = 0;
+  for (const SlotTls& slot : slotsTls) {
+    if (slot.host >= 0) {
+      ocupados++;
+    }
+  }
+  return ocupados;
+}
+
+// Fecha a conexão (o mbedTLS devolve os buffers ao heap) e devolve o slot ao pool
+void liberarSlotTls(SlotTls& slot) {
+  slot.cliente.stop();
+  slot.host = -1;
+}
+
+// Descarta as conexões abertas (chamado quando o Wi-Fi volta: os sockets antigos morreram)
+void fecharConexoesTls() {
+  for (SlotTls& slot : slotsTls) {
+    liberarSlotTls(slot);
+  }
+}
+
+// Chamado pelo loop(): libera os slots sem uso há mais de tempoMaximoOciosoTls
+// e os que o servidor já fechou
+void encerrarConexoesOciosasTls() {
+  for (SlotTls& slot : slotsTls) {
+    if (slot.host >= 0 && (millis() - slot.ultimoUso >= tempoMaximoOciosoTls || !slot.cliente.connected())) {
+      liberarSlotTls(slot);
+    }
+  }
+}
+
+SlotTls* slotDoHost(HostTls host) {
+  for (SlotTls& slot : slotsTls) {
+    if (slot.host == host) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Reserva um slot para o host: o Telegram fica com o seu; os outros, um slot livre
+// fora dele ou, com todos ocupados, o usado há mais tempo
+SlotTls& reservarSlotTls(HostTls host) {
+  SlotTls* escolhido = nullptr;
+  for (int i = 0; i < NUM_SLOTS_TLS; i++) {
+    SlotTls& slot = slotsTls[i];
+    if ((host == HOST_TELEGRAM) != (i == SLOT_TLS_TELEGRAM)) {
+      continue;
+    }
+    if (slot.host < 0) {
+      escolhido = &slot;
+      break;
+    }
+    if (escolhido == nullptr || millis() - slot.ultimoUso > millis() - escolhido->ultimoUso) {
+      escolhido = &slot;
+    }
+  }
+  if (escolhido->host >= 0) {
+    logDebug("🔐 Pool TLS cheio: " + String(conexoesTls[escolhido->host].host) + " cede o slot");
+    liberarSlotTls(*escolhido);
+    despejosTls++;
+  }
+  escolhido->host = host;
+  escolhido->ultimoUso = millis();
+  escolhido->cliente.setCACert(conexoesTls[host].ca);
+  maximoSlotsTlsOcupados = max(maximoSlotsTlsOcupados, slotsTlsOcupados());
+  return *escolhido;
+}
+
+// Garante a conexão com o host, reaproveitando a que ficou aberta (nullptr se falhar)
+SlotTls* conectarTls(HostTls host, bool& reaproveitada) {
+  ConexaoTls& conexao = conexoesTls[host];
+  SlotTls* slot = slotDoHost(host);
+  reaproveitada = slot != nullptr && slot->cliente.connected();
+  if (reaproveitada) {
+    conexao.reutilizacoes++;
+    return slot;
+  }
+  if (slot == nullptr) {
+    slot = &reservarSlotTls(host);
+  } else {
+    slot->cliente.stop();
+  }
+  uint32_t heapAntes = ESP.getFreeHeap();
+  unsigned long inicio = millis();
+  if (!slot->cliente.connect(conexao.host, 443)) {
+    conexao.falhas++;
+    char erro[64];
+    slot->cliente.lastError(erro, sizeof(erro));
+    logErro("❌ Falha no TLS com " + String(conexao.host) + ": " + erro);
+    liberarSlotTls(*slot);
+    return nullptr;
+  }
+  conexao.ultimoHandshakeMs = millis() - inicio;
+  conexao.somaHandshakeMs += conexao.ultimoHandshakeMs;
+  conexao.handshakes++;
+  uint32_t heapDepois = ESP.getFreeHeap();
+  memoriaConexaoTls = heapAntes > heapDepois ? heapAntes - heapDepois : 0;
+  logDebug("🔐 Handshake TLS com " + String(conexao.host) + ": " + String(conexao.ultimoHandshakeMs) + " ms, " +
+           String(memoriaConexaoTls) + " bytes de heap");
+  return slot;
+}
+
+// Escrita no socket TLS em blocos: cada write() vira um registro TLS, então os
+// pedaços pequenos do formatador são juntados antes de sair
+const size_t tamanhoBlocoTls = 256;
+struct EscritaTls {
+  WiFiClientSecure* cliente;
+  char bloco[tamanhoBlocoTls];
+  size_t usado;
+  bool falhou;
+};
+
+void descarregarTls(EscritaTls& escrita) {
+  if (escrita.usado > 0 && !escrita.falhou) {
+    escrita.falhou = escrita.cliente->write((const uint8_t*)escrita.bloco, escrita.usado) != escrita.usado;
+  }
+  escrita.usado = 0;
+}
+
+void escreverTls(EscritaTls& escrita, const char* dados, size_t tamanho) {
+  while (tamanho > 0 && !escrita.falhou) {
+    size_t n = min(tamanho, tamanhoBlocoTls - escrita.usado);
+    memcpy(escrita.bloco + escrita.usado, dados, n);
+    escrita.usado += n;
+    dados += n;
+    tamanho -= n;
+    if (escrita.usado == tamanhoBlocoTls) {
+      descarregarTls(escrita);
+    }
+  }
+}
+
+void escreverTls(EscritaTls& escrita, const String& texto) {
+  escreverTls(escrita, texto.c_str(), texto.length());
+}
+
+const unsigned long timeoutRespostaHttpMs = 10000;
+
+// Espera um byte do socket até o prazo (millis()); -1 se a conexão caiu ou o prazo venceu
+int lerByteHttp(WiFiClientSecure& cliente, unsigned long prazo) {
+  while (!cliente.available()) {
+    if (!cliente.connected() || (long)(millis() - prazo) >= 0) {
+      return -1;
+    }
+    delay(1);
+  }
+  return cliente.read();
+}
+
+// Lê uma linha do cabeçalho sem o CRLF (truncada na capacidade); false se a conexão caiu
+bool lerLinhaHttp(WiFiClientSecure& cliente, char* linha, size_t capacidade, unsigned long prazo) {
+  size_t n = 0;
+  while (true) {
+    int c = lerByteHttp(cliente, prazo);
+    if (c < 0) {
+      return false;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (c != '\r' && n + 1 < capacidade) {
+      linha[n++] = c;
+    }
+  }
+  linha[n] = '\0';
+  return true;
+}
+
+// Consome "tamanho" bytes do corpo (-1 = até o servidor fechar), guardando só o
+// começo em inicioCorpo
+bool consumirCorpoHttp(WiFiClientSecure& cliente, long tamanho, char* inicioCorpo, size_t capacidade,
+                       size_t& guardado, unsigned long prazo) {
+  uint8_t bloco[64];
+  while (tamanho != 0) {
+    if (!cliente.available()) {
+      if (!cliente.connected()) {
+        return tamanho < 0;
+      }
+      if ((long)(millis() - prazo) >= 0) {
+        return false;
+      }
+      delay(1);
+      continue;
+    }
+    size_t pedido = tamanho < 0 ? sizeof(bloco) : min((size_t)tamanho, sizeof(bloco));
+    int lidos = cliente.read(bloco, pedido);
+    if (lidos <= 0) {
+      continue;
+    }
+    size_t copiar = min((size_t)lidos, capacidade - 1 - guardado);
+    memcpy(inicioCorpo + guardado, bloco, copiar);
+    guardado += copiar;
+    if (tamanho > 0) {
+      tamanho -= lidos;
+    }
+  }
+  return true;
+}
+
+// Lê a resposta sem guardá-la inteira: interpreta a linha de status e os cabeçalhos,
+// descarta o corpo (Content-Length, chunked ou até o fechamento) e guarda só o começo
+// dele em inicioCorpo (para o log). Devolve o status HTTP, ou -1 se a conexão caiu;
+// manterConexao diz se a conexão pode ser reaproveitada.
+int lerRespostaHttp(WiFiClientSecure& cliente, char* inicioCorpo, size_t capacidade, bool& manterConexao) {
+  unsigned long prazo = millis() + timeoutRespostaHttpMs;
+  char linha[96];
+  size_t guardado = 0;
+  inicioCorpo[0] = '\0';
+  manterConexao = false;
+  if (!lerLinhaHttp(cliente, linha, sizeof(linha), prazo) || strncmp(linha, "HTTP/1.", 7) != 0 || strlen(linha) < 12) {
+    return -1;
+  }
+  int status = atoi(linha + 9);  // "HTTP/1.1 200 OK"
+  manterConexao = linha[7] == '1';
+  long tamanho = -1;
+  bool chunked = false;
+  while (true) {
+    if (!lerLinhaHttp(cliente, linha, sizeof(linha), prazo)) {
+      return -1;
+    }
+    if (linha[0] == '\0') {
+      break;
+    }
+    if (strncasecmp(linha, "Content-Length:", 15) == 0) {
+      tamanho = atol(linha + 15);
+    } else if (strncasecmp(linha, "Transfer-Encoding:", 18) == 0 && strstr(linha + 18, "chunked") != nullptr) {
+      chunked = true;
+    } else if (strncasecmp(linha, "Connection:", 11) == 0 && strstr(linha + 11, "close") != nullptr) {
+      manterConexao = false;
+    }
+  }
+
+  bool completo = false;
+  if (chunked) {
+    // Cada bloco: tamanho em hexa, CRLF, dados, CRLF; o bloco 0 encerra (seguido dos trailers)
+    while (lerLinhaHttp(cliente, linha, sizeof(linha), prazo)) {
+      long bloco = strtol(linha, nullptr, 16);
+      if (bloco == 0) {
+        while (lerLinhaHttp(cliente, linha, sizeof(linha), prazo) && linha[0] != '\0') {
+        }
+        completo = true;
+        break;
+      }
+      if (!consumirCorpoHttp(cliente, bloco, inicioCorpo, capacidade, guardado, prazo) ||
+          !lerLinhaHttp(cliente, linha, sizeof(linha), prazo)) {
+        break;
+      }
+    }
+  } else {
+    completo = consumirCorpoHttp(cliente, tamanho, inicioCorpo, capacidade, guardado, prazo);
+    if (tamanho < 0) {
+      manterConexao = false;  // Sem Content-Length o corpo termina no fechamento da conexão
+    }
+  }
+  inicioCorpo[guardado] = '\0';
+  if (!completo) {
+    manterConexao = false;
+  }
+  return status;
+}
+
+// Requisição HTTPS pela conexão persistente do host (POST se houver corpo, senão GET).
+// Uma conexão reaproveitada que o servidor já tinha fechado falha no envio: nesse
+// caso refaz o handshake e tenta mais uma vez. O chamador lê a resposta inteira e
+// chama end(); sobra de resposta no socket estragaria a próxima requisição.
+int requisicaoHttps(HostTls host, HTTPClient& http, const String& url, const String* corpo = nullptr,
+                    const char* tipoConteudo = "application/json") {
+  for (int tentativa = 0; tentativa < 2; tentativa++) {
+    bool reaproveitada;
+    SlotTls* slot = conectarTls(host, reaproveitada);
+    if (slot == nullptr) {
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    http.begin(slot->cliente, url);
+    http.setReuse(true);
+    if (corpo != nullptr) {
+      http.addHeader("Content-Type", tipoConteudo);
+    }
+    int codigo = corpo != nullptr ? http.POST(*corpo) : http.GET();
+    slot->ultimoUso = millis();
+    if (codigo > 0 || !reaproveitada) {
+      return codigo;
+    }
+    http.end();
+    slot->cliente.stop();
+  }
+  return HTTPC_ERROR_CONNECTION_LOST;
+}
 
 // ---------------------------------------------------------------
 // VARIÁVEIS GLOBAIS E ESTRUTURAS
@@ -92,309 +750,2492 @@ unsigned long ultimaExecucao = 0;                   // Armazena o tempo (em ms)
 unsigned long ultimaVerificacaoTelegram = 0;        // Armazena o tempo da última verificação de comandos no Telegram
 const unsigned long intervaloMedicao = 300000;      // Intervalo entre medições (300.000 ms = 300 s)
 const unsigned long intervaloVerificacaoTelegram = 1000; // Intervalo de verificação de comandos do Telegram (1 s)
-bool bombaLigada = false;                           // Estado atual da bomba (ligada/desligada)
-float limiteUmidadeSoloAlerta = 35.0;  // Padrão: 35%
+const unsigned long janelaFrescorMedicao = 30000;   // Pedidos manuais até 30 s após uma medição usam o resultado dela
+
+// Coordenador de medição (single-flight): /medir, o botão V8 do Blynk, /realizar-medicao e a
+// medição periódica viram pedidos com um id de trabalho. Pedidos que chegam enquanto há um
+// trabalho agendado ou em andamento ficam com ele; uma só leitura e um só ciclo de envios.
+enum OrigemPedidoMedicao { PEDIDO_PERIODICO, PEDIDO_TELEGRAM, PEDIDO_BLYNK, PEDIDO_WEB };
+const int NUM_RESULTADOS_MEDICAO = 8;  // Trabalhos recentes consultáveis em /medicao?id=N
+struct ResultadoTrabalho {
+  uint32_t id;                // 0 = posição ainda vazia
+  bool medido;                // false = nenhuma zona medida
+};
+struct CoordenadorMedicao {
+  uint32_t ultimoId;          // Último id de trabalho emitido
+  uint32_t pendente;          // Trabalho agendado ou em andamento (0 = nenhum)
+  bool emAndamento;
+  bool forcarTelegram;        // Houve pedido manual: a medição vai ao Telegram antes do intervalo
+  uint32_t concluido;         // Último trabalho com pelo menos uma zona medida
+  unsigned long concluidoEm;  // millis() do fim desse trabalho
+  ResultadoTrabalho resultados[NUM_RESULTADOS_MEDICAO];  // Anel com os últimos trabalhos terminados
+  uint8_t proximoResultado;
+  uint32_t pedidos, compartilhados, respondidosCache, execucoes;
+};
+CoordenadorMedicao coordenadorMedicao = {};
+portMUX_TYPE muxMedicao = portMUX_INITIALIZER_UNLOCKED;  // Pedidos também chegam da task do AsyncTCP
+
+// Painel fixado no Telegram: uma mensagem editada a cada medição (editMessageText);
+// mensagens novas só para alertas. /painel on|off, salvo na NVS
+bool painelTelegram = true;
+long idMensagemPainel = 0;                           // message_id do painel fixado (NVS "painel_id"); 0 = ainda não criado
+uint32_t hashPainel = 0;                             // Hash do conteúdo (sem o horário) da última edição
+unsigned long ultimaAtualizacaoPainel = 0;           // millis() da última edição do painel
+const unsigned long intervaloMaximoPainel = 1800000; // Sem mudança nos valores, edita ao menos a cada 30 min
+uint32_t atualizacoesPainelPuladas = 0;              // Edições evitadas por conteúdo igual
+
+// Chamadas à Bot API por tipo, no total e na última hora completa
+enum TipoChamadaTelegram { TG_ENVIO, TG_EDICAO, TG_POLLING, TG_OUTRAS, NUM_TIPOS_CHAMADA_TELEGRAM };
+const char* const nomesChamadaTelegram[NUM_TIPOS_CHAMADA_TELEGRAM] = { "envio", "edicao", "polling", "outras" };
+uint32_t chamadasTelegram[NUM_TIPOS_CHAMADA_TELEGRAM] = {};
+uint32_t chamadasTelegramJanela[NUM_TIPOS_CHAMADA_TELEGRAM] = {};
+uint32_t chamadasTelegramHora[NUM_TIPOS_CHAMADA_TELEGRAM] = {};
+unsigned long inicioJanelaTelegram = 0;
+const unsigned long janelaChamadasTelegram = 3600000;  // 1 h
 
 // Controle de alternância de telas no LCD
 unsigned long ultimaTrocaTela = 0;
 const unsigned long intervaloTrocaTela = 5000; // 5 segundos
-int telaAtual = 0; // 0: Temperaturas, 1: Umidades, 2: Status e Alertas
+int telaAtual = 0; // Por zona: telas de sensores (3 por tela, na ordem do registro) e a tela de status
+const int telasSensoresLcd = (NUM_SENSORES + 2) / 3;
+const int telasPorZonaLcd = telasSensoresLcd + 1;
 
 
+// ---------------------------------------------------------------
+// CONTROLE DE IRRIGAÇÃO (MÁQUINA DE ESTADOS DA BOMBA)
+// ---------------------------------------------------------------
+// O relé da bomba só é acionado por acionarReleBomba(), chamada por ligarBomba() e
+// desligarBomba(); qualquer comando (Web, Telegram, MQTT ou automático) passa por essa
+// máquina de estados. A única exceção é o corte por tempo, feito pelo esp_timer (ver
+// abaixo). Estados, parâmetros, decisões e transições ficam em controle_irrigacao.h.
 
-// Variáveis globais para armazenar as leituras dos sensores de solo
-float umidadeSolo1 = 0.0;  // Sensor atual
-float umidadeSolo2 = 0.0;  // Sensor S12
+// Cada bomba tem um timer one-shot (na sua zona) que desliga o relé no prazo exato,
+// mesmo com o loop() travado (handshake TLS, conversão do DS18B20, etc.)
+float atrasoCorteBombaMs = 0.0;               // Atraso do último corte em relação ao prazo (qualquer zona)
+float maiorAtrasoCorteBombaMs = 0.0;          // Maior atraso observado desde o boot
 
 
 // Estrutura para armazenar uma medição
 struct Medicao {
-  String tempo;
-  float temperaturaInterna;
-  float temperaturaExterna;
-  float umidade;         // Umidade do ar (DHT11)
-  float umidadeSolo1;     // NOVO: Umidade do solo
-  float umidadeSolo2;    // Sensor S12 (NOVO)
+  char tempo[9];          // "HH:MM:SS" (copiado do carimbo da amostra)
+  time_t epoch;           // Instante da medição em UTC (0 se o relógio não estava sincronizado)
+  uint32_t sequencia;     // Número da amostra, crescente (cursor de /dados?since=)
+  SENSORES(SENSOR_CAMPO)  // Um float por sensor do registro
 };
 
-// Número máximo de medições a serem armazenadas para o gráfico
-const int MAX_MEDICOES = 50;  
-Medicao historico[MAX_MEDICOES];  
-int indiceMedicao = 0;
+// Última medição publicada de uma zona: dois buffers e uma versão (seqlock). O loop()
+// grava a amostra inteira no buffer inativo e só então incrementa a versão, que passa a
+// apontar para ele; quem lê de outra task (servidor assíncrono) copia o buffer ativo e
+// confere se a versão não mudou durante a cópia. Ninguém vê campos de amostras diferentes.
+struct InstantaneoMedicao {
+  Medicao buffers[2];
+  volatile uint32_t versao;   // Buffer ativo = versao & 1; 0 = nada publicado ainda
+};
 
-// ** NOVO: Limite de temperatura para alerta (padrão: 28°C) **
-float limiteTemperaturaAlerta = 28.0;
+// Número máximo de medições a serem armazenadas para o gráfico (por zona)
+const int MAX_MEDICOES = 50;  
+portMUX_TYPE muxHistorico = portMUX_INITIALIZER_UNLOCKED;  // Protege o histórico das zonas (lido pelo servidor assíncrono)
+
+// Histórico completo em flash (LittleFS): registros binários de tamanho fixo,
+// um par de arquivos por zona ("/historico_<id>.bin" e "/historico_<id>.old").
+// Ao passar do limite, o arquivo atual vira o ".old" e um novo é iniciado.
+#define ARQUIVO_HISTORICO_LEGADO "/historico.bin"         // Versões com uma única zona
+#define ARQUIVO_HISTORICO_LEGADO_ANTIGO "/historico.old"
+const size_t tamanhoMaximoLogHistorico = 512 * 1024;  // ~37 mil registros (~4 meses a cada 5 min)
+
+// O layout segue o registro de sensores; se ele mudar, os arquivos antigos
+// são descartados no boot (ver verificarFormatoHistorico()).
+struct __attribute__((packed)) RegistroHistorico {
+  uint32_t epoch;                // Segundos UTC
+  SENSORES(SENSOR_CAMPO)         // float por sensor, na ordem do registro
+};
 
-// Variáveis para armazenar a última medição para exibição
-float ultimaTempInterna = 0.0;
-float ultimaTempExterna = 0.0;
-float ultimaUmidadeExterna = 0.0;
-String ultimaHoraMedicao = "";
-float ultimaUmidadeSolo = 0.0;
+// Pacote binário de uma amostra para o endpoint de ingestão (ingestURL); layout e
+// codificação em include/pacote_amostra.h
+typedef PacoteAmostraSensores<NUM_SENSORES> PacoteAmostra;
 
+// Métricas da última consulta a /api/historico
+unsigned long historicoUltimaConsultaPontos = 0;
+unsigned long historicoUltimaConsultaMs = 0;
 
+// Métricas do último /grafico.svg
+unsigned long graficoSvgUltimosPontos = 0;
+unsigned long graficoSvgUltimoMs = 0;
 
 // ---------------------------------------------------------------
-// DECLARAÇÃO DAS FUNÇÕES
+// ZONAS DE CULTIVO
 // ---------------------------------------------------------------
-void realizarMedicao(bool forcarEnvioTelegram = false);
-void enviarMensagemTelegram(const String& msg, bool usarMarkdown, String modo);
-void verificarMensagensTelegram();
-void ligarBomba();
-void desligarBomba();
-void configurarComandosTelegram();  // Configura comandos via API do Telegram
-String urlEncode(String s);         // Função para codificar URL (para links)
-String gerarLinkGrafico();          // Gera URL do gráfico via QuickChart
-void enviarGraficoTelegram();       // Envia link do gráfico via Telegram
-void enviarDadosFirestore(float temperaturaInterna, float temperaturaExterna, float umidadeExterna, float umidadeSolo1, float umidadeSolo2, String horaAtual);
+// Cada zona (grow/estufa) tem seus sensores, calibração, relé, limites,
+// irrigação e histórico. Todas são amostradas juntas em realizarMedicao():
+// uma única conversão no ONE_WIRE_BUS serve as sondas de todas as zonas e
+// cada zona sai em um único payload por destino (MQTT, Sheets, Firestore).
+
+// Sensor capacitivo de solo: pino analógico e leituras de calibração
+struct SensorSolo {
+  uint8_t pino;
+  int seco;     // Leitura com o sensor no ar
+  int umido;    // Leitura com o sensor na água
+};
+
+struct Zona {
+  // --- Configuração ---
+  const char* nome;                   // Exibido no LCD, Telegram e Home Assistant
+  const char* id;                     // Usado em tópicos MQTT e nomes de arquivo
+  uint8_t sondaTemperatura;           // Posição da sonda DS18B20 na lista gravada na NVS
+  uint8_t resolucaoSonda;             // 9 a 12 bits: conversão de 94, 188, 375 ou 750 ms
+  DHT* dht;                           // Sensor de ar da zona (pode ser compartilhado)
+  SensorSolo solo1;
+  SensorSolo solo2;
+  uint8_t releBomba;
+  float limiteTemperaturaAlerta;      // °C
+  float limiteUmidadeSoloAlerta;      // %
+  Irrigacao irrigacao;
+
+  // --- Estado (zerado na inicialização) ---
+  InstantaneoMedicao ultimaMedicao;   // Última amostra completa (ler com medicaoAtual/copiarMedicao)
+  Medicao historico[MAX_MEDICOES];
+  int indiceMedicao;
+  float soloControle;                 // Média dos sensores de solo para a irrigação (a cada 2 s com a
+                                      // bomba ligada), fora do snapshot publicado; NAN se nenhum respondeu
+  bool leituraSoloValida;             // Só passa a true após a primeira leitura do solo
+  esp_timer_handle_t timerBomba;
+  volatile bool corteBombaPendente;   // Setado pelo timer quando corta o relé
+  volatile int64_t instanteCorteBombaUs;  // esp_timer_get_time() no instante do corte
+  int64_t prazoBombaUs;               // Instante programado para o desligamento
+  SaudeSensor saude[NUM_SENSORES];    // Na ordem do registro
+  RecuperacaoBarramento recuperacao[NUM_BARRAMENTOS];
+};
 
+Zona zonas[] = {
+  { "Grow 1", "grow1", 0, 12, &dht,
+    { SOIL_SENSOR1_PIN, 3208, 1521 },   // Sensor atual
+    { SOIL_SENSOR2_PIN, 3716, 1979 },   // Sensor S12
+    RELE_BOMBA,
+    28.0,   // Alerta de temperatura
+    35.0,   // Alerta de solo seco
+    { BOMBA_DESLIGADA, ORIGEM_MANUAL, 0, 0,
+      false,    // Modo automático começa desligado
+      30.0,     // Liga abaixo de 30%
+      45.0,     // Desliga em 45% (histerese de 15 pontos)
+      60000,    // No máximo 60 s ligada
+      600000 }  // No mínimo 10 min de repouso
+  },
+  // Segunda tenda: outra sonda no mesmo ONE_WIRE_BUS, DHT compartilhado
+  // { "Grow 2", "grow2", 1, 10, &dht, { 36, 3208, 1521 }, { 39, 3716, 1979 }, 25, 28.0, 35.0,
+  //   { BOMBA_DESLIGADA, ORIGEM_MANUAL, 0, 0, false, 30.0, 45.0, 60000, 600000 } },
+};
+const int NUM_ZONAS = sizeof(zonas) / sizeof(zonas[0]);
 
-// ---------------------------------------------------------------
-// FUNÇÕES DE CONEXÃO BLYNK
-// ---------------------------------------------------------------
-void conectarBlynk() {
-  if (!Blynk.connected()) {
-    Serial.println("🔄 Reconectando ao Blynk...");
-    Blynk.connect();
-  }
+// Zona pelo número exibido ao usuário (1 a NUM_ZONAS); nullptr se não existir
+Zona* buscarZona(int numero) {
+  return (numero >= 1 && numero <= NUM_ZONAS) ? &zonas[numero - 1] : nullptr;
 }
 
-// Função de controle do botão no Blynk (V8)
-// Quando o botão é pressionado (valor 1), forçamos uma medição imediata.
-BLYNK_WRITE(V8) {
-  if (param.asInt() == 1) {
-    realizarMedicao(true);
+// Última medição da zona para quem roda no loop() (a mesma task que publica)
+const Medicao& medicaoAtual(const Zona& zona) {
+  return zona.ultimaMedicao.buffers[zona.ultimaMedicao.versao & 1];
+}
+
+// Cópia consistente da última medição para outras tasks; devolve a versão copiada
+uint32_t copiarMedicao(const Zona& zona, Medicao& destino) {
+  uint32_t versao;
+  do {
+    versao = zona.ultimaMedicao.versao;
+    __sync_synchronize();
+    destino = zona.ultimaMedicao.buffers[versao & 1];
+    __sync_synchronize();
+  } while (versao != zona.ultimaMedicao.versao);  // O loop() publicou durante a cópia
+  return versao;
+}
+
+// Publica uma amostra completa (só no loop()): grava o buffer inativo e troca a versão
+void publicarMedicao(Zona& zona, const Medicao& nova) {
+  zona.ultimaMedicao.buffers[(zona.ultimaMedicao.versao + 1) & 1] = nova;
+  __sync_synchronize();
+  zona.ultimaMedicao.versao = zona.ultimaMedicao.versao + 1;
+}
+
+// Prefixo das mensagens quando há mais de uma zona ("[Grow 2] ")
+String prefixoZona(const Zona& zona) {
+  return NUM_ZONAS > 1 ? "[" + String(zona.nome) + "] " : "";
+}
+
+// Funções de leitura usadas pela tabela. O DS18B20 é lido pelo endereço em cache
+// depois de uma única conversão para todas as zonas (ver converterTemperaturas()).
+float lerTemperaturaInterna(const Zona& zona) {
+  if (zona.sondaTemperatura >= numeroSondas) {
+    return LEITURA_DESCONECTADA;
   }
+  unsigned long inicio = micros();
+  float valor = sensors.getTempC(enderecosSondas[zona.sondaTemperatura]);  // DEVICE_DISCONNECTED_C se ausente
+  tempoLeituraSondasUs += micros() - inicio;
+  return valor;
 }
 
+// O DHT guarda a última leitura por 2 s, então zonas que o compartilham não repetem a leitura
+float lerTemperaturaExterna(const Zona& zona) {
+  return zona.dht->readTemperature();
+}
 
-// ---------------------------------------------------------------
-// FUNÇÃO PARA CODIFICAÇÃO DE URL
-// ---------------------------------------------------------------
-String urlEncode(String s) {
-  String encoded;
-  for (int i = 0; i < (int)s.length(); i++){
-    char c = s[i];
-    // Se o caractere é alfanumérico ou um dos permitidos, mantenha-o
-    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-      encoded += c;
-    } else {
-      // Caso contrário, codifique-o em formato hexadecimal
-      encoded += "%" + String((uint8_t)c, HEX);
-    }
+float lerUmidadeExterna(const Zona& zona) {
+  return zona.dht->readHumidity();
+}
+
+// Solo: leitura analógica (0 a 4095) convertida pela calibração do sensor da zona
+float lerSolo(const SensorSolo& sensor) {
+  int leitura = analogRead(sensor.pino);
+  if (leitura <= 0 || leitura >= 4095) {
+    return LEITURA_DESCONECTADA;  // Entrada presa em um dos extremos: sensor solto ou em curto
   }
-  return encoded;
+  return converterParaPorcentagem(leitura, sensor.seco, sensor.umido);
 }
 
+float lerSolo1(const Zona& zona) {
+  return lerSolo(zona.solo1);
+}
+
+float lerSolo2(const Zona& zona) {
+  return lerSolo(zona.solo2);
+}
+
+// Gera lerCalibrado_<campo>() para cada sensor: leitura já com a calibração aplicada
+// (NAN se falhou). bruto devolve a leitura sem calibração para o diagnóstico.
+#define SENSOR_LEITOR(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, ...) \
+  inline float lerCalibrado_##campo(const Zona& zona, float& bruto) { \
+    bruto = leitura(zona); \
+    return bruto == LEITURA_DESCONECTADA ? NAN : bruto * (escala) + (deslocamento); \
+  } \
+  inline float lerCalibrado_##campo(const Zona& zona) { \
+    float bruto; \
+    return lerCalibrado_##campo(zona, bruto); \
+  }
+SENSORES(SENSOR_LEITOR)
+#undef SENSOR_LEITOR
+
 
 // ---------------------------------------------------------------
-// FUNÇÃO: Gerar Link do Gráfico via QuickChart
+// CONEXÃO WI-FI
 // ---------------------------------------------------------------
-String gerarLinkGrafico() {
-  // Constrói listas de dados e rótulos para o gráfico
-  String labels = "";
-  String dataTI = "";
-  String dataTE = "";
-  String dataUE = "";
-  String dataSolo1 = "";
-  String dataSolo2 = "";
-  for (int i = 0; i < indiceMedicao; i++) {
-    // Rótulos com os horários das medições
-    labels += "\"" + historico[i].tempo + "\"";
-    // Dados das medições com 1 casa decimal
-    dataTI += String(historico[i].temperaturaInterna, 1);
-    dataTE += String(historico[i].temperaturaExterna, 1);
-    dataUE += String(historico[i].umidade, 1);
-    // Dados das medições com 1 casa decimal
-    dataSolo1 += String(historico[i].umidadeSolo1, 1);
-    dataSolo2 += String(historico[i].umidadeSolo2, 1);  // Agora usa o histórico correto
-
-    if (i < indiceMedicao - 1) {
-      labels += ",";
-      dataTI += ",";
-      dataTE += ",";
-      dataUE += ",";
-      dataSolo1 += ",";
-      dataSolo2 += ",";
-    }
-  }
+// O estado da conexão vem dos eventos do Wi-Fi (task do driver), sem consultar
+// WiFi.status(). O último AP (BSSID e canal) e a concessão de IP ficam na NVS e
+// na memória RTC: a reconexão vai direto ao canal certo com IP fixo, sem varredura
+// nem DHCP. Se o AP ou a rede mudaram, a tentativa rápida falha e a seguinte faz
+// a conexão completa, que grava os dados novos.
+struct ConexaoWiFi {
+  uint8_t bssid[6];
+  int32_t canal;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t mascara;
+  uint32_t dns;
+};
 
-  // Cria o objeto JSON para os datasets
-  String config = "{";
-  config += "\"type\":\"line\",";
-  config += "\"data\":{";
-  config += "\"labels\":[" + labels + "],";
-  config += "\"datasets\":[";
-  config += "{\"label\":\"Temp. Interna\",\"data\":[" + dataTI + "],\"borderColor\":\"red\",\"fill\":false},";
-  config += "{\"label\":\"Temp. Externa\",\"data\":[" + dataTE + "],\"borderColor\":\"blue\",\"fill\":false},";
-  config += "{\"label\":\"Umidade\",\"data\":[" + dataUE + "],\"borderColor\":\"green\",\"fill\":false},"; // <-- Adicione a vírgula aqui
-  config += "{\"label\":\"Umidade do Solo 1\",\"data\":[" + dataSolo1 + "],\"borderColor\":\"brown\",\"fill\":false},";
-  config += "{\"label\":\"Umidade do Solo 2 (S12)\",\"data\":[" + dataSolo2 + "],\"borderColor\":\"orange\",\"fill\":false}";
-  config += "]";
-  config += "},";
-  config += "\"options\":{";
-  config += "\"title\":{\"display\":true,\"text\":\"GrowMonitor - Medições\"}";
-  config += "}";
-  config += "}";
+enum EstadoWiFi { ESTADO_WIFI_DESCONECTADO, ESTADO_WIFI_CONECTANDO, ESTADO_WIFI_CONECTADO };
+volatile EstadoWiFi estadoWiFi = ESTADO_WIFI_DESCONECTADO;
+volatile bool conexaoWiFiPendente = false;        // IP obtido, ainda não registrado pelo loop
+volatile unsigned long tempoUltimaConexaoWiFiMs = 0;
+volatile uint8_t motivoUltimaQuedaWiFi = 0;       // wifi_err_reason_t do último STA_DISCONNECTED
+volatile uint32_t quedasWiFi = 0;
+unsigned long inicioConexaoWiFi = 0;              // millis() do WiFi.begin() atual
+bool conexaoRapidaWiFi = false;                   // A tentativa atual usa o AP e o IP salvos
+bool wifiDesligadoParaDormir = false;             // Queda provocada pelo light-sleep: não reconecta
+unsigned long ultimaTentativaWiFi = 0;
+const unsigned long intervaloReconexaoWiFiMin = 1000;    // Primeira espera após uma falha (1 s)
+const unsigned long intervaloReconexaoWiFiMax = 60000;   // Espera máxima entre tentativas (1 min)
+unsigned long intervaloReconexaoWiFi = intervaloReconexaoWiFiMin;
+const unsigned long timeoutConexaoRapidaWiFiMs = 3000;   // Com AP e IP salvos a conexão leva centenas de ms
+const unsigned long timeoutConexaoWiFiMs = 15000;
+
+// Histograma do tempo entre o WiFi.begin() e o IP obtido (limites superiores das faixas)
+const unsigned long limitesHistogramaWiFiMs[] = { 250, 500, 1000, 2000, 4000, 8000 };
+const int NUM_FAIXAS_WIFI = sizeof(limitesHistogramaWiFiMs) / sizeof(limitesHistogramaWiFiMs[0]) + 1;  // + acima de 8 s
+uint32_t histogramaConexaoWiFi[NUM_FAIXAS_WIFI];
+uint32_t conexoesRapidasWiFi = 0;
+uint32_t conexoesCompletasWiFi = 0;
+
+inline bool wifiConectado() {
+  return estadoWiFi == ESTADO_WIFI_CONECTADO;
+}
 
 
-  // Encode a configuração e monta a URL do QuickChart
-  String url = "https://quickchart.io/chart?c=" + urlEncode(config);
-  return url;
+// ---------------------------------------------------------------
+// BAIXO CONSUMO, MEMÓRIA RTC E FILA DE ENVIO
+// ---------------------------------------------------------------
+// Para as caixas a bateria/solar o ESP32 pode economizar entre as medições:
+//   normal    Wi-Fi e CPU sempre ativos (padrão)
+//   modem     Wi-Fi em modem-sleep e CPU a 80 MHz, ociosa entre as voltas do loop
+//   leve      light-sleep com despertar por timer; o Wi-Fi é desligado e reconectado
+//   profundo  deep-sleep; histórico recente, fila de envio e cache do Wi-Fi ficam na memória RTC
+// Nos modos leve e profundo o servidor web, o OTA e os comandos do Telegram só são
+// atendidos com o ESP32 acordado. Nunca dorme com uma bomba ligada, durante um OTA
+// ou nos primeiros minutos após ligar (janela de manutenção).
+enum ModoEnergia { ENERGIA_NORMAL, ENERGIA_MODEM, ENERGIA_LEVE, ENERGIA_PROFUNDO };
+ModoEnergia modoEnergia = ENERGIA_NORMAL;             // Alterável com /energia, salvo na NVS
+
+const unsigned long janelaManutencaoMs = 120000;      // Sempre acordado nos 2 primeiros minutos após ligar
+const unsigned long tempoMinimoAcordadoMs = 8000;     // Após cada despertar: Telegram, MQTT e fila de envio
+const unsigned long duracaoMinimaSonoMs = 5000;       // Sonos mais curtos não compensam a reconexão
+const unsigned long pausaLoopModemMs = 20;            // Ociosidade por volta do loop em modem-sleep
+const unsigned long timeoutWiFiDespertarMs = 10000;   // Depois disso mede sem rede e guarda na fila
+
+// Corrente típica do módulo ESP32 em cada estado (mA), usada na estimativa do consumo
+// médio. Valores de datasheet: LCD, LEDs, relés e sensores não entram na conta.
+const float correnteAcordadoMa = 110.0;   // CPU ativa com o Wi-Fi ligado
+const float correnteModemMa = 25.0;       // CPU ociosa com o rádio em modem-sleep
+const float correnteLeveMa = 0.8;         // Light-sleep
+const float correnteProfundoMa = 0.01;    // Deep-sleep (só o RTC)
+
+// Medição que não pôde ir ao Sheets/Firestore (Wi-Fi fora ou sem rede ao despertar)
+struct ItemFilaEnvio {
+  uint8_t zona;
+  Medicao medicao;
+};
+const int MAX_FILA_ENVIO = 12;
+
+// Estado na memória RTC lenta: sobrevive ao deep-sleep e a resets por software, não a um power-on
+struct EstadoRtc {
+  uint32_t assinatura;                    // Valida o conteúdo para este firmware (ver assinaturaRtc())
+  // Contabilidade de energia desde o último power-on
+  uint64_t tempoAcordadoMs;
+  uint64_t tempoDormindoMs;
+  double cargaMaMs;                       // Integral da corrente estimada (mA x ms)
+  uint32_t despertares;
+  // Numeração das amostras (todas as zonas): sessao muda a cada power-on, quando a
+  // sequência recomeça; deep-sleep e resets por software continuam a contagem
+  uint32_t sessaoAmostras;
+  uint32_t sequenciaAmostras;
+  // Último AP e concessão de IP (cópia da NVS), para reconectar sem varredura nem DHCP
+  bool wifiEmCache;
+  ConexaoWiFi wifi;
+  // Histórico recente e configuração alterável das zonas
+  Medicao historico[NUM_ZONAS][MAX_MEDICOES];
+  int indiceMedicao[NUM_ZONAS];
+  Medicao ultimaMedicao[NUM_ZONAS];
+  Irrigacao irrigacao[NUM_ZONAS];
+  float limiteTemperaturaAlerta[NUM_ZONAS];
+  float limiteUmidadeSoloAlerta[NUM_ZONAS];
+  // Fila de envio (anel)
+  ItemFilaEnvio fila[MAX_FILA_ENVIO];
+  uint8_t inicioFila;
+  uint8_t tamanhoFila;
+};
+static_assert(sizeof(EstadoRtc) <= 7 * 1024, "EstadoRtc não cabe na memória RTC lenta (8 KB)");
+RTC_NOINIT_ATTR EstadoRtc estadoRtc;  // Não inicializado pelo boot: validado por iniciarEstadoRtc()
+
+bool despertouDeepSleep = false;      // Este boot é a volta de um deep-sleep
+unsigned long marcoEnergiaMs = 0;     // millis() do início do período acordado atual
+bool otaEmAndamento = false;
+
+
+// Métricas de tempo do loop() (janela de 60 s, exposta em /metrics)
+const unsigned long janelaMetricasLoop = 60000;
+unsigned long inicioJanelaLoop = 0;
+unsigned long tempoLoopJanelaUs = 0;     // Tempo total gasto no loop() na janela atual
+unsigned long tempoBlynkJanelaUs = 0;    // Parte desse tempo gasta no Blynk
+unsigned long iteracoesLoopJanela = 0;
+float fracaoBlynkLoop = 0.0;             // % do loop() gasto no Blynk na última janela completa
+float loopMedioUs = 0.0;                 // Duração média do loop() na última janela completa
+
+// Bytes de carga útil por amostra em cada formato de uplink (corpo da mensagem, sem
+// cabeçalhos HTTP/MQTT nem overhead do TLS), para comparar os formatos em /metrics.
+// A mensagem do Telegram leva todas as zonas, as demais uma zona por envio.
+enum FormatoUplink { UPLINK_BINARIO, UPLINK_FIRESTORE, UPLINK_SHEETS, UPLINK_MQTT, UPLINK_TELEGRAM, NUM_FORMATOS_UPLINK };
+const char* const nomesFormatoUplink[NUM_FORMATOS_UPLINK] = { "binario", "firestore", "sheets", "mqtt", "telegram" };
+struct ContadorUplink {
+  uint32_t envios;
+  uint32_t bytes;
+  uint32_t ultimo;
+};
+ContadorUplink contadoresUplink[NUM_FORMATOS_UPLINK];
+
+void contarBytesUplink(FormatoUplink formato, size_t bytes) {
+  contadoresUplink[formato].envios++;
+  contadoresUplink[formato].bytes += bytes;
+  contadoresUplink[formato].ultimo = bytes;
 }
 
 
 
+// ---------------------------------------------------------------
+// DECLARAÇÃO DAS FUNÇÕES
+// ---------------------------------------------------------------
+bool realizarMedicao(bool forcarEnvioTelegram = false);
+void atualizarLCD();
+uint32_t pedirMedicao(OrigemPedidoMedicao origem, bool& emCache);
+void executarMedicaoPendente();
+void handleEstadoMedicao(AsyncWebServerRequest* request);  // GET /medicao?id=N
+void enviarMensagemTelegram(const String& msg, bool usarMarkdown, String modo);
+void verificarMensagensTelegram();
+bool ligarBomba(Zona& zona, OrigemBomba origem = ORIGEM_MANUAL, uint32_t duracaoMs = 0);
+void configurarTimerBomba(Zona& zona);
+bool bombaEstaLigada(const Zona& zona);
+void desligarBomba(Zona& zona, const String& mensagem = "", AcaoIrrigacao motivo = ACAO_NENHUMA);
+void atualizarIrrigacao();          // Executa a máquina de estados das bombas de todas as zonas
+void lerUmidadeSolo(Zona& zona);    // Lê os dois sensores de solo para o controle de irrigação
+void definirModoIrrigacao(Zona& zona, bool automatico);
+bool definirLimitesIrrigacao(Zona& zona, float ligar, float desligar);
+bool definirLimiteTemperatura(Zona& zona, float limite);
+bool definirLimiteUmidadeSolo(Zona& zona, float limite);
+void configurarComandosTelegram();  // Configura comandos via API do Telegram
+String urlEncode(const String& s);  // Função para codificar URL (para links)
+String gerarLinkGrafico(const Zona& zona);  // Gera URL do gráfico via QuickChart
+void enviarGraficoTelegram(const Zona& zona);  // Envia link do gráfico via Telegram
+void enviarDadosFirestore(const Zona& zona, const Medicao& medicao, const CarimboTempo& carimbo);
+void enviarGoogleSheets(const Zona& zona, const Medicao& medicao);
+void enviarIngestBinario(const Zona& zona, const Medicao& medicao);
+void enfileirarEnvio(const Zona& zona, const Medicao& medicao);
+const char* nomeModoEnergia(ModoEnergia modo);
+float cicloTrabalhoEnergia();       // % do tempo acordado desde o power-on
+float correnteMediaEstimadaMa();    // Consumo médio estimado do módulo ESP32
+void definirBlynkHabilitado(bool habilitado);
+void definirPainelTelegram(bool habilitado);
+void atualizarPainelTelegram(const String& conteudo, const char* hora, bool forcar);
+void contarChamadaTelegram(TipoChamadaTelegram tipo);
+void publicarEstadoMqtt(const Zona& zona);
+bool enfileirarComandoMqtt(TipoComandoWeb tipo, int zona, float valor);  // Comando MQTT para o loop()
+void registrarHistoricoFlash(const Zona& zona);
+void iniciarSondasTemperatura();    // Carrega/descobre os endereços DS18B20 e ajusta a resolução
+void converterTemperaturas();       // Uma conversão no ONE_WIRE_BUS para todas as sondas
+
 
 // ---------------------------------------------------------------
-// FUNÇÃO: Enviar Gráfico via Telegram
+// FUNÇÕES DE CONEXÃO BLYNK
 // ---------------------------------------------------------------
-void enviarGraficoTelegram() {
-  Serial.println("📊 Gerando link do gráfico...");
-  String link = gerarLinkGrafico();
-  Serial.println("✅ Link do gráfico gerado: " + link);
+bool blynkHabilitado = true;                          // Alterável em tempo de execução (/blynk on|off), salvo na NVS
+unsigned long ultimaTentativaBlynk = 0;               // millis() da última tentativa de conexão
+const unsigned long intervaloReconexaoBlynkMin = 5000;   // Primeira espera após uma falha (5 s)
+const unsigned long intervaloReconexaoBlynkMax = 300000; // Espera máxima entre tentativas (5 min)
+unsigned long intervaloReconexaoBlynk = intervaloReconexaoBlynkMin;
+const unsigned long timeoutConexaoBlynk = 3000;       // Limita o bloqueio de Blynk.connect()
+
+// Tenta conectar ao Blynk respeitando o backoff exponencial entre falhas
+void conectarBlynk(bool forcar = false) {
+  if (!blynkHabilitado || Blynk.connected() || !wifiConectado()) {
+    return;
+  }
+  if (!forcar && millis() - ultimaTentativaBlynk < intervaloReconexaoBlynk) {
+    return;
+  }
+  ultimaTentativaBlynk = millis();
 
-  // Cria mensagem HTML com link clicável
-  String mensagem = "<a href=\"" + link + "\">Clique aqui para visualizar o gráfico</a>";
-  // Envia mensagem com parse_mode HTML para que o link seja clicável
-  enviarMensagemTelegram(mensagem, false, "HTML");
+  logInfo("🔄 Reconectando ao Blynk...");
+  if (Blynk.connect(timeoutConexaoBlynk)) {
+    intervaloReconexaoBlynk = intervaloReconexaoBlynkMin;
+    logInfo("✅ Blynk conectado!");
+  } else {
+    intervaloReconexaoBlynk = min(intervaloReconexaoBlynk * 2, intervaloReconexaoBlynkMax);
+    logErro("❌ Falha ao conectar ao Blynk. Nova tentativa em " + String(intervaloReconexaoBlynk / 1000) + " s");
+  }
+}
+
+// Chamada a cada loop: processa o Blynk e contabiliza o tempo gasto
+void executarBlynk() {
+  if (!blynkHabilitado) {
+    return;
+  }
+  unsigned long inicio = micros();
+  if (Blynk.connected()) {
+    Blynk.run();
+  } else {
+    conectarBlynk();
+  }
+  tempoBlynkJanelaUs += micros() - inicio;
 }
 
+// Publica todos os canais de uma medição em uma única mensagem agrupada
+// (sensores nos pinos do registro, V4: Hora, V7: Bomba). O painel do Blynk
+// tem os pinos de uma única tenda, por isso só recebe a primeira zona.
+void publicarBlynk(const Zona& zona) {
+  if (!blynkHabilitado || !Blynk.connected()) {
+    return;  // Sem conexão não bloqueia a medição; o loop reconecta com backoff
+  }
+  unsigned long inicio = micros();
+  Blynk.beginGroup();
+#define SENSOR_BLYNK(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, pinoBlynk, ...) \
+  if (!isnan(medicaoAtual(zona).campo)) Blynk.virtualWrite(pinoBlynk, medicaoAtual(zona).campo);
+  SENSORES(SENSOR_BLYNK)
+#undef SENSOR_BLYNK
+  Blynk.virtualWrite(V4, medicaoAtual(zona).tempo);
+  Blynk.virtualWrite(V7, bombaEstaLigada(zona) ? 1 : 0);
+  Blynk.endGroup();
+  tempoBlynkJanelaUs += micros() - inicio;
+}
 
+// Liga/desliga o Blynk sem recompilar e guarda a escolha na NVS
+void definirBlynkHabilitado(bool habilitado) {
+  blynkHabilitado = habilitado;
+  preferencias.putBool("blynk", habilitado);
+  if (habilitado) {
+    intervaloReconexaoBlynk = intervaloReconexaoBlynkMin;
+    conectarBlynk(true);
+  } else {
+    Blynk.disconnect();
+  }
+  logInfo(String("✅ Blynk ") + (habilitado ? "HABILITADO" : "DESABILITADO"));
+  enviarMensagemTelegram(String("⚙️ Blynk ") + (habilitado ? "habilitado" : "desabilitado") + "!", false, "MarkdownV2");
+}
 
-// ---------------------------------------------------------------
-// FUNÇÕES: Ligar/Desligar Bomba
-// ---------------------------------------------------------------
-void ligarBomba() {
-  Serial.println("🔌 Tentando ligar a bomba...");
-  digitalWrite(RELE_BOMBA, HIGH); // Liga o relé (ativa a bomba)
-  Serial.println("💧 Bomba LIGADA! (GPIO26: " + String(digitalRead(RELE_BOMBA)) + ")");
-  enviarMensagemTelegram("💧 A bomba foi LIGADA!", false, "MarkdownV2");
+// Função de controle do botão no Blynk (V8)
+// Quando o botão é pressionado (valor 1), pede uma medição ao coordenador; ela roda
+// no loop(), fora do Blynk.run. Com uma medição recente o Blynk já mostra os valores dela.
+BLYNK_WRITE(V8) {
+  if (param.asInt() == 1) {
+    bool emCache;
+    uint32_t id = pedirMedicao(PEDIDO_BLYNK, emCache);
+    logInfo(emCache ? "♻️ Blynk V8: medição #" + String(id) + " ainda recente, sem nova leitura."
+                    : "📲 Blynk V8: medição #" + String(id) + " agendada.");
+  }
+}
+
+
+// ---------------------------------------------------------------
+// MQTT (HOME ASSISTANT / NODE-RED)
+// ---------------------------------------------------------------
+// Uma única conexão persistente (clean session = false) publica o estado
+// retido de cada zona em growmonitor/<id>/<zona>/estado e recebe comandos
+// em growmonitor/<id>/<zona>/.../set.
+WiFiClient mqttWifiClient;
+PubSubClient mqtt(mqttWifiClient);
+
+char mqttId[20];             // "growmonitor-XXXXXX" (final do MAC)
+char mqttBase[40];           // "growmonitor/XXXXXX"
+bool mqttDescobertaEnviada = false;
+
+unsigned long ultimaTentativaMqtt = 0;
+const unsigned long intervaloReconexaoMqttMin = 5000;
+const unsigned long intervaloReconexaoMqttMax = 300000;
+unsigned long intervaloReconexaoMqtt = intervaloReconexaoMqttMin;
+int ultimoEstadoBombaMqtt[NUM_ZONAS];  // Último estado da bomba publicado por zona (-1 = nunca)
+
+// Métricas de publicação (expostas em /metrics)
+unsigned long mqttPublicacoes = 0;
+unsigned long mqttFalhasPublicacao = 0;
+unsigned long mqttBytesPublicados = 0;
+unsigned long mqttTempoPublicacaoUs = 0;     // Soma das latências de publish()
+unsigned long mqttMaiorLatenciaUs = 0;
+
+bool mqttConfigurado() {
+  return mqttServer != nullptr && mqttServer[0] != '\0';
+}
+
+// Monta "growmonitor/<id>/<sufixo>" em um buffer do chamador
+void topicoMqtt(char* destino, size_t tamanho, const char* sufixo) {
+  snprintf(destino, tamanho, "%s/%s", mqttBase, sufixo);
+}
+
+// Monta "growmonitor/<id>/<zona>/<sufixo>"
+void topicoZonaMqtt(char* destino, size_t tamanho, const Zona& zona, const char* sufixo) {
+  snprintf(destino, tamanho, "%s/%s/%s", mqttBase, zona.id, sufixo);
+}
+
+// Publica medindo latência e volume
+bool publicarMqtt(const char* topico, const char* payload, bool retido) {
+  unsigned long inicio = micros();
+  bool ok = mqtt.publish(topico, payload, retido);
+  unsigned long latencia = micros() - inicio;
+
+  if (ok) {
+    mqttPublicacoes++;
+    mqttBytesPublicados += strlen(topico) + strlen(payload);
+    mqttTempoPublicacaoUs += latencia;
+    if (latencia > mqttMaiorLatenciaUs) mqttMaiorLatenciaUs = latencia;
+  } else {
+    mqttFalhasPublicacao++;
+  }
+  return ok;
+}
+
+// Publica a configuração de uma entidade da zona para o discovery do Home Assistant.
+// O "~" aponta para a base da zona; a disponibilidade é a do dispositivo.
+void publicarDescobertaMqtt(const Zona& zona, const char* componente, const char* objeto, const char* nome,
+                            const char* extra) {
+  char topico[112];
+  char payload[576];
+  snprintf(topico, sizeof(topico), "homeassistant/%s/%s/%s_%s/config", componente, mqttId, zona.id, objeto);
+  snprintf(payload, sizeof(payload),
+           "{\"~\":\"%s/%s\",\"name\":\"%s%s%s\",\"uniq_id\":\"%s_%s_%s\",\"avty_t\":\"%s/disponibilidade\",%s,"
+           "\"dev\":{\"ids\":[\"%s\"],\"name\":\"GrowMonitor\",\"mf\":\"CodeGreenLab\",\"mdl\":\"GrowMonitor VS\"}}",
+           mqttBase, zona.id, NUM_ZONAS > 1 ? zona.nome : "", NUM_ZONAS > 1 ? " " : "", nome,
+           mqttId, zona.id, objeto, mqttBase, extra, mqttId);
+  publicarMqtt(topico, payload, true);
+}
+
+void publicarDescobertasMqtt(const Zona& zona) {
+#define SENSOR_DESCOBERTA(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                          pinoBlynk, chaveSheets, chaveDados, classeHa, ...) \
+  publicarDescobertaMqtt(zona, "sensor", chave, rotulo, \
+    "\"stat_t\":\"~/estado\",\"val_tpl\":\"{{value_json." chave "}}\",\"unit_of_meas\":\"" unidade "\"," \
+    "\"dev_cla\":\"" classeHa "\"");
+  SENSORES(SENSOR_DESCOBERTA)
+#undef SENSOR_DESCOBERTA
+  publicarDescobertaMqtt(zona, "switch", "bomba", "Bomba",
+    "\"stat_t\":\"~/bomba/estado\",\"cmd_t\":\"~/bomba/set\",\"pl_on\":\"ON\",\"pl_off\":\"OFF\"");
+  publicarDescobertaMqtt(zona, "switch", "irrigacao", "Irrigação Automática",
+    "\"stat_t\":\"~/estado\",\"val_tpl\":\"{{value_json.ia}}\",\"cmd_t\":\"~/irrigacao/set\",\"pl_on\":\"ON\",\"pl_off\":\"OFF\","
+    "\"stat_on\":\"1\",\"stat_off\":\"0\"");
+  publicarDescobertaMqtt(zona, "number", "limite_temperatura", "Limite de Temperatura",
+    "\"stat_t\":\"~/estado\",\"val_tpl\":\"{{value_json.lt}}\",\"cmd_t\":\"~/limite/temperatura/set\","
+    "\"min\":0,\"max\":50,\"step\":0.5,\"unit_of_meas\":\"°C\"");
+  publicarDescobertaMqtt(zona, "number", "limite_umidade", "Limite de Umidade do Solo",
+    "\"stat_t\":\"~/estado\",\"val_tpl\":\"{{value_json.lu}}\",\"cmd_t\":\"~/limite/umidade/set\","
+    "\"min\":0,\"max\":100,\"step\":1,\"unit_of_meas\":\"%\"");
+}
+
+// Publica o snapshot da última medição da zona em formato compacto (retido)
+void publicarEstadoMqtt(const Zona& zona) {
+  if (!mqtt.connected()) {
+    return;
+  }
+  char topico[64];
+  char payload[96 + 24 * NUM_SENSORES];
+  topicoZonaMqtt(topico, sizeof(topico), zona, "estado");
+  int n = snprintf(payload, sizeof(payload), "{");
+#define SENSOR_ESTADO_MQTT(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+  n += snprintf(payload + n, sizeof(payload) - n, "\"" chave "\":%s,", valorJson(medicaoAtual(zona).campo, casas).c_str());
+  SENSORES(SENSOR_ESTADO_MQTT)
+#undef SENSOR_ESTADO_MQTT
+  snprintf(payload + n, sizeof(payload) - n,
+           "\"b\":%d,\"ia\":%d,\"lt\":%.1f,\"lu\":%.1f,\"h\":\"%s\"}",
+           bombaEstaLigada(zona) ? 1 : 0, zona.irrigacao.modoAutomatico ? 1 : 0,
+           zona.limiteTemperaturaAlerta, zona.limiteUmidadeSoloAlerta, medicaoAtual(zona).tempo);
+  publicarMqtt(topico, payload, true);
+  contarBytesUplink(UPLINK_MQTT, strlen(payload));
+}
+
+// Publica a saúde (0 a 100) de cada sensor da zona em <base>/<zona>/saude (retido)
+void publicarSaudeMqtt(const Zona& zona) {
+  if (!mqtt.connected()) {
+    return;
+  }
+  char topico[64];
+  char payload[8 + 16 * NUM_SENSORES];
+  topicoZonaMqtt(topico, sizeof(topico), zona, "saude");
+  int n = snprintf(payload, sizeof(payload), "{");
+  int indice = 0;
+#define SENSOR_SAUDE_MQTT(campo, chave, ...) \
+  n += snprintf(payload + n, sizeof(payload) - n, "%s\"" chave "\":%d", indice > 0 ? "," : "", \
+                pontuacaoSaude(zona.saude[indice])); \
+  indice++;
+  SENSORES(SENSOR_SAUDE_MQTT)
+#undef SENSOR_SAUDE_MQTT
+  snprintf(payload + n, sizeof(payload) - n, "}");
+  publicarMqtt(topico, payload, true);
+}
+
+// Trata os comandos recebidos nos tópicos .../set
+void callbackMqtt(char* topic, uint8_t* payload, unsigned int length) {
+  char valor[16];
+  unsigned int n = length < sizeof(valor) - 1 ? length : sizeof(valor) - 1;
+  memcpy(valor, payload, n);
+  valor[n] = '\0';
+
+  // Tópico: <base>/<zona>/<comando>/set
+  const char* sufixo = topic + strlen(mqttBase);
+  Zona* zona = nullptr;
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    size_t tamanhoId = strlen(zonas[i].id);
+    if (sufixo[0] == '/' && strncmp(sufixo + 1, zonas[i].id, tamanhoId) == 0 && sufixo[1 + tamanhoId] == '/') {
+      zona = &zonas[i];
+      sufixo += 1 + tamanhoId;
+      break;
+    }
+  }
+  if (zona == nullptr) {
+    return;
+  }
+  logInfo(String("📥 MQTT ") + zona->id + sufixo + " = " + valor);
+
+  // Comandos liga/desliga só aceitam "ON" e "OFF": qualquer outro valor é ignorado
+  bool ligado = strcmp(valor, "ON") == 0;
+  bool ligaDesliga = ligado || strcmp(valor, "OFF") == 0;
+  int indice = zona - zonas;
+
+  // Executados pelo loop() (Telegram e relé), pelo mesmo caminho da web e do Telegram
+  if (strcmp(sufixo, "/bomba/set") == 0 && ligaDesliga) {
+    enfileirarComandoMqtt(CMD_BOMBA_MQTT, indice, ligado ? 1 : 0);
+  } else if (strcmp(sufixo, "/irrigacao/set") == 0 && ligaDesliga) {
+    enfileirarComandoMqtt(CMD_MODO_IRRIGACAO, indice, ligado ? 1 : 0);
+  } else if (strcmp(sufixo, "/limite/temperatura/set") == 0) {
+    enfileirarComandoMqtt(CMD_LIMITE_TEMPERATURA, indice, atof(valor));
+  } else if (strcmp(sufixo, "/limite/umidade/set") == 0) {
+    enfileirarComandoMqtt(CMD_LIMITE_UMIDADE, indice, valor[0] != '\0' ? atof(valor) : NAN);
+  } else {
+    logAviso(String("⚠️ Comando MQTT ignorado: ") + zona->id + sufixo + " = " + valor);
+  }
+}
+
+void configurarMqtt() {
+  uint64_t mac = ESP.getEfuseMac();
+  snprintf(mqttId, sizeof(mqttId), "growmonitor-%06X", (unsigned int)((mac >> 24) & 0xFFFFFF));
+  snprintf(mqttBase, sizeof(mqttBase), "growmonitor/%06X", (unsigned int)((mac >> 24) & 0xFFFFFF));
+
+  mqtt.setServer(mqttServer, mqttPort);
+  mqtt.setCallback(callbackMqtt);
+  mqtt.setBufferSize(768);     // Payloads de discovery passam do padrão de 256 bytes
+  mqtt.setKeepAlive(60);
+  mqtt.setSocketTimeout(3);    // Limita o bloqueio do connect()
+}
+
+// Conecta com sessão persistente e LWT "offline", com backoff entre falhas
+void conectarMqtt() {
+  if (millis() - ultimaTentativaMqtt < intervaloReconexaoMqtt) {
+    return;
+  }
+  ultimaTentativaMqtt = millis();
+
+  char topicoDisponibilidade[64];
+  topicoMqtt(topicoDisponibilidade, sizeof(topicoDisponibilidade), "disponibilidade");
+
+  logInfo("🔄 Conectando ao broker MQTT...");
+  const char* usuario = (mqttUser != nullptr && mqttUser[0] != '\0') ? mqttUser : nullptr;
+  const char* senha = usuario != nullptr ? mqttPassword : nullptr;
+  if (mqtt.connect(mqttId, usuario, senha, topicoDisponibilidade, 1, true, "offline", false)) {
+    intervaloReconexaoMqtt = intervaloReconexaoMqttMin;
+    logInfo("✅ MQTT conectado como " + String(mqttId));
+    publicarMqtt(topicoDisponibilidade, "online", true);
+
+    char topico[64];
+    const char* comandos[] = { "bomba/set", "irrigacao/set", "limite/temperatura/set", "limite/umidade/set" };
+    for (Zona& zona : zonas) {
+      for (const char* comando : comandos) {
+        topicoZonaMqtt(topico, sizeof(topico), zona, comando);
+        mqtt.subscribe(topico, 1);
+      }
+    }
+
+    for (int i = 0; i < NUM_ZONAS; i++) {
+      if (!mqttDescobertaEnviada) {
+        publicarDescobertasMqtt(zonas[i]);
+      }
+      ultimoEstadoBombaMqtt[i] = -1;  // Força republicar o estado da bomba
+      publicarEstadoMqtt(zonas[i]);
+    }
+    mqttDescobertaEnviada = true;
+  } else {
+    intervaloReconexaoMqtt = min(intervaloReconexaoMqtt * 2, intervaloReconexaoMqttMax);
+    logErro("❌ Falha no MQTT (estado " + String(mqtt.state()) + "). Nova tentativa em " +
+                   String(intervaloReconexaoMqtt / 1000) + " s");
+  }
+}
+
+// Chamada a cada loop: mantém a sessão e publica mudanças de estado da bomba
+void executarMqtt() {
+  if (!mqttConfigurado() || !wifiConectado()) {
+    return;
+  }
+  if (!mqtt.connected()) {
+    conectarMqtt();
+    return;
+  }
+  mqtt.loop();
+
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    int estadoBomba = bombaEstaLigada(zonas[i]) ? 1 : 0;
+    if (estadoBomba != ultimoEstadoBombaMqtt[i]) {
+      char topico[64];
+      topicoZonaMqtt(topico, sizeof(topico), zonas[i], "bomba/estado");
+      if (publicarMqtt(topico, estadoBomba ? "ON" : "OFF", true)) {
+        ultimoEstadoBombaMqtt[i] = estadoBomba;
+      }
+    }
+  }
+}
+
+
+// ---------------------------------------------------------------
+// FUNÇÕES DE CODIFICAÇÃO (URL E JSON)
+// ---------------------------------------------------------------
+// Tabela de classes, codificarUrl() e codificarJson() em include/codificacao.h
+
+String urlEncode(const String& s) {
+  size_t tamanho = codificarUrl(s.c_str(), nullptr, 0, false);
+  std::unique_ptr<char[]> buffer(new (std::nothrow) char[tamanho + 1]);
+  if (!buffer) {
+    return String();
+  }
+  codificarUrl(s.c_str(), buffer.get(), tamanho + 1, false);
+  return String(buffer.get());
+}
+
+
+// ---------------------------------------------------------------
+// FUNÇÃO: Gerar Link do Gráfico via QuickChart
+// ---------------------------------------------------------------
+String gerarLinkGrafico(const Zona& zona) {
+  // Rótulos com os horários das medições
+  String labels = "";
+  for (int i = 0; i < zona.indiceMedicao; i++) {
+    if (i > 0) labels += ",";
+    labels += "\"" + String(zona.historico[i].tempo) + "\"";
+  }
+
+  // Uma série por sensor do registro
+  String datasets = "";
+#define SENSOR_GRAFICO(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                       pinoBlynk, chaveSheets, chaveDados, classeHa, cor, ...) \
+  if (datasets.length() > 0) datasets += ","; \
+  datasets += "{\"label\":\"" rotulo " (" unidade ")\",\"data\":["; \
+  for (int i = 0; i < zona.indiceMedicao; i++) { \
+    if (i > 0) datasets += ","; \
+    datasets += valorJson(zona.historico[i].campo, casas); \
+  } \
+  datasets += "],\"borderColor\":\"" cor "\",\"fill\":false}";
+  SENSORES(SENSOR_GRAFICO)
+#undef SENSOR_GRAFICO
+
+  // Cria o objeto JSON para os datasets
+  String config = "{";
+  config += "\"type\":\"line\",";
+  config += "\"data\":{";
+  config += "\"labels\":[" + labels + "],";
+  config += "\"datasets\":[" + datasets;
+  config += "]";
+  config += "},";
+  config += "\"options\":{";
+  config += "\"title\":{\"display\":true,\"text\":\"GrowMonitor - Medições" + String(NUM_ZONAS > 1 ? " - " : "") +
+            (NUM_ZONAS > 1 ? zona.nome : "") + "\"}";
+  config += "}";
+  config += "}";
+
+
+  // Encode a configuração e monta a URL do QuickChart
+  String url = "https://quickchart.io/chart?c=" + urlEncode(config);
+  return url;
+}
+
+
+
+
+// ---------------------------------------------------------------
+// FUNÇÃO: Enviar Gráfico via Telegram
+// ---------------------------------------------------------------
+void enviarGraficoTelegram(const Zona& zona) {
+  logInfo("📊 Gerando link do gráfico...");
+  String link = gerarLinkGrafico(zona);
+  logInfo("✅ Link do gráfico gerado: " + link);
+
+  // Cria mensagem HTML com link clicável
+  String mensagem = "<a href=\"" + link + "\">Clique aqui para visualizar o gráfico</a>";
+  // Envia mensagem com parse_mode HTML para que o link seja clicável
+  enviarMensagemTelegram(mensagem, false, "HTML");
+}
+
+
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Leitura do Solo e Controle da Bomba
+// ---------------------------------------------------------------
+
+// Acumula uma leitura de solo na média do controle (canais com falha ficam de fora)
+void somarSolo(float valor, float& soma, int& lidos) {
+  if (!isnan(valor)) {
+    soma += valor;
+    lidos++;
+  }
+}
+
+// Média dos canais PAPEL_SOLO de uma medição (NAN se nenhum respondeu)
+float mediaSoloMedicao(const Medicao& medicao) {
+  float soma = 0;
+  int lidos = 0;
+#define SENSOR_MEDIA_SOLO(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                          pinoBlynk, chaveSheets, chaveDados, classeHa, cor, minimo, maximo, travamento, barramento, papel) \
+  if (papel == PAPEL_SOLO) somarSolo(medicao.campo, soma, lidos);
+  SENSORES(SENSOR_MEDIA_SOLO)
+#undef SENSOR_MEDIA_SOLO
+  return lidos > 0 ? soma / lidos : NAN;
+}
+
+// Lê só os sensores de umidade do solo da zona (entradas PAPEL_SOLO do registro)
+// para o controle de irrigação, sem esperar a medição completa.
+void lerUmidadeSolo(Zona& zona) {
+  float soma = 0;
+  int lidos = 0;
+#define SENSOR_LER_SOLO(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                        pinoBlynk, chaveSheets, chaveDados, classeHa, cor, minimo, maximo, travamento, barramento, papel) \
+  if (papel == PAPEL_SOLO) somarSolo(lerCalibrado_##campo(zona), soma, lidos);
+  SENSORES(SENSOR_LER_SOLO)
+#undef SENSOR_LER_SOLO
+  zona.soloControle = lidos > 0 ? soma / lidos : NAN;
+  zona.leituraSoloValida = true;
+}
+
+// Umidade usada pelo controle de irrigação: média dos sensores de solo que
+// responderam (NAN se nenhum respondeu, o que nunca liga a bomba)
+float umidadeSoloControle(const Zona& zona) {
+  return zona.soloControle;
+}
+
+// Alerta de um canal conforme o seu papel no registro (NAN nunca alerta)
+bool alertaSensor(const Zona& zona, PapelSensor papel, float valor) {
+  switch (papel) {
+    case PAPEL_TEMPERATURA: return valor > zona.limiteTemperaturaAlerta;
+    case PAPEL_UMIDADE_AR:  return valor < limiteUmidadeArAlerta;
+    case PAPEL_SOLO:        return valor < zona.limiteUmidadeSoloAlerta;
+    default:                return false;
+  }
+}
+
+// Texto do alerta para o Telegram e para o LCD (20 colunas com "! Alerta: ")
+const char* textoAlerta(PapelSensor papel) {
+  switch (papel) {
+    case PAPEL_TEMPERATURA: return "Temperatura alta!";
+    case PAPEL_UMIDADE_AR:  return "Umidade baixa!";
+    case PAPEL_SOLO:        return "Solo seco!";
+    default:                return "";
+  }
+}
+
+const char* alertaLcd(PapelSensor papel) {
+  switch (papel) {
+    case PAPEL_TEMPERATURA: return "Temp Alta";
+    case PAPEL_UMIDADE_AR:  return "Umid Baixa";
+    case PAPEL_SOLO:        return "Solo Seco";
+    default:                return "";
+  }
+}
+
+bool bombaEstaLigada(const Zona& zona) {
+  return zona.irrigacao.estado == BOMBA_LIGADA;
+}
+
+String nomeEstadoBomba(const Zona& zona) {
+  switch (zona.irrigacao.estado) {
+    case BOMBA_LIGADA:  return "ligada";
+    case BOMBA_REPOUSO: return "repouso";
+    default:            return "desligada";
+  }
+}
+
+// Única função que escreve no relé da bomba
+void acionarReleBomba(Zona& zona, bool ligado) {
+  digitalWrite(zona.releBomba, ligado ? HIGH : LOW);
+}
+
+// Callback do esp_timer: corta o relé no prazo, sem depender do loop().
+// Roda na task do esp_timer, por isso só mexe no GPIO e em variáveis voláteis.
+void callbackTimerBomba(void* arg) {
+  Zona* zona = static_cast<Zona*>(arg);
+  gpio_set_level((gpio_num_t)zona->releBomba, 0);
+  zona->instanteCorteBombaUs = esp_timer_get_time();
+  zona->corteBombaPendente = true;
+}
+
+void configurarTimerBomba(Zona& zona) {
+  esp_timer_create_args_t args = {};
+  args.callback = &callbackTimerBomba;
+  args.arg = &zona;
+  args.name = "corte_bomba";
+  if (esp_timer_create(&args, &zona.timerBomba) != ESP_OK) {
+    zona.timerBomba = nullptr;
+    logErro(prefixoZona(zona) + "❌ Erro ao criar o timer da bomba! Usando o corte pelo loop().");
+  } else {
+    logInfo(prefixoZona(zona) + "✅ Timer de segurança da bomba configurado.");
+  }
+}
+
+// Sincroniza a máquina de estados depois que o timer cortou o relé
+// e registra o atraso do corte em relação ao prazo programado.
+void processarCorteBomba(Zona& zona) {
+  zona.corteBombaPendente = false;
+  int64_t agoraUs = esp_timer_get_time();
+  atrasoCorteBombaMs = (zona.instanteCorteBombaUs - zona.prazoBombaUs) / 1000.0;
+  if (atrasoCorteBombaMs > maiorAtrasoCorteBombaMs) {
+    maiorAtrasoCorteBombaMs = atrasoCorteBombaMs;
+  }
+  float atrasoLoopMs = (agoraUs - zona.instanteCorteBombaUs) / 1000.0;
+
+  unsigned long duracao = (millis() - zona.irrigacao.inicioEstado) / 1000;
+  // O repouso conta a partir do corte real, não de quando o loop percebeu
+  registrarBombaDesligada(zona.irrigacao, ACAO_DESLIGAR_TEMPO, millis() - (uint32_t)atrasoLoopMs);
+
+  logInfo(prefixoZona(zona) + "⏱️ Bomba desligada pelo timer. Atraso do corte: " + String(atrasoCorteBombaMs, 3) +
+                 " ms (loop percebeu " + String(atrasoLoopMs, 0) + " ms depois)");
+  enviarMensagemTelegram(prefixoZona(zona) + "💧 A bomba foi DESLIGADA! (" + String(duracao) + " s ligada)\n"
+                         "⏱️ Tempo programado atingido.", false, "MarkdownV2");
+}
+
+// Liga a bomba da zona respeitando o repouso mínimo. Retorna false se o pedido foi recusado.
+// duracaoMs = 0 usa o tempo máximo configurado; valores maiores são limitados a ele.
+bool ligarBomba(Zona& zona, OrigemBomba origem, uint32_t duracaoMs) {
+  Irrigacao& irrigacao = zona.irrigacao;
+  if (bombaEstaLigada(zona)) {
+    return true;
+  }
+
+  if (irrigacao.estado == BOMBA_REPOUSO) {
+    unsigned long restante = repousoRestante(irrigacao, millis()) / 1000;
+    logInfo(prefixoZona(zona) + "⏳ Bomba em repouso. Faltam " + String(restante) + " s para religar.");
+    if (origem == ORIGEM_MANUAL) {
+      enviarMensagemTelegram(prefixoZona(zona) + "⏳ Bomba em repouso! Aguarde " + String(restante) + " s para religar.", false, "MarkdownV2");
+    }
+    return false;
+  }
+
+  logInfo(prefixoZona(zona) + "🔌 Tentando ligar a bomba...");
+  duracaoMs = registrarBombaLigada(irrigacao, origem, duracaoMs, millis());
+  zona.corteBombaPendente = false;
+  acionarReleBomba(zona, true);  // Liga o relé (ativa a bomba)
+
+  // Programa o corte no prazo exato pelo esp_timer
+  zona.prazoBombaUs = esp_timer_get_time() + (int64_t)duracaoMs * 1000;
+  if (zona.timerBomba != nullptr) {
+    esp_timer_start_once(zona.timerBomba, (uint64_t)duracaoMs * 1000);
+  }
+  logInfo(prefixoZona(zona) + "💧 Bomba LIGADA por até " + String(duracaoMs / 1000) + " s! (GPIO" +
+                 String(zona.releBomba) + ": " + String(digitalRead(zona.releBomba)) + ")");
+
+  if (origem == ORIGEM_AUTOMATICA) {
+    enviarMensagemTelegram(prefixoZona(zona) + "💧 Irrigação automática: bomba LIGADA! Solo em " + String(umidadeSoloControle(zona), 1) + "%", false, "MarkdownV2");
+  } else {
+    enviarMensagemTelegram(prefixoZona(zona) + "💧 A bomba foi LIGADA!", false, "MarkdownV2");
+  }
+  return true;
+}
+
+// Desliga a bomba da zona e inicia o repouso mínimo antes de um novo acionamento.
+// "mensagem" vai ao Telegram; "motivo" fica em irrigacao.motivoDesligamento.
+void desligarBomba(Zona& zona, const String& mensagem, AcaoIrrigacao motivo) {
+  if (!bombaEstaLigada(zona)) {
+    logInfo(prefixoZona(zona) + "ℹ️ Bomba já está desligada.");
+    return;
+  }
+
+  // Cancela o corte programado; se o timer já disparou, o desligamento foi dele
+  if (zona.timerBomba != nullptr) {
+    esp_timer_stop(zona.timerBomba);
+  }
+  if (zona.corteBombaPendente) {
+    processarCorteBomba(zona);
+    return;
+  }
+
+  logInfo(prefixoZona(zona) + "🔌 Tentando desligar a bomba...");
+  unsigned long duracao = (millis() - zona.irrigacao.inicioEstado) / 1000;
+  acionarReleBomba(zona, false);  // Desliga o relé (desativa a bomba)
+  registrarBombaDesligada(zona.irrigacao, motivo, millis());
+  logInfo(prefixoZona(zona) + "💧 Bomba DESLIGADA após " + String(duracao) + " s! (GPIO" +
+                 String(zona.releBomba) + ": " + String(digitalRead(zona.releBomba)) + ")");
+
+  String texto = prefixoZona(zona) + "💧 A bomba foi DESLIGADA! (" + String(duracao) + " s ligada)";
+  if (mensagem.length() > 0) {
+    texto += "\n" + mensagem;
+  }
+  enviarMensagemTelegram(texto, false, "MarkdownV2");
+}
+
+// Máquina de estados de uma zona: sincroniza o corte do timer e executa a ação de decidirIrrigacao()
+void atualizarIrrigacaoZona(Zona& zona) {
+  Irrigacao& irrigacao = zona.irrigacao;
+  unsigned long agora = millis();
+
+  if (irrigacao.estado == BOMBA_LIGADA && zona.corteBombaPendente) {
+    processarCorteBomba(zona);
+    return;
+  }
+
+  bool soloLido = leituraSoloDevida(irrigacao, agora);
+  if (soloLido) {
+    irrigacao.ultimaLeituraSolo = agora;
+    lerUmidadeSolo(zona);
+  }
+
+  switch (decidirIrrigacao(irrigacao, agora, soloLido, zona.leituraSoloValida, umidadeSoloControle(zona))) {
+    case ACAO_LIGAR:
+      ligarBomba(zona, ORIGEM_AUTOMATICA);
+      break;
+
+    case ACAO_DESLIGAR_ALVO:
+      desligarBomba(zona, "🎯 Umidade alvo atingida: " + String(umidadeSoloControle(zona), 1) + "%", ACAO_DESLIGAR_ALVO);
+      break;
+
+    case ACAO_DESLIGAR_SEM_LEITURA:
+      desligarBomba(zona, "⚠️ Sensores de solo sem leitura.", ACAO_DESLIGAR_SEM_LEITURA);
+      break;
+
+    case ACAO_DESLIGAR_TEMPO:
+      // Com o timer, o corte no prazo é dele (processarCorteBomba); sem ele,
+      // o tempo máximo é garantido (com atraso) pelo próprio loop
+      if (zona.timerBomba == nullptr) {
+        zona.instanteCorteBombaUs = esp_timer_get_time();
+        desligarBomba(zona, "⏱️ Tempo máximo de funcionamento atingido (atraso de " +
+                      String((zona.instanteCorteBombaUs - zona.prazoBombaUs) / 1000.0, 0) + " ms).",
+                      ACAO_DESLIGAR_TEMPO);
+      }
+      break;
+
+    case ACAO_FIM_REPOUSO:
+      registrarFimRepouso(irrigacao);
+      logInfo(prefixoZona(zona) + "✅ Repouso da bomba concluído.");
+      break;
+
+    case ACAO_NENHUMA:
+      break;
+  }
+}
+
+// Executada a cada loop para todas as zonas
+void atualizarIrrigacao() {
+  for (Zona& zona : zonas) {
+    atualizarIrrigacaoZona(zona);
+  }
+}
+
+// Ativa ou desativa o controle automático da bomba da zona
+void definirModoIrrigacao(Zona& zona, bool automatico) {
+  zona.irrigacao.modoAutomatico = automatico;
+  logInfo(prefixoZona(zona) + "✅ Irrigação automática " + (automatico ? "ATIVADA" : "DESATIVADA"));
+  enviarMensagemTelegram(prefixoZona(zona) + "⚙️ Irrigação automática " + (automatico ? "ativada" : "desativada") + "!", false, "MarkdownV2");
+}
+
+// Atualiza os limites da histerese da zona. Retorna false se os valores forem inválidos.
+bool definirLimitesIrrigacao(Zona& zona, float ligar, float desligar) {
+  if (ligar < 0 || desligar > 100 || ligar >= desligar) {
+    logErro("❌ Limites de irrigação inválidos!");
+    return false;
+  }
+  zona.irrigacao.limiteLigar = ligar;
+  zona.irrigacao.limiteDesligar = desligar;
+  logInfo(prefixoZona(zona) + "✅ Irrigação: liga abaixo de " + String(ligar, 1) + "% e desliga em " + String(desligar, 1) + "%");
+  enviarMensagemTelegram(prefixoZona(zona) + "⚙️ Irrigação: liga abaixo de " + String(ligar, 1) + "% e desliga em " + String(desligar, 1) + "%", false, "MarkdownV2");
+  return true;
+}
+
+// Limites dos alertas da zona. Web, Telegram e MQTT passam por aqui (validação,
+// log e aviso no Telegram iguais). Retornam false se o valor for inválido.
+bool definirLimiteTemperatura(Zona& zona, float limite) {
+  if (!(limite > 0)) {
+    logErro(prefixoZona(zona) + "❌ Limite de temperatura inválido!");
+    return false;
+  }
+  zona.limiteTemperaturaAlerta = limite;
+  logInfo(prefixoZona(zona) + "✅ Novo limite de temperatura: " + String(limite, 1) + "°C");
+  enviarMensagemTelegram(prefixoZona(zona) + "⚙️ Novo limite de temperatura: " + String(limite, 1) + "°C", false, "MarkdownV2");
+  return true;
+}
+
+bool definirLimiteUmidadeSolo(Zona& zona, float limite) {
+  if (!(limite >= 0 && limite <= 100)) {
+    logErro(prefixoZona(zona) + "❌ Limite de umidade do solo inválido!");
+    return false;
+  }
+  zona.limiteUmidadeSoloAlerta = limite;
+  logInfo(prefixoZona(zona) + "✅ Novo limite de umidade do solo: " + String(limite, 1) + "%");
+  enviarMensagemTelegram(prefixoZona(zona) + "⚙️ Novo limite de umidade do solo: " + String(limite, 1) + "%", false, "MarkdownV2");
+  return true;
+}
+
+
+// ---------------------------------------------------------------
+// FUNÇÃO: Configurar Comandos do Telegram via API
+// ---------------------------------------------------------------
+void configurarComandosTelegram() {
+  logInfo("🔧 Configurando comandos do Telegram via setMyCommands (POST)...");
+
+  // JSON atualizado com os comandos disponíveis
+  String jsonBody = F("{\"commands\":[" 
+    "{\"command\":\"start\",\"description\":\"Inicia o bot e exibe informações\"},"
+    "{\"command\":\"medir\",\"description\":\"Realiza uma medição agora\"},"
+    "{\"command\":\"alertatemperatura\",\"description\":\"Define alerta de temperatura\"},"
+    "{\"command\":\"alertaumidade\",\"description\":\"Define alerta de umidade do solo\"},"
+    "{\"command\":\"bombaligar\",\"description\":\"Liga a bomba d'água\"},"
+    "{\"command\":\"bombadesligar\",\"description\":\"Desliga a bomba d'água\"},"
+    "{\"command\":\"irrigacaoauto\",\"description\":\"Liga/desliga a irrigação automática (on/off)\"},"
+    "{\"command\":\"irrigacaolimites\",\"description\":\"Define os limites da irrigação automática\"},"
+    "{\"command\":\"blynk\",\"description\":\"Habilita/desabilita o Blynk (on/off)\"},"
+    "{\"command\":\"grafico\",\"description\":\"Exibe gráfico das últimas medições\"},"
+    "{\"command\":\"saude\",\"description\":\"Exibe a saúde de cada sensor\"},"
+    "{\"command\":\"energia\",\"description\":\"Modo de energia (normal/modem/leve/profundo)\"},"
+    "{\"command\":\"log\",\"description\":\"Exibe as últimas mensagens de diagnóstico\"},"
+    "{\"command\":\"painel\",\"description\":\"Painel fixado com a última medição (on/off)\"},"
+    "{\"command\":\"help\",\"description\":\"Exibe a lista de comandos disponíveis\"}"
+  "]}");
+
+  // POST pela conexão persistente com o Telegram
+  HTTPClient http;
+  contarChamadaTelegram(TG_OUTRAS);
+  int httpResponseCode = requisicaoHttps(HOST_TELEGRAM, http, "https://api.telegram.org/bot" + String(botToken) + "/setMyCommands", &jsonBody);
+  if (httpResponseCode > 0) {
+    String resposta = http.getString();
+    if (httpResponseCode == HTTP_CODE_OK) {
+      logInfo("✅ Comandos configurados via API do Telegram (POST).");
+    } else {
+      logErro("❌ Telegram recusou os comandos. Código HTTP: " + String(httpResponseCode));
+      logDebug("📩 Telegram: " + resposta);
+    }
+  } else {
+    logErro("❌ Erro ao conectar ao Telegram para configurar comandos.");
+  }
+  http.end();
+}
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Métricas de Desempenho
+// ---------------------------------------------------------------
+
+// Acumula a duração de cada loop() e fecha a janela a cada 60 s
+void contabilizarLoop(unsigned long duracaoUs) {
+  tempoLoopJanelaUs += duracaoUs;
+  iteracoesLoopJanela++;
+
+  if (millis() - inicioJanelaLoop >= janelaMetricasLoop) {
+    if (tempoLoopJanelaUs > 0) {
+      fracaoBlynkLoop = 100.0 * tempoBlynkJanelaUs / tempoLoopJanelaUs;
+      loopMedioUs = (float)tempoLoopJanelaUs / iteracoesLoopJanela;
+    }
+    logInfo("📈 Loop médio: " + String(loopMedioUs, 0) + " us | Blynk: " + String(fracaoBlynkLoop, 1) + "% do loop");
+    tempoLoopJanelaUs = 0;
+    tempoBlynkJanelaUs = 0;
+    iteracoesLoopJanela = 0;
+    inicioJanelaLoop = millis();
+  }
+}
+
+// Handler para a rota "/api/esquema" – layout do pacote binário de ingestão e, em
+// "sensores", as entradas do registro SENSORES (o painel web monta cartões e gráficos com elas)
+void handleEsquema(AsyncWebServerRequest* request) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->print("{\"versao\":" + String(VERSAO_PACOTE) + ",\"tamanho\":" + String(sizeof(PacoteAmostra)) + ",\"campos\":[");
+  int indice = 0;
+#define SENSOR_ESQUEMA_CAMPO(campo, chave, ...) \
+  response->print(String(indice++ > 0 ? "," : "") + "\"" chave "\"");
+  SENSORES(SENSOR_ESQUEMA_CAMPO)
+#undef SENSOR_ESQUEMA_CAMPO
+  response->print("],\"casas\":[");
+  indice = 0;
+#define SENSOR_ESQUEMA_CASAS(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+  response->print(String(indice++ > 0 ? "," : "") + String(casas));
+  SENSORES(SENSOR_ESQUEMA_CASAS)
+#undef SENSOR_ESQUEMA_CASAS
+  response->print("],\"sensores\":[");
+  indice = 0;
+#define SENSOR_ESQUEMA_SENSOR(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                              pinoBlynk, chaveSheets, chaveDados, classeHa, cor, ...) \
+  response->print(String(indice++ > 0 ? "," : "") + "{\"chave\":\"" chave "\",\"rotulo\":\"" rotulo "\",\"unidade\":\"" \
+                  unidade "\",\"icone\":\"" icone "\",\"casas\":" + String(casas) + ",\"cor\":\"" cor "\"}");
+  SENSORES(SENSOR_ESQUEMA_SENSOR)
+#undef SENSOR_ESQUEMA_SENSOR
+  response->print("],\"zonas\":[");
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    response->print(String(i > 0 ? "," : "") + "\"" + zonas[i].id + "\"");
+  }
+  response->print("]}");
+  request->send(response);
+}
+
+// Handler para a rota "/metrics" – métricas internas em JSON
+void handleMetricas(AsyncWebServerRequest* request) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->print("{");
+  response->print("\"uptimeS\":" + String(millis() / 1000) + ",");
+  response->print("\"heapLivre\":" + String(ESP.getFreeHeap()) + ",");
+  response->print("\"maiorBlocoLivre\":" + String(ESP.getMaxAllocHeap()) + ",");
+  response->print("\"relogioSincronizado\":" + String(relogioSincronizado() ? "true" : "false") + ",");
+  response->print("\"sincronizacoesNtp\":" + String(sincronizacoesNtp) + ",");
+  response->print("\"loopMedioUs\":" + String(loopMedioUs, 0) + ",");
+  response->print("\"blynkHabilitado\":" + String(blynkHabilitado ? "true" : "false") + ",");
+  response->print("\"blynkConectado\":" + String(blynkHabilitado && Blynk.connected() ? "true" : "false") + ",");
+  response->print("\"blynkFracaoLoop\":" + String(fracaoBlynkLoop, 2) + ",");
+  response->print("\"blynkProximaTentativaS\":" + String(intervaloReconexaoBlynk / 1000) + ",");
+  response->print("\"mqttConectado\":" + String(mqtt.connected() ? "true" : "false") + ",");
+  response->print("\"mqttPublicacoes\":" + String(mqttPublicacoes) + ",");
+  response->print("\"mqttFalhas\":" + String(mqttFalhasPublicacao) + ",");
+  response->print("\"mqttBytes\":" + String(mqttBytesPublicados) + ",");
+  response->print("\"mqttLatenciaMediaUs\":" + String(mqttPublicacoes ? mqttTempoPublicacaoUs / mqttPublicacoes : 0) + ",");
+  response->print("\"mqttMaiorLatenciaUs\":" + String(mqttMaiorLatenciaUs) + ",");
+  response->print("\"mqttPublicacoesPorMin\":" + String(millis() > 0 ? 60000.0 * mqttPublicacoes / millis() : 0.0, 2) + ",");
+  response->print("\"historicoUltimaConsultaPontos\":" + String(historicoUltimaConsultaPontos) + ",");
+  response->print("\"graficoSvgPontos\":" + String(graficoSvgUltimosPontos) + ",");
+  response->print("\"graficoSvgMs\":" + String(graficoSvgUltimoMs) + ",");
+  response->print("\"historicoUltimaConsultaMs\":" + String(historicoUltimaConsultaMs) + ",");
+  response->print("\"estaticos304\":" + String(estaticosNaoModificados) + ",");
+  response->print("\"estaticosRam\":" + String(estaticosRam) + ",");
+  response->print("\"estaticosFlash\":" + String(estaticosFlash) + ",");
+  response->print("\"ds18b20Sondas\":" + String(numeroSondas) + ",");
+  response->print("\"ds18b20ConversaoMs\":" + String(tempoConversaoSondasUs / 1000.0, 1) + ",");
+  response->print("\"ds18b20LeituraUs\":" + String(tempoLeituraSondasUs) + ",");
+  response->print("\"wifiConectado\":" + String(wifiConectado() ? "true" : "false") + ",");
+  response->print("\"wifiRssi\":" + String(wifiConectado() ? WiFi.RSSI() : 0) + ",");
+  response->print("\"wifiQuedas\":" + String(quedasWiFi) + ",");
+  response->print("\"wifiUltimoMotivoQueda\":" + String(motivoUltimaQuedaWiFi) + ",");
+  response->print("\"wifiConexoesRapidas\":" + String(conexoesRapidasWiFi) + ",");
+  response->print("\"wifiConexoesCompletas\":" + String(conexoesCompletasWiFi) + ",");
+  response->print("\"wifiUltimaConexaoMs\":" + String(tempoUltimaConexaoWiFiMs) + ",");
+  // Conexões por faixa de tempo: chave = limite superior em ms ("mais" = acima do último)
+  response->print("\"wifiHistogramaConexaoMs\":{");
+  for (int i = 0; i < NUM_FAIXAS_WIFI; i++) {
+    String faixa = i < NUM_FAIXAS_WIFI - 1 ? String(limitesHistogramaWiFiMs[i]) : String("mais");
+    response->print(String(i > 0 ? "," : "") + "\"" + faixa + "\":" + String(histogramaConexaoWiFi[i]));
+  }
+  response->print("},");
+  response->print("\"energiaModo\":\"" + String(nomeModoEnergia(modoEnergia)) + "\",");
+  response->print("\"energiaCicloTrabalho\":" + String(cicloTrabalhoEnergia(), 2) + ",");
+  response->print("\"energiaCorrenteMediaMa\":" + String(correnteMediaEstimadaMa(), 2) + ",");
+  response->print("\"energiaDespertares\":" + String(estadoRtc.despertares) + ",");
+  response->print("\"filaEnvio\":" + String(estadoRtc.tamanhoFila) + ",");
+  // Carga útil por formato de uplink: última e média por envio
+  response->print("\"bytesUplink\":{");
+  for (int i = 0; i < NUM_FORMATOS_UPLINK; i++) {
+    const ContadorUplink& contador = contadoresUplink[i];
+    response->print(String(i > 0 ? "," : "") + "\"" + nomesFormatoUplink[i] + "\":{\"ultimo\":" + String(contador.ultimo) +
+                    ",\"medio\":" + String(contador.envios ? (float)contador.bytes / contador.envios : 0.0f, 1) +
+                    ",\"envios\":" + String(contador.envios) + "}");
+  }
+  response->print("},");
+  response->print("\"saudeSensores\":{");
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    const Zona& zona = zonas[i];
+    response->print(String(i > 0 ? "," : "") + "\"" + zona.id + "\":{");
+    int indice = 0;
+#define SENSOR_SAUDE_METRICAS(campo, chave, ...) \
+    response->print(String(indice > 0 ? "," : "") + "\"" chave "\":" + String(pontuacaoSaude(zona.saude[indice]))); \
+    indice++;
+    SENSORES(SENSOR_SAUDE_METRICAS)
+#undef SENSOR_SAUDE_METRICAS
+    response->print("}");
+  }
+  response->print("},");
+  // Conexões HTTPS persistentes: handshakes completos x requisições reaproveitadas
+  response->print("\"tls\":{");
+  for (int i = 0; i < NUM_HOSTS_TLS; i++) {
+    const ConexaoTls& conexao = conexoesTls[i];
+    response->print(String(i > 0 ? "," : "") + "\"" + conexao.host + "\":{\"handshakes\":" + String(conexao.handshakes) +
+                    ",\"reutilizacoes\":" + String(conexao.reutilizacoes) + ",\"falhas\":" + String(conexao.falhas) +
+                    ",\"ultimoHandshakeMs\":" + String(conexao.ultimoHandshakeMs) +
+                    ",\"medioHandshakeMs\":" + String(conexao.handshakes ? (float)conexao.somaHandshakeMs / conexao.handshakes : 0.0f, 1) + "}");
+  }
+  response->print("},");
+  response->print("\"tlsSlots\":" + String(NUM_SLOTS_TLS) + ",");
+  response->print("\"tlsSlotsOcupados\":" + String(slotsTlsOcupados()) + ",");
+  response->print("\"tlsSlotsMaximo\":" + String(maximoSlotsTlsOcupados) + ",");
+  response->print("\"tlsDespejos\":" + String(despejosTls) + ",");
+  response->print("\"tlsMemoriaConexao\":" + String(memoriaConexaoTls) + ",");
+  response->print("\"logEntradas\":" + String(proximaSequenciaLog - 1) + ",");
+  response->print(String("\"logNivel\":\"") + nomesNivelLog[nivelMinimoLog] + "\",");
+  response->print(String("\"logArquivo\":") + (logEmArquivo ? "true" : "false") + ",");
+  response->print("\"logPerdidas\":" + String(entradasLogPerdidas) + ",");
+  response->print("\"medicaoPedidos\":" + String(coordenadorMedicao.pedidos) + ",");
+  response->print("\"medicaoCompartilhadas\":" + String(coordenadorMedicao.compartilhados) + ",");
+  response->print("\"medicaoRespondidasCache\":" + String(coordenadorMedicao.respondidosCache) + ",");
+  response->print("\"medicaoExecucoes\":" + String(coordenadorMedicao.execucoes) + ",");
+  response->print(String("\"telegramPainel\":") + (painelTelegram ? "true" : "false") + ",");
+  response->print("\"telegramPainelPulos\":" + String(atualizacoesPainelPuladas) + ",");
+  for (int hora = 0; hora < 2; hora++) {
+    // Total desde o boot e última hora completa, por tipo de chamada
+    const uint32_t* contagem = hora ? chamadasTelegramHora : chamadasTelegram;
+    response->print(hora ? "\"telegramChamadasHora\":{" : "\"telegramChamadas\":{");
+    for (int tipo = 0; tipo < NUM_TIPOS_CHAMADA_TELEGRAM; tipo++) {
+      response->print(String(tipo ? "," : "") + "\"" + nomesChamadaTelegram[tipo] + "\":" + String(contagem[tipo]));
+    }
+    response->print("},");
+  }
+  response->print("\"bombaAtrasoCorteMs\":" + String(atrasoCorteBombaMs, 3) + ",");
+  response->print("\"bombaMaiorAtrasoCorteMs\":" + String(maiorAtrasoCorteBombaMs, 3));
+  response->print("}");
+
+  request->send(response);
+}
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Log de Diagnóstico
+// ---------------------------------------------------------------
+const int entradasLogTelegram = 15;      // Padrão do /log
+const int maxEntradasLogTelegram = 25;   // Cabe em uma mensagem do Telegram
+
+// Primeira sequência ainda presente no anel
+uint32_t sequenciaMaisAntigaLog() {
+  uint32_t proxima = proximaSequenciaLog;
+  return proxima > (uint32_t)CAPACIDADE_LOG ? proxima - CAPACIDADE_LOG : 1;
+}
+
+// Copia uma entrada do anel; false se ela ainda não existe ou já foi sobrescrita
+bool copiarEntradaLog(uint32_t sequencia, EntradaLog& copia) {
+  portENTER_CRITICAL(&muxLog);
+  const EntradaLog& entrada = anelLog[(sequencia - 1) % CAPACIDADE_LOG];
+  bool valida = sequencia > 0 && entrada.sequencia == sequencia;
+  if (valida) {
+    copia = entrada;
+  }
+  portEXIT_CRITICAL(&muxLog);
+  return valida;
+}
+
+// "dd/mm HH:MM:SS [nivel] texto" (com o tempo desde o boot se o relógio não tinha hora)
+String formatarEntradaLog(const EntradaLog& entrada) {
+  char tempo[24];
+  if (entrada.epoch >= epochMinimoValido) {
+    struct tm local;
+    localtime_r(&entrada.epoch, &local);
+    strftime(tempo, sizeof(tempo), "%d/%m %H:%M:%S", &local);
+  } else {
+    snprintf(tempo, sizeof(tempo), "+%lu.%03lus", (unsigned long)(entrada.ms / 1000), (unsigned long)(entrada.ms % 1000));
+  }
+  return String(tempo) + " [" + nomesNivelLog[entrada.nivel] + "] " + entrada.texto;
+}
+
+bool interpretarNivelLog(const String& texto, NivelLog& nivel) {
+  for (int i = LOG_DEBUG; i <= LOG_ERRO; i++) {
+    if (texto == nomesNivelLog[i]) {
+      nivel = (NivelLog)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void definirNivelLog(NivelLog nivel) {
+  nivelMinimoLog = nivel;
+  preferencias.putUChar("log_nivel", nivel);
+  logInfo(String("📝 Nível do log: ") + nomesNivelLog[nivel]);
+}
+
+void definirLogEmArquivo(bool habilitado) {
+  logEmArquivo = habilitado;
+  preferencias.putBool("log_arquivo", habilitado);
+  logInfo(String("📝 Cópia do log em flash ") + (habilitado ? "HABILITADA" : "DESABILITADA"));
+}
+
+// Grava no LittleFS as entradas que ainda não foram para o arquivo. Chamado pelo
+// loop(): junta as entradas por intervaloGravacaoLog ou até meio anel, para não
+// gastar a flash a cada linha.
+void gravarLogArquivo(bool forcar = false) {
+  uint32_t ultima = proximaSequenciaLog - 1;
+  if (!logEmArquivo || ultima == ultimaSequenciaGravadaLog) {
+    return;
+  }
+  if (!forcar && millis() - ultimaGravacaoLog < intervaloGravacaoLog &&
+      ultima - ultimaSequenciaGravadaLog < (uint32_t)CAPACIDADE_LOG / 2) {
+    return;
+  }
+  ultimaGravacaoLog = millis();
+
+  File arquivo = LittleFS.open(ARQUIVO_LOG, FILE_APPEND);
+  if (!arquivo) {
+    Serial.println("❌ Erro ao abrir o log em flash!");  // Só na Serial: não realimenta o anel
+    return;
+  }
+  uint32_t sequencia = ultimaSequenciaGravadaLog + 1;
+  uint32_t maisAntiga = sequenciaMaisAntigaLog();
+  if (sequencia < maisAntiga) {
+    entradasLogPerdidas += maisAntiga - sequencia;
+    sequencia = maisAntiga;
+  }
+  EntradaLog entrada;
+  for (; sequencia <= ultima; sequencia++) {
+    if (copiarEntradaLog(sequencia, entrada)) {
+      arquivo.println(formatarEntradaLog(entrada));
+    } else {
+      entradasLogPerdidas++;
+    }
+  }
+  ultimaSequenciaGravadaLog = ultima;
+  size_t tamanho = arquivo.size();
+  arquivo.close();
+
+  if (tamanho > tamanhoMaximoArquivoLog) {
+    LittleFS.remove(ARQUIVO_LOG_ANTIGO);
+    LittleFS.rename(ARQUIVO_LOG, ARQUIVO_LOG_ANTIGO);
+  }
+}
+
+// Últimas entradas do anel para o /log do Telegram
+String textoUltimasEntradasLog(int quantidade) {
+  quantidade = constrain(quantidade, 1, maxEntradasLogTelegram);
+  uint32_t ultima = proximaSequenciaLog - 1;
+  uint32_t maisAntiga = sequenciaMaisAntigaLog();
+  uint32_t sequencia = ultima >= maisAntiga + quantidade - 1 ? ultima - quantidade + 1 : maisAntiga;
+  if (sequencia > ultima) {
+    return "📝 Log vazio.";
+  }
+  String texto = String("📝 Log (nível mínimo: ") + nomesNivelLog[nivelMinimoLog] + "):\n";
+  EntradaLog entrada;
+  for (; sequencia <= ultima; sequencia++) {
+    if (copiarEntradaLog(sequencia, entrada)) {
+      texto += formatarEntradaLog(entrada) + "\n";
+    }
+  }
+  return texto;
+}
+
+// Handler para a rota "/logs" – anel de diagnóstico em texto, uma entrada por linha
+// precedida da sequência. ?nivel=aviso filtra pelo nível mínimo, ?desde=N devolve
+// só as entradas após N e ?arquivo=1 devolve a cópia em flash.
+void handleLogs(AsyncWebServerRequest* request) {
+  if (request->hasParam("arquivo")) {
+    if (!LittleFS.exists(ARQUIVO_LOG)) {
+      request->send(404, "text/plain", "Log em flash vazio (habilite com /log arquivo on)");
+      return;
+    }
+    request->send(LittleFS, ARQUIVO_LOG, "text/plain");
+    return;
+  }
+  NivelLog nivel = LOG_DEBUG;
+  if (request->hasParam("nivel")) {
+    interpretarNivelLog(request->getParam("nivel")->value(), nivel);
+  }
+  uint32_t sequencia = sequenciaMaisAntigaLog();
+  if (request->hasParam("desde")) {
+    uint32_t desde = (uint32_t)request->getParam("desde")->value().toInt() + 1;
+    if (desde > sequencia) {
+      sequencia = desde;
+    }
+  }
+  uint32_t ultima = proximaSequenciaLog - 1;
+
+  AsyncResponseStream* response = request->beginResponseStream("text/plain; charset=utf-8");
+  EntradaLog entrada;
+  for (; sequencia <= ultima; sequencia++) {
+    if (copiarEntradaLog(sequencia, entrada) && entrada.nivel >= nivel) {
+      response->print(String(entrada.sequencia) + " " + formatarEntradaLog(entrada) + "\n");
+    }
+  }
+  request->send(response);
+}
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Histórico em Flash e API de Consulta
+// ---------------------------------------------------------------
+
+// Copia os campos de uma medição para o registro binário
+void preencherRegistroHistorico(RegistroHistorico& registro, const Medicao& medicao) {
+  registro.epoch = (uint32_t)medicao.epoch;
+#define SENSOR_COPIAR(campo, ...) registro.campo = medicao.campo;
+  SENSORES(SENSOR_COPIAR)
+#undef SENSOR_COPIAR
+}
+
+// Nome do arquivo de histórico da zona: "/historico_<id>.bin" (atual) ou ".old"
+void nomeArquivoHistorico(char* destino, size_t tamanho, const Zona& zona, bool antigo) {
+  snprintf(destino, tamanho, "/historico_%s.%s", zona.id, antigo ? "old" : "bin");
+}
+
+// Descarta o histórico em flash se ele foi gravado com outro registro de sensores
+// (o tamanho do registro muda quando um sensor entra ou sai da tabela).
+// O log das versões com uma única zona passa a ser o da primeira zona.
+void verificarFormatoHistorico() {
+  char atual[40];
+  char antigo[40];
+  nomeArquivoHistorico(atual, sizeof(atual), zonas[0], false);
+  nomeArquivoHistorico(antigo, sizeof(antigo), zonas[0], true);
+  if (LittleFS.exists(ARQUIVO_HISTORICO_LEGADO) && !LittleFS.exists(atual)) {
+    LittleFS.rename(ARQUIVO_HISTORICO_LEGADO, atual);
+    if (LittleFS.exists(ARQUIVO_HISTORICO_LEGADO_ANTIGO)) {
+      LittleFS.rename(ARQUIVO_HISTORICO_LEGADO_ANTIGO, antigo);
+    }
+    logInfo("🗂️ Histórico em flash migrado para a zona " + String(zonas[0].nome));
+  }
+
+  uint32_t tamanhoGravado = preferencias.getUInt("histRegistro", 0);
+  if (tamanhoGravado == sizeof(RegistroHistorico)) {
+    return;
+  }
+  for (const Zona& zona : zonas) {
+    nomeArquivoHistorico(atual, sizeof(atual), zona, false);
+    nomeArquivoHistorico(antigo, sizeof(antigo), zona, true);
+    if (LittleFS.exists(atual) || LittleFS.exists(antigo)) {
+      LittleFS.remove(atual);
+      LittleFS.remove(antigo);
+      logInfo(prefixoZona(zona) + "🗂️ Registro de sensores alterado: histórico em flash reiniciado.");
+    }
+  }
+  preferencias.putUInt("histRegistro", sizeof(RegistroHistorico));
+}
+
+// Acrescenta a última medição da zona ao log binário, girando o arquivo quando fica grande
+void registrarHistoricoFlash(const Zona& zona) {
+  const Medicao& medicao = medicaoAtual(zona);
+  if (medicao.epoch == 0) {
+    return;  // Sem relógio sincronizado a amostra não pode ser localizada no tempo
+  }
+
+  char atual[40];
+  nomeArquivoHistorico(atual, sizeof(atual), zona, false);
+  File arquivo = LittleFS.open(atual, FILE_APPEND);
+  if (!arquivo) {
+    logErro(prefixoZona(zona) + "❌ Erro ao abrir o histórico em flash!");
+    return;
+  }
+  if (arquivo.size() >= tamanhoMaximoLogHistorico) {
+    char antigo[40];
+    nomeArquivoHistorico(antigo, sizeof(antigo), zona, true);
+    arquivo.close();
+    LittleFS.remove(antigo);
+    LittleFS.rename(atual, antigo);
+    logInfo(prefixoZona(zona) + "🗂️ Histórico em flash rotacionado.");
+    arquivo = LittleFS.open(atual, FILE_APPEND);
+    if (!arquivo) {
+      return;
+    }
+  }
+
+  RegistroHistorico registro;
+  preencherRegistroHistorico(registro, medicao);
+  arquivo.write((const uint8_t*)&registro, sizeof(registro));
+  arquivo.close();
+}
+
+// Próxima amostra do histórico em RAM com sequência maior que cursor (o histórico está em
+// ordem crescente). Copia uma amostra por vez sob o mutex, sem segurar o loop() nem copiar
+// o histórico inteiro na pilha do AsyncTCP; o anel deslocar entre chamadas não pula amostras.
+bool proximaAmostraHistorico(const Zona& zona, uint32_t& cursor, Medicao& amostra) {
+  bool encontrada = false;
+  portENTER_CRITICAL(&muxHistorico);
+  for (int i = 0; i < zona.indiceMedicao; i++) {
+    if (zona.historico[i].sequencia > cursor) {
+      amostra = zona.historico[i];
+      encontrada = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&muxHistorico);
+  if (encontrada) {
+    cursor = amostra.sequencia;
+  }
+  return encontrada;
+}
+
+// Estado de uma resposta de /api/historico; vive enquanto os chunks são enviados
+struct ConsultaHistorico {
+  const Zona* zona;
+  uint32_t de;                   // Primeiro epoch incluído
+  uint32_t ate;                  // Último epoch incluído
+  uint32_t passo;                // Intervalo mínimo entre pontos (s); 0 envia todos
+  bool binario;                  // true: registros RegistroHistorico; false: CSV
+  uint32_t proximoEpoch;         // Próximo epoch aceito pelo passo
+  int fonte;                     // 0: arquivo antigo, 1: arquivo atual, 2: memória, 3: fim
+  bool usarMemoria;              // Sem log em flash, serve o histórico em RAM
+  File arquivo;
+  size_t registrosRestantes;     // Registros completos no arquivo aberto
+  int indiceMemoria;
+  RegistroHistorico bloco[32];   // Leitura da flash em blocos
+  int tamanhoBloco;
+  int posicaoBloco;
+  char pendente[16 + 16 * NUM_SENSORES];  // Linha formatada aguardando espaço no buffer
+  size_t tamanhoPendente;
+  size_t posicaoPendente;
+  unsigned long pontos;
+  unsigned long inicioMs;
+};
+
+// Primeiro registro do arquivo com epoch >= de. Os registros têm tamanho fixo e estão em
+// ordem de tempo, então a busca binária lê só ~log2(n) epochs em vez do arquivo inteiro.
+size_t buscarInicioHistorico(File& arquivo, size_t registros, uint32_t de) {
+  size_t inicio = 0;
+  size_t fim = registros;
+  while (inicio < fim) {
+    size_t meio = inicio + (fim - inicio) / 2;
+    uint32_t epoch = 0;
+    arquivo.seek(meio * sizeof(RegistroHistorico));
+    if (arquivo.read((uint8_t*)&epoch, sizeof(epoch)) != sizeof(epoch)) {
+      return registros;
+    }
+    if (epoch < de) {
+      inicio = meio + 1;
+    } else {
+      fim = meio;
+    }
+  }
+  return inicio;
+}
+
+// Abre o próximo arquivo da consulta, já posicionado no início da janela (c.de);
+// retorna false quando não há mais arquivos
+bool abrirFonteHistorico(ConsultaHistorico& c) {
+  while (c.fonte < 2) {
+    char nome[40];
+    nomeArquivoHistorico(nome, sizeof(nome), *c.zona, c.fonte == 0);
+    c.fonte++;
+    if (LittleFS.exists(nome)) {
+      c.arquivo = LittleFS.open(nome, FILE_READ);
+      if (c.arquivo) {
+        // Só lê registros completos (o loop pode estar gravando no fim do arquivo)
+        size_t registros = c.arquivo.size() / sizeof(RegistroHistorico);
+        size_t primeiro = c.de > 0 ? buscarInicioHistorico(c.arquivo, registros, c.de) : 0;
+        c.arquivo.seek(primeiro * sizeof(RegistroHistorico));
+        c.registrosRestantes = registros - primeiro;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Prepara a consulta para ler a zona do começo: arquivo antigo, atual ou, sem log em
+// flash, o histórico em RAM. Pode ser chamada de novo para reler (ex.: uma série por vez)
+void iniciarConsultaHistorico(ConsultaHistorico& c, const Zona& zona, uint32_t de, uint32_t ate, uint32_t passo) {
+  char atual[40];
+  char antigo[40];
+  nomeArquivoHistorico(atual, sizeof(atual), zona, false);
+  nomeArquivoHistorico(antigo, sizeof(antigo), zona, true);
+
+  if (c.arquivo) c.arquivo.close();
+  c.zona = &zona;
+  c.de = de;
+  c.ate = ate;
+  c.passo = passo;
+  c.proximoEpoch = 0;
+  c.fonte = 0;
+  c.usarMemoria = !LittleFS.exists(atual) && !LittleFS.exists(antigo);
+  c.registrosRestantes = 0;
+  c.indiceMemoria = 0;
+  c.tamanhoBloco = 0;
+  c.posicaoBloco = 0;
+}
+
+// Próximo registro da fonte atual (flash ou memória), sem filtro
+bool lerRegistroHistorico(ConsultaHistorico& c, RegistroHistorico& registro) {
+  if (c.usarMemoria) {
+    while (true) {
+      bool valido = false;
+      portENTER_CRITICAL(&muxHistorico);
+      if (c.indiceMemoria < c.zona->indiceMedicao) {
+        preencherRegistroHistorico(registro, c.zona->historico[c.indiceMemoria]);
+        valido = true;
+      }
+      portEXIT_CRITICAL(&muxHistorico);
+      c.indiceMemoria++;
+      if (!valido) return false;
+      if (registro.epoch != 0) return true;
+    }
+  }
+
+  while (c.posicaoBloco >= c.tamanhoBloco) {
+    if (c.arquivo && c.registrosRestantes > 0) {
+      size_t quantidade = min(c.registrosRestantes, sizeof(c.bloco) / sizeof(c.bloco[0]));
+      size_t lidos = c.arquivo.read((uint8_t*)c.bloco, quantidade * sizeof(RegistroHistorico)) / sizeof(RegistroHistorico);
+      c.registrosRestantes = (lidos == quantidade) ? c.registrosRestantes - lidos : 0;
+      c.tamanhoBloco = lidos;
+      c.posicaoBloco = 0;
+      if (lidos == 0) c.registrosRestantes = 0;
+    } else {
+      if (c.arquivo) c.arquivo.close();
+      if (!abrirFonteHistorico(c)) return false;
+    }
+  }
+  registro = c.bloco[c.posicaoBloco++];
+  return true;
+}
+
+// Próximo registro dentro do intervalo pedido, respeitando o passo
+bool proximoRegistroHistorico(ConsultaHistorico& c, RegistroHistorico& registro) {
+  while (lerRegistroHistorico(c, registro)) {
+    if (registro.epoch < c.de || registro.epoch > c.ate || registro.epoch < c.proximoEpoch) {
+      continue;
+    }
+    c.proximoEpoch = registro.epoch + c.passo;
+    return true;
+  }
+  return false;
+}
+
+// Preenche um chunk da resposta; retorna 0 quando a consulta termina
+size_t preencherHistorico(ConsultaHistorico& c, uint8_t* buffer, size_t tamanhoMaximo) {
+  size_t escrito = 0;
+  while (escrito < tamanhoMaximo) {
+    if (c.posicaoPendente < c.tamanhoPendente) {
+      size_t n = min(c.tamanhoPendente - c.posicaoPendente, tamanhoMaximo - escrito);
+      memcpy(buffer + escrito, c.pendente + c.posicaoPendente, n);
+      c.posicaoPendente += n;
+      escrito += n;
+      continue;
+    }
+
+    RegistroHistorico r;
+    if (!proximoRegistroHistorico(c, r)) {
+      if (escrito == 0 && c.fonte != 3) {
+        c.fonte = 3;
+        historicoUltimaConsultaPontos = c.pontos;
+        historicoUltimaConsultaMs = millis() - c.inicioMs;
+      }
+      break;
+    }
+    c.pontos++;
+    c.posicaoPendente = 0;
+    if (c.binario) {
+      memcpy(c.pendente, &r, sizeof(r));
+      c.tamanhoPendente = sizeof(r);
+    } else {
+      size_t n = snprintf(c.pendente, sizeof(c.pendente), "%lu", (unsigned long)r.epoch);
+#define SENSOR_CSV(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+      n += isnan(r.campo) ? snprintf(c.pendente + n, sizeof(c.pendente) - n, ",") \
+                          : snprintf(c.pendente + n, sizeof(c.pendente) - n, ",%.*f", casas, (double)r.campo);
+      SENSORES(SENSOR_CSV)
+#undef SENSOR_CSV
+      n += snprintf(c.pendente + n, sizeof(c.pendente) - n, "\n");
+      c.tamanhoPendente = min(n, sizeof(c.pendente) - 1);
+    }
+  }
+  return escrito;
+}
+
+// Zona pedida em "?zona=N" (1 a NUM_ZONAS); sem o parâmetro vale a primeira zona
+Zona* zonaDaRequisicao(AsyncWebServerRequest* request) {
+  if (!request->hasArg("zona") || request->arg("zona").length() == 0) {
+    return &zonas[0];
+  }
+  return buscarZona(request->arg("zona").toInt());
+}
+
+// Handler para "/api/historico?zona=&from=&to=&step=&formato=csv|bin" – envia o histórico em chunks
+void handleHistorico(AsyncWebServerRequest* request) {
+  Zona* zona = zonaDaRequisicao(request);
+  if (zona == nullptr) {
+    request->send(404, "text/plain", "Zona inexistente");
+    return;
+  }
+
+  std::shared_ptr<ConsultaHistorico> consulta(new ConsultaHistorico());
+  iniciarConsultaHistorico(*consulta, *zona,
+                           request->hasArg("from") ? strtoul(request->arg("from").c_str(), nullptr, 10) : 0,
+                           request->hasArg("to") ? strtoul(request->arg("to").c_str(), nullptr, 10) : UINT32_MAX,
+                           request->hasArg("step") ? strtoul(request->arg("step").c_str(), nullptr, 10) : 0);
+  consulta->binario = request->hasArg("formato") && request->arg("formato") == "bin";
+  consulta->inicioMs = millis();
+
+  if (!consulta->binario) {
+#define SENSOR_CSV_CABECALHO(campo, chave, ...) "," chave
+    consulta->tamanhoPendente = strlen(strcpy(consulta->pendente, "epoch" SENSORES(SENSOR_CSV_CABECALHO) "\n"));
+  }
+
+  AsyncWebServerResponse* response = request->beginChunkedResponse(
+    consulta->binario ? "application/octet-stream" : "text/csv",
+    [consulta](uint8_t* buffer, size_t tamanhoMaximo, size_t indice) -> size_t {
+      return preencherHistorico(*consulta, buffer, tamanhoMaximo);
+    });
+  response->addHeader("Cache-Control", "no-store");
+  // No formato binário cada registro é um uint32 (epoch) seguido de um float32 por campo
+  response->addHeader("X-Campos", "epoch" SENSORES(SENSOR_CSV_CABECALHO));
+#undef SENSOR_CSV_CABECALHO
+  request->send(response);
+}
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Gráfico SVG (/grafico.svg)
+// ---------------------------------------------------------------
+// Gráfico do histórico para navegadores sem JavaScript (celulares antigos, tablets e-ink):
+// um painel por unidade (°C, %) e uma polyline por sensor. Lê a mesma fonte de
+// /api/historico (log em flash, ou o histórico em RAM quando não há log) uma única vez,
+// a partir do início da janela, guardando o mínimo e o máximo de cada sensor em cada uma
+// das colunasGraficoSvg colunas de tempo; as escalas dos painéis saem dessas colunas.
+// A leitura é feita em lotes de registrosPorLoteSvg, um por chamada do callback da
+// resposta chunked (RESPONSE_TRY_AGAIN entre os lotes), para não prender a task do
+// AsyncTCP. Depois o documento é gerado em pedaços, sem ser montado na memória, e o
+// tamanho da resposta não cresce com o número de amostras.
+const int larguraGraficoSvg = 600;
+const int alturaPainelSvg = 150;
+const int espacoPainelSvg = 26;       // Rótulos de tempo abaixo de cada painel
+const int margemSuperiorSvg = 28;     // Título
+const int margemEsquerdaSvg = 44;     // Escala
+const int margemDireitaSvg = 10;
+const int colunasGraficoSvg = 150;
+const int registrosPorLoteSvg = 1024; // Registros por chamada do callback (24 KB de flash, dezenas de ms)
+const uint16_t colunaVaziaSvg = 0xFFFF;
+
+#define SENSOR_UNIDADE_SVG(campo, chave, rotulo, rotuloLcd, icone, unidade, ...) unidade,
+#define SENSOR_ROTULO_SVG(campo, chave, rotulo, ...) rotulo,
+#define SENSOR_COR_SVG(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                       pinoBlynk, chaveSheets, chaveDados, classeHa, cor, ...) cor,
+const char* const unidadesSensoresSvg[NUM_SENSORES] = { SENSORES(SENSOR_UNIDADE_SVG) };
+const char* const rotulosSensoresSvg[NUM_SENSORES] = { SENSORES(SENSOR_ROTULO_SVG) };
+const char* const coresSensoresSvg[NUM_SENSORES] = { SENSORES(SENSOR_COR_SVG) };
+#undef SENSOR_UNIDADE_SVG
+#undef SENSOR_ROTULO_SVG
+#undef SENSOR_COR_SVG
+
+// Valor do sensor de índice "sensor" (ordem do registro) em um registro do histórico
+float valorSensorSvg(const RegistroHistorico& registro, int sensor) {
+#define SENSOR_VALOR_SVG(campo, ...) registro.campo,
+  const float valores[NUM_SENSORES] = { SENSORES(SENSOR_VALOR_SVG) };
+#undef SENSOR_VALOR_SVG
+  return valores[sensor];
+}
+
+enum EtapaSvg { SVG_LEITURA, SVG_CABECALHO, SVG_PAINEL, SVG_SERIE_INICIO, SVG_SERIE_PONTOS, SVG_SERIE_FIM,
+                SVG_PAINEL_FIM, SVG_RODAPE, SVG_FIM };
+
+// Mínimo e máximo de um sensor em uma coluna de tempo, com a posição x (em décimos de
+// pixel) de cada um para desenhá-los na ordem em que ocorreram
+struct ColunaSvg {
+  float minimo;
+  float maximo;
+  uint16_t xMinimo;                  // colunaVaziaSvg = coluna sem amostras
+  uint16_t xMaximo;
+};
+
+// Estado de uma resposta de /grafico.svg; vive enquanto os chunks são enviados (~10 KB)
+struct GraficoSvg {
+  const Zona* zona;
+  uint32_t inicio;                   // Janela de tempo (epoch)
+  uint32_t fim;
+  int numPaineis;                    // 0 = sem amostras no período
+  int painelSensor[NUM_SENSORES];
+  const char* unidadePainel[NUM_SENSORES];
+  float minimo[NUM_SENSORES];        // Escala de cada painel
+  float maximo[NUM_SENSORES];
+  ConsultaHistorico consulta;        // Leitura única da janela (etapa SVG_LEITURA)
+  unsigned long amostras;            // Registros lidos dentro da janela
+  ColunaSvg colunas[NUM_SENSORES][colunasGraficoSvg];
+  EtapaSvg etapa;
+  int painel;
+  int sensor;                        // Série sendo gerada
+  int legendas;                      // Séries já desenhadas no painel
+  int coluna;                        // Próxima coluna da série a escrever
+  char pendente[320];                // Trecho do documento aguardando espaço no buffer
+  size_t tamanhoPendente;
+  size_t posicaoPendente;
+  unsigned long pontos;
+  unsigned long inicioMs;
+};
+
+int topoPainelSvg(int painel) {
+  return margemSuperiorSvg + painel * (alturaPainelSvg + espacoPainelSvg);
+}
+
+float xSvg(const GraficoSvg& g, uint32_t epoch) {
+  uint32_t janela = g.fim > g.inicio ? g.fim - g.inicio : 1;
+  return margemEsquerdaSvg + (float)(epoch - g.inicio) * (larguraGraficoSvg - margemEsquerdaSvg - margemDireitaSvg) / janela;
+}
+
+float ySvg(const GraficoSvg& g, float valor) {
+  return topoPainelSvg(g.painel) + alturaPainelSvg * (g.maximo[g.painel] - valor) / (g.maximo[g.painel] - g.minimo[g.painel]);
+}
+
+int colunaSvg(const GraficoSvg& g, uint32_t epoch) {
+  uint32_t janela = g.fim > g.inicio ? g.fim - g.inicio : 1;
+  return min((int)((uint64_t)(epoch - g.inicio) * colunasGraficoSvg / janela), colunasGraficoSvg - 1);
+}
+
+// Hora local de um epoch ("dd/mm HH:MM")
+void horaSvg(uint32_t epoch, char* texto, size_t tamanho) {
+  time_t t = epoch;
+  struct tm local;
+  localtime_r(&t, &local);
+  strftime(texto, tamanho, "%d/%m %H:%M", &local);
+}
+
+// Lê um lote de registros e acumula os da janela nas colunas; true quando a leitura termina
+bool lerLoteSvg(GraficoSvg& g) {
+  RegistroHistorico registro;
+  for (int i = 0; i < registrosPorLoteSvg; i++) {
+    if (!lerRegistroHistorico(g.consulta, registro)) {
+      g.consulta.arquivo.close();
+      return true;
+    }
+    if (registro.epoch == 0 || registro.epoch < g.inicio || registro.epoch > g.fim) {
+      continue;
+    }
+    g.amostras++;
+    int coluna = colunaSvg(g, registro.epoch);
+    uint16_t x = (uint16_t)(xSvg(g, registro.epoch) * 10);
+    for (int sensor = 0; sensor < NUM_SENSORES; sensor++) {
+      float valor = valorSensorSvg(registro, sensor);
+      if (isnan(valor)) {
+        continue;
+      }
+      ColunaSvg& c = g.colunas[sensor][coluna];
+      if (c.xMinimo == colunaVaziaSvg) {
+        c.minimo = c.maximo = valor;
+        c.xMinimo = c.xMaximo = x;
+      } else if (valor < c.minimo) {
+        c.minimo = valor;
+        c.xMinimo = x;
+      } else if (valor > c.maximo) {
+        c.maximo = valor;
+        c.xMaximo = x;
+      }
+    }
+  }
+  return false;
+}
+
+// Escala de cada painel a partir das colunas lidas
+void calcularEscalasSvg(GraficoSvg& g) {
+  if (g.amostras == 0) {
+    g.numPaineis = 0;  // Nada no período (ou relógio nunca sincronizado)
+    return;
+  }
+  for (int painel = 0; painel < g.numPaineis; painel++) {
+    g.minimo[painel] = INFINITY;
+    g.maximo[painel] = -INFINITY;
+  }
+  for (int sensor = 0; sensor < NUM_SENSORES; sensor++) {
+    int painel = g.painelSensor[sensor];
+    for (const ColunaSvg& c : g.colunas[sensor]) {
+      if (c.xMinimo != colunaVaziaSvg) {
+        g.minimo[painel] = min(g.minimo[painel], c.minimo);
+        g.maximo[painel] = max(g.maximo[painel], c.maximo);
+      }
+    }
+  }
+  for (int painel = 0; painel < g.numPaineis; painel++) {
+    if (isinf(g.minimo[painel])) {
+      g.minimo[painel] = 0;
+      g.maximo[painel] = 1;
+    } else if (g.maximo[painel] - g.minimo[painel] < 1) {
+      // Série quase constante: abre a escala para a linha não colar na borda
+      g.minimo[painel] -= 0.5;
+      g.maximo[painel] += 0.5;
+    }
+  }
+}
+
+// Pontos de uma coluna (mínimo e máximo, na ordem em que ocorreram)
+int escreverColunaSvg(GraficoSvg& g, const ColunaSvg& c, char* destino, size_t tamanho) {
+  if (c.minimo == c.maximo) {
+    g.pontos++;
+    return snprintf(destino, tamanho, "%.1f,%.1f ", c.xMinimo / 10.0, ySvg(g, c.minimo));
+  }
+  bool minimoPrimeiro = c.xMinimo <= c.xMaximo;
+  uint16_t x1 = minimoPrimeiro ? c.xMinimo : c.xMaximo, x2 = minimoPrimeiro ? c.xMaximo : c.xMinimo;
+  float v1 = minimoPrimeiro ? c.minimo : c.maximo, v2 = minimoPrimeiro ? c.maximo : c.minimo;
+  g.pontos += 2;
+  return snprintf(destino, tamanho, "%.1f,%.1f %.1f,%.1f ", x1 / 10.0, ySvg(g, v1), x2 / 10.0, ySvg(g, v2));
+}
+
+// Próximo sensor do painel atual a partir de "inicio" (-1 se não houver)
+int proximoSensorPainelSvg(const GraficoSvg& g, int inicio) {
+  for (int i = inicio; i < NUM_SENSORES; i++) {
+    if (g.painelSensor[i] == g.painel) return i;
+  }
+  return -1;
+}
+
+// Gera o próximo trecho do documento em g.pendente (vazio quando a etapa não produz texto)
+void proximoTrechoSvg(GraficoSvg& g) {
+  char* p = g.pendente;
+  const size_t cap = sizeof(g.pendente);
+  int n = 0;
+  char de[16], ate[16];
+  switch (g.etapa) {
+    case SVG_CABECALHO: {
+      int altura = topoPainelSvg(max(g.numPaineis, 1));
+      horaSvg(g.inicio, de, sizeof(de));
+      horaSvg(g.fim, ate, sizeof(ate));
+      n = snprintf(p, cap, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\" "
+                   "font-family=\"sans-serif\" font-size=\"11\"><rect width=\"100%%\" height=\"100%%\" fill=\"#fff\"/>"
+                   "<text x=\"%d\" y=\"16\" font-size=\"13\">%s: %s</text>",
+                   larguraGraficoSvg, altura, larguraGraficoSvg, altura, margemEsquerdaSvg, g.zona->nome,
+                   g.numPaineis > 0 ? (String(de) + " a " + ate).c_str() : "sem medições no período");
+      g.etapa = g.numPaineis > 0 ? SVG_PAINEL : SVG_RODAPE;
+      break;
+    }
+    case SVG_PAINEL: {
+      int topo = topoPainelSvg(g.painel);
+      n = snprintf(p, cap, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"none\" stroke=\"#ccc\"/>"
+                   "<text x=\"%d\" y=\"%d\" text-anchor=\"end\">%.1f</text><text x=\"%d\" y=\"%d\" text-anchor=\"end\">%.1f</text>"
+                   "<text x=\"%d\" y=\"%d\" text-anchor=\"end\">%s</text>",
+                   margemEsquerdaSvg, topo, larguraGraficoSvg - margemEsquerdaSvg - margemDireitaSvg, alturaPainelSvg,
+                   margemEsquerdaSvg - 4, topo + 10, g.maximo[g.painel],
+                   margemEsquerdaSvg - 4, topo + alturaPainelSvg, g.minimo[g.painel],
+                   margemEsquerdaSvg - 4, topo + alturaPainelSvg / 2 + 4, g.unidadePainel[g.painel]);
+      g.legendas = 0;
+      g.sensor = proximoSensorPainelSvg(g, 0);
+      g.etapa = g.sensor >= 0 ? SVG_SERIE_INICIO : SVG_PAINEL_FIM;
+      break;
+    }
+    case SVG_SERIE_INICIO:
+      n = snprintf(p, cap, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"1.5\" points=\"", coresSensoresSvg[g.sensor]);
+      g.coluna = 0;
+      g.etapa = SVG_SERIE_PONTOS;
+      break;
+
+    case SVG_SERIE_PONTOS:
+      // Uma coluna preenchida por trecho; as vazias (sem amostras) são puladas
+      while (n == 0 && g.coluna < colunasGraficoSvg) {
+        const ColunaSvg& c = g.colunas[g.sensor][g.coluna++];
+        if (c.xMinimo != colunaVaziaSvg) {
+          n = escreverColunaSvg(g, c, p, cap);
+        }
+      }
+      if (n == 0) {
+        g.etapa = SVG_SERIE_FIM;
+      }
+      break;
+
+    case SVG_SERIE_FIM:
+      n = snprintf(p, cap, "\"/><text x=\"%d\" y=\"%d\" text-anchor=\"end\" fill=\"%s\">%s</text>",
+                   larguraGraficoSvg - margemDireitaSvg - 4, topoPainelSvg(g.painel) + 13 + 13 * g.legendas,
+                   coresSensoresSvg[g.sensor], rotulosSensoresSvg[g.sensor]);
+      g.legendas++;
+      g.sensor = proximoSensorPainelSvg(g, g.sensor + 1);
+      g.etapa = g.sensor >= 0 ? SVG_SERIE_INICIO : SVG_PAINEL_FIM;
+      break;
+
+    case SVG_PAINEL_FIM: {
+      int base = topoPainelSvg(g.painel) + alturaPainelSvg + 13;
+      horaSvg(g.inicio, de, sizeof(de));
+      horaSvg(g.fim, ate, sizeof(ate));
+      n = snprintf(p, cap, "<text x=\"%d\" y=\"%d\">%s</text><text x=\"%d\" y=\"%d\" text-anchor=\"end\">%s</text>",
+                   margemEsquerdaSvg, base, de, larguraGraficoSvg - margemDireitaSvg, base, ate);
+      g.painel++;
+      g.etapa = g.painel < g.numPaineis ? SVG_PAINEL : SVG_RODAPE;
+      break;
+    }
+    case SVG_RODAPE:
+      n = snprintf(p, cap, "</svg>\n");
+      g.etapa = SVG_FIM;
+      break;
+
+    case SVG_LEITURA:
+    case SVG_FIM:
+      break;
+  }
+  g.tamanhoPendente = n > 0 ? min((size_t)n, cap - 1) : 0;
+  g.posicaoPendente = 0;
+}
+
+// Preenche um chunk da resposta; retorna 0 quando o documento termina
+size_t preencherGraficoSvg(GraficoSvg& g, uint8_t* buffer, size_t tamanhoMaximo) {
+  // Enquanto lê o histórico, um lote por chamada; o AsyncTCP chama de novo depois
+  if (g.etapa == SVG_LEITURA) {
+    if (!lerLoteSvg(g)) {
+      return RESPONSE_TRY_AGAIN;
+    }
+    calcularEscalasSvg(g);
+    g.etapa = SVG_CABECALHO;
+  }
+
+  size_t escrito = 0;
+  while (escrito < tamanhoMaximo) {
+    if (g.posicaoPendente < g.tamanhoPendente) {
+      size_t n = min(g.tamanhoPendente - g.posicaoPendente, tamanhoMaximo - escrito);
+      memcpy(buffer + escrito, g.pendente + g.posicaoPendente, n);
+      g.posicaoPendente += n;
+      escrito += n;
+      continue;
+    }
+    if (g.etapa == SVG_FIM) {
+      if (escrito == 0 && g.inicioMs != 0) {
+        graficoSvgUltimosPontos = g.pontos;
+        graficoSvgUltimoMs = millis() - g.inicioMs;
+        g.inicioMs = 0;
+      }
+      break;
+    }
+    proximoTrechoSvg(g);
+  }
+  return escrito;
+}
+
+// Duração em "range": segundos ou número com sufixo s, m, h ou d (ex.: 30m, 6h, 1d)
+uint32_t interpretarDuracao(const String& texto) {
+  uint32_t valor = strtoul(texto.c_str(), nullptr, 10);
+  switch (texto.length() > 0 ? texto[texto.length() - 1] : 's') {
+    case 'm': return valor * 60;
+    case 'h': return valor * 3600;
+    case 'd': return valor * 86400;
+    default:  return valor;
+  }
+}
+
+// Handler para "/grafico.svg?zona=N&range=6h" – sem range, todo o histórico
+void handleGraficoSvg(AsyncWebServerRequest* request) {
+  Zona* zona = zonaDaRequisicao(request);
+  if (zona == nullptr) {
+    request->send(404, "text/plain", "Zona inexistente");
+    return;
+  }
+
+  std::shared_ptr<GraficoSvg> grafico(new GraficoSvg());
+  GraficoSvg& g = *grafico;
+  g.zona = zona;
+  g.inicioMs = millis();
+  uint32_t duracao = request->hasArg("range") ? interpretarDuracao(request->arg("range")) : 0;
+
+  // Janela: termina na medição mais recente (ou agora, se nenhuma desde o boot) e volta
+  // "range" (ou até a mais antiga)
+  Medicao ultima;
+  copiarMedicao(*zona, ultima);
+  g.fim = ultima.epoch != 0 ? ultima.epoch : (uint32_t)time(nullptr);
+  g.inicio = duracao > 0 && g.fim > duracao ? g.fim - duracao : 0;
+
+  // Um painel por unidade, na ordem do registro
+  for (int i = 0; i < NUM_SENSORES; i++) {
+    int painel = 0;
+    while (painel < g.numPaineis && strcmp(g.unidadePainel[painel], unidadesSensoresSvg[i]) != 0) {
+      painel++;
+    }
+    if (painel == g.numPaineis) {
+      g.unidadePainel[g.numPaineis++] = unidadesSensoresSvg[i];
+    }
+    g.painelSensor[i] = painel;
+    for (ColunaSvg& c : g.colunas[i]) {
+      c.xMinimo = c.xMaximo = colunaVaziaSvg;
+    }
+  }
+
+  // Sem range, a janela começa no registro mais antigo: só ele é lido aqui
+  iniciarConsultaHistorico(g.consulta, *zona, g.inicio, g.fim, 0);
+  RegistroHistorico primeiro;
+  if (duracao == 0 && lerRegistroHistorico(g.consulta, primeiro) && primeiro.epoch != 0 && primeiro.epoch <= g.fim) {
+    g.inicio = primeiro.epoch;
+    iniciarConsultaHistorico(g.consulta, *zona, g.inicio, g.fim, 0);
+  }
+  // A leitura da janela (a partir do início, por busca binária) fica para o callback
+  g.etapa = g.fim != 0 ? SVG_LEITURA : SVG_CABECALHO;
+  if (g.fim == 0) {
+    g.numPaineis = 0;
+  }
+
+  AsyncWebServerResponse* response = request->beginChunkedResponse("image/svg+xml; charset=utf-8",
+    [grafico](uint8_t* buffer, size_t tamanhoMaximo, size_t indice) -> size_t {
+      return preencherGraficoSvg(*grafico, buffer, tamanhoMaximo);
+    });
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+// ---------------------------------------------------------------
+// FUNÇÕES: Handlers do Servidor Web
+// ---------------------------------------------------------------
+
+// Enfileira uma ação para o loop(); chamada a partir dos handlers assíncronos
+bool enfileirarComandoWeb(TipoComandoWeb tipo, int zona = 0, float valor1 = 0, float valor2 = 0) {
+  ComandoWeb comando = { tipo, zona, valor1, valor2, false };
+  if (filaComandosWeb == nullptr || xQueueSend(filaComandosWeb, &comando, 0) != pdTRUE) {
+    logAviso("⚠️ Fila de comandos web cheia, comando descartado.");
+    return false;
+  }
+  return true;
+}
+
+// Enfileira um comando recebido por MQTT; o estado da zona é publicado depois dele
+bool enfileirarComandoMqtt(TipoComandoWeb tipo, int zona, float valor) {
+  ComandoWeb comando = { tipo, zona, valor, 0, true };
+  if (filaComandosWeb == nullptr || xQueueSend(filaComandosWeb, &comando, 0) != pdTRUE) {
+    logAviso("⚠️ Fila de comandos cheia, comando MQTT descartado.");
+    return false;
+  }
+  return true;
+}
+
+// Executa no loop() os comandos recebidos pelo servidor web
+void processarComandosWeb() {
+  ComandoWeb comando;
+  while (filaComandosWeb != nullptr && xQueueReceive(filaComandosWeb, &comando, 0) == pdTRUE) {
+    Zona& zona = zonas[comando.zona];
+    switch (comando.tipo) {
+      case CMD_ALTERNAR_BOMBA:
+        // Inverte o estado atual da bomba passando pela máquina de estados
+        if (bombaEstaLigada(zona)) {
+          desligarBomba(zona, "🌐 Desligada pela interface web.");
+        } else {
+          ligarBomba(zona, ORIGEM_MANUAL);
+        }
+        break;
+
+      case CMD_BOMBA_MQTT:
+        if (comando.valor1 != 0) {
+          ligarBomba(zona, ORIGEM_MANUAL);
+        } else {
+          desligarBomba(zona, "📡 Desligada via MQTT.");
+        }
+        break;
+
+      case CMD_LIMITE_TEMPERATURA:
+        definirLimiteTemperatura(zona, comando.valor1);
+        break;
+
+      case CMD_LIMITE_UMIDADE:
+        definirLimiteUmidadeSolo(zona, comando.valor1);
+        break;
+
+      case CMD_LIMITES_IRRIGACAO:
+        definirLimitesIrrigacao(zona, comando.valor1, comando.valor2);
+        break;
+
+      case CMD_MODO_IRRIGACAO:
+        definirModoIrrigacao(zona, comando.valor1 != 0);
+        break;
+
+      case CMD_BLYNK:
+        definirBlynkHabilitado(comando.valor1 != 0);
+        break;
+
+      case CMD_PAINEL_TELEGRAM:
+        definirPainelTelegram(comando.valor1 != 0);
+        break;
+    }
+    if (comando.respostaMqtt) {
+      publicarEstadoMqtt(zona);
+    }
+  }
 }
 
-void desligarBomba() {
-  Serial.println("🔌 Tentando desligar a bomba...");
-  digitalWrite(RELE_BOMBA, LOW);  // Desliga o relé (desativa a bomba)
-  Serial.println("💧 Bomba DESLIGADA! (GPIO26: " + String(digitalRead(RELE_BOMBA)) + ")");
-  enviarMensagemTelegram("💧 A bomba foi DESLIGADA!", false, "MarkdownV2");
+// Handler para a rota "/bomba?zona=N" – alterna o estado da bomba da zona
+void handleBomba(AsyncWebServerRequest* request) {
+  Zona* zona = zonaDaRequisicao(request);
+  if (zona == nullptr) {
+    request->send(404, "text/plain", "Zona inexistente");
+    return;
+  }
+  bool aceito = enfileirarComandoWeb(CMD_ALTERNAR_BOMBA, zona - zonas);
+  // Envia resposta HTML com redirecionamento
+  request->send(aceito ? 200 : 503, "text/html",
+                String("<meta http-equiv='refresh' content='1;url=/' />"
+                       "<h2>") + (aceito ? "Comando da bomba enviado!" : "Servidor ocupado, tente novamente.") + "</h2>"
+                "<p>Redirecionando...</p>");
 }
 
 
 // ---------------------------------------------------------------
-// FUNÇÃO: Configurar Comandos do Telegram via API
+// FUNÇÕES: Arquivos Estáticos
 // ---------------------------------------------------------------
-void configurarComandosTelegram() {
-  // Reinicia o cliente seguro e ignora a verificação de certificado
-  telegramClient.reset(new WiFiClientSecure);
-  telegramClient->setInsecure();
 
-  Serial.println("🔧 Configurando comandos do Telegram via setMyCommands (POST)...");
+// FNV-1a de 32 bits, incremental (comece com hash = 2166136261)
+uint32_t fnv1a(uint32_t hash, const uint8_t* dados, size_t tamanho) {
+  for (size_t i = 0; i < tamanho; i++) {
+    hash = (hash ^ dados[i]) * 16777619u;
+  }
+  return hash;
+}
 
-  // JSON atualizado com os comandos disponíveis
-  String jsonBody = F("{\"commands\":[" 
-    "{\"command\":\"start\",\"description\":\"Inicia o bot e exibe informações\"},"
-    "{\"command\":\"medir\",\"description\":\"Realiza uma medição agora\"},"
-    "{\"command\":\"alertatemperatura\",\"description\":\"Define alerta de temperatura\"},"
-    "{\"command\":\"alertaumidade\",\"description\":\"Define alerta de umidade do solo\"},"
-    "{\"command\":\"bombaligar\",\"description\":\"Liga a bomba d'água\"},"
-    "{\"command\":\"bombadesligar\",\"description\":\"Desliga a bomba d'água\"},"
-    "{\"command\":\"grafico\",\"description\":\"Exibe gráfico das últimas medições\"},"
-    "{\"command\":\"help\",\"description\":\"Exibe a lista de comandos disponíveis\"}"
-  "]}");
+// Chamada no setup(), com o LittleFS montado e antes de o servidor começar a atender
+void carregarArquivosEstaticos() {
+  for (ArquivoEstatico& arquivo : arquivosEstaticos) {
+    String caminho = String(arquivo.caminho) + ".gz";
+    arquivo.gzip = LittleFS.exists(caminho);
+    if (!arquivo.gzip) {
+      caminho = arquivo.caminho;
+    }
+    arquivo.existe = LittleFS.exists(caminho);
+    if (!arquivo.existe) {
+      logAviso(String("⚠️ ") + arquivo.caminho + " não está no LittleFS (envie a pasta data/ com uploadfs).");
+      continue;
+    }
 
-  // Tenta conectar ao servidor da API do Telegram
-  if (telegramClient->connect("api.telegram.org", 443)) {
-    // Monta a requisição HTTP POST para configurar os comandos
-    String request = String("POST /bot") + botToken + "/setMyCommands HTTP/1.1\r\n" +
-                     "Host: api.telegram.org\r\n" +
-                     "Content-Type: application/json\r\n" +
-                     "Connection: close\r\n" +
-                     "Content-Length: " + jsonBody.length() + "\r\n\r\n" +
-                     jsonBody;
-    telegramClient->print(request);
-    // (Opcional) Lê a resposta para debug
-    while (telegramClient->connected() || telegramClient->available()) {
-      if (telegramClient->available()) {
-        String line = telegramClient->readStringUntil('\n');
-        //Serial.println(line);
+    File entrada = LittleFS.open(caminho, "r");
+    arquivo.tamanho = entrada.size();
+    arquivo.cache = arquivo.tamanho <= limiteCacheEstatico ? (uint8_t*)malloc(arquivo.tamanho) : nullptr;
+    uint32_t hash = 2166136261u;
+    uint8_t bloco[256];
+    size_t lidos = 0;
+    int n;
+    while ((n = entrada.read(bloco, sizeof(bloco))) > 0) {
+      hash = fnv1a(hash, bloco, n);
+      if (arquivo.cache != nullptr && lidos + n <= arquivo.tamanho) {
+        memcpy(arquivo.cache + lidos, bloco, n);
       }
+      lidos += n;
     }
-    telegramClient->stop();
-    Serial.println("✅ Comandos configurados via API do Telegram (POST).");
-  } else {
-    Serial.println("❌ Erro ao conectar ao Telegram para configurar comandos.");
+    entrada.close();
+    snprintf(arquivo.etag, sizeof(arquivo.etag), "\"%08x\"", hash);
+    logInfo(String("📄 ") + arquivo.url + ": " + String(arquivo.tamanho) + " bytes" +
+            (arquivo.gzip ? " (gzip)" : "") + (arquivo.cache != nullptr ? ", em RAM" : ""));
   }
 }
 
-// ---------------------------------------------------------------
-// FUNÇÕES: Handlers do Servidor Web
-// ---------------------------------------------------------------
+// O cliente já tem esta versão (If-None-Match igual ao ETag)
+bool naoModificado(AsyncWebServerRequest* request, const char* etag) {
+  return request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag;
+}
+
+// ETag e Cache-Control, também nas respostas 304
+void cabecalhosCache(AsyncWebServerResponse* response, const char* etag, bool imutavel) {
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", imutavel ? "public, max-age=31536000, immutable" : "no-cache");
+}
+
+void handleArquivoEstatico(AsyncWebServerRequest* request) {
+  const ArquivoEstatico* arquivo = nullptr;
+  for (const ArquivoEstatico& candidato : arquivosEstaticos) {
+    if (request->url() == candidato.url) {
+      arquivo = &candidato;
+    }
+  }
+  if (arquivo == nullptr || !arquivo->existe) {
+    request->send(404, "text/plain", "Arquivo não encontrado");
+    return;
+  }
 
-// Handler para a rota "/bomba" – alterna o estado da bomba
-void handleBomba() {
-  bombaLigada = !bombaLigada;  // Inverte o estado atual da bomba
-  if (bombaLigada) {
-    ligarBomba();
+  AsyncWebServerResponse* response;
+  if (naoModificado(request, arquivo->etag)) {
+    response = request->beginResponse(304);
+    estaticosNaoModificados++;
+  } else if (arquivo->cache != nullptr) {
+    response = request->beginResponse(200, arquivo->tipo, arquivo->cache, arquivo->tamanho);
+    if (arquivo->gzip) {
+      response->addHeader("Content-Encoding", "gzip");
+    }
+    estaticosRam++;
   } else {
-    desligarBomba();
+    // AsyncFileResponse abre "<caminho>.gz" sozinho e marca o Content-Encoding
+    response = request->beginResponse(LittleFS, arquivo->caminho, arquivo->tipo);
+    estaticosFlash++;
   }
-  // Envia resposta HTML com redirecionamento
-  server.send(200, "text/html", "<meta http-equiv='refresh' content='1;url=/' />"
-                                "<h2>Bomba " + String(bombaLigada ? "LIGADA" : "DESLIGADA") + "</h2>"
-                                "<p>Redirecionando...</p>");
+  cabecalhosCache(response, arquivo->etag, arquivo->imutavel);
+  request->send(response);
 }
 
 
-void handleFavicon() {
-  File file = LittleFS.open("/favicon.png", "r");
-  if (!file) {
-      server.send(404, "text/plain", "Favicon não encontrado");
-      return;
+// Handler para a rota "/salvar" – atualiza os limites de alerta e da irrigação
+void handleSave(AsyncWebServerRequest* request) {
+  Zona* zona = zonaDaRequisicao(request);
+  if (zona == nullptr) {
+    request->send(404, "text/plain", "Zona inexistente");
+    return;
   }
+  int indiceZona = zona - zonas;
 
-  server.streamFile(file, "image/png");
-  file.close();
-}
+  String page = "<!DOCTYPE html><html><head><meta charset='UTF-8'><title>Limite Salvo</title></head><body>";
+  page += "<h1>Configuração Enviada!</h1>";
+  if (NUM_ZONAS > 1) {
+    page += "<p>Zona: " + String(zona->nome) + "</p>";
+  }
+
+  if (request->hasArg("temp")) {
+    float novoLimite = request->arg("temp").toFloat();
+    if (novoLimite > 0 && enfileirarComandoWeb(CMD_LIMITE_TEMPERATURA, indiceZona, novoLimite)) {
+      page += "<p>Novo limite de temperatura: " + String(novoLimite, 1) + " °C</p>";
+    }
+  }
+
+  if (request->hasArg("umid") && request->arg("umid").length() > 0) {
+    float novoLimiteUmidade = request->arg("umid").toFloat();
+    if (novoLimiteUmidade >= 0 && novoLimiteUmidade <= 100 && enfileirarComandoWeb(CMD_LIMITE_UMIDADE, indiceZona, novoLimiteUmidade)) {
+      page += "<p>Novo limite de umidade do solo: " + String(novoLimiteUmidade, 1) + " %</p>";
+    }
+  }
+
+  // Limites da irrigação automática (campos vazios são ignorados)
+  if (request->hasArg("irrLigar") && request->hasArg("irrDesligar") &&
+      request->arg("irrLigar").length() > 0 && request->arg("irrDesligar").length() > 0) {
+    float ligar = request->arg("irrLigar").toFloat();
+    float desligar = request->arg("irrDesligar").toFloat();
+    if (enfileirarComandoWeb(CMD_LIMITES_IRRIGACAO, indiceZona, ligar, desligar)) {
+      page += "<p>Irrigação: liga abaixo de " + String(ligar, 1) + " %, desliga em " + String(desligar, 1) + " %</p>";
+    }
+  }
 
+  if (request->hasArg("irrAuto") && request->arg("irrAuto").length() > 0) {
+    bool automatico = request->arg("irrAuto") == "1";
+    if (enfileirarComandoWeb(CMD_MODO_IRRIGACAO, indiceZona, automatico ? 1 : 0)) {
+      page += String("<p>Irrigação automática: ") + (automatico ? "ligada" : "desligada") + "</p>";
+    }
+  }
 
-// Handler para a rota "/salvar" – atualiza o limite de temperatura
-void handleSave() {
-  if (server.hasArg("temp")) {
-    String tempStr = server.arg("temp");
-    float novoLimite = tempStr.toFloat();
-    if (novoLimite > 0) {
-      limiteTemperaturaAlerta = novoLimite;
-      Serial.println("✅ Novo limite de temperatura: " + String(limiteTemperaturaAlerta, 1));
-      // Notifica via Telegram
-      String msgTelegram = "⚙️ O limite de temperatura foi atualizado para: " + String(limiteTemperaturaAlerta, 1) + "°C";
-      enviarMensagemTelegram(msgTelegram, false, "MarkdownV2");
+  if (request->hasArg("blynk") && request->arg("blynk").length() > 0) {
+    bool habilitado = request->arg("blynk") == "1";
+    if (enfileirarComandoWeb(CMD_BLYNK, 0, habilitado ? 1 : 0)) {
+      page += String("<p>Blynk: ") + (habilitado ? "habilitado" : "desabilitado") + "</p>";
     }
   }
 
-  if (server.hasArg("umid")) {
-    String umidStr = server.arg("umid");
-    float novoLimiteUmidade = umidStr.toFloat();
-    if (novoLimiteUmidade >= 0 && novoLimiteUmidade <= 100) {
-      limiteUmidadeSoloAlerta = novoLimiteUmidade;
-      Serial.println("✅ Novo limite de umidade do solo: " + String(limiteUmidadeSoloAlerta, 1) + "%");
-      enviarMensagemTelegram("⚙️ Novo limite de umidade do solo: " + String(limiteUmidadeSoloAlerta, 1) + "%", false, "MarkdownV2");
+  if (request->hasArg("painel") && request->arg("painel").length() > 0) {
+    bool habilitado = request->arg("painel") == "1";
+    if (enfileirarComandoWeb(CMD_PAINEL_TELEGRAM, 0, habilitado ? 1 : 0)) {
+      page += String("<p>Painel do Telegram: ") + (habilitado ? "habilitado" : "desabilitado") + "</p>";
     }
   }
 
   // Envia uma página de confirmação para o navegador
-  String page = "<!DOCTYPE html><html><head><meta charset='UTF-8'><title>Limite Salvo</title></head><body>";
-  page += "<h1>Configuração Atualizada!</h1>";
-  page += "<p>Novo limite de temperatura: " + String(limiteTemperaturaAlerta, 1) + " °C</p>";
-  page += "<p>Novo limite de umidade do solo: " + String(limiteUmidadeSoloAlerta, 1) + " %</p>";
-  page += "<p><a href='/'>Voltar</a></p>";
+  page += "<p><a href='/?zona=" + String(indiceZona + 1) + "'>Voltar</a></p>";
   page += "</body></html>";
-  server.send(200, "text/html", page);
+  request->send(200, "text/html", page);
 }
 
 
-// Handler para a rota raiz "/" – exibe status do sistema e formulários de controle
-void handleRoot() {
-  String page = R"rawliteral(
+// Página principal, servida direto da flash
+const char PAGINA_PRINCIPAL[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
 <html lang="pt-BR">
 <head>
@@ -402,7 +3243,18 @@ void handleRoot() {
     <meta name="viewport" content="width=device-width, initial-scale=1.0">
     <title>GrowMonitor</title>
     <link rel="icon" type="image/png" href="/favicon.png">
-    <script src="https://cdn.jsdelivr.net/npm/chart.js@4.4.0"></script>
+    <script src="/js/chart-4.4.0.min.js"></script>
+    <script>
+        // Sem o Chart.js no LittleFS, insere o do CDN; a página só monta os gráficos depois
+        const chartPronto = new Promise(resolve => {
+            if (window.Chart) return resolve();
+            const script = document.createElement('script');
+            script.src = 'https://cdn.jsdelivr.net/npm/chart.js@4.4.0';
+            script.onload = resolve;
+            script.onerror = () => { console.error("❌ Chart.js indisponível (flash e CDN)."); resolve(); };
+            document.head.appendChild(script);
+        });
+    </script>
     <style>
         body {
             font-family: Arial, sans-serif;
@@ -453,202 +3305,708 @@ void handleRoot() {
 <body>
     <div class="container">
         <h1>🌱 GrowMonitor - Status</h1>
-        <p class="data">🌡️ Temperatura Interna: <span id="tempInterna">--</span> °C</p>
-        <p class="data">🌡️ Temperatura Externa: <span id="tempExterna">--</span> °C</p>
-        <p class="data">💧 Umidade Externa: <span id="umidadeExterna">--</span> %</p>
-        <p class="data">🌱 Umidade do Solo (Sensor Atual): <span id="umidadeSolo1">--</span> %</p>
-        <p class="data">🌱 Umidade do Solo (S12): <span id="umidadeSolo2">--</span> %</p>
+        <p class="data" id="zonas"></p>
+        <div id="sensores"></div>
         <p class="data">🕒 Última Medição: <span id="horaMedicao">--</span></p>
         
         <h2>Controle da Bomba de Água</h2>
         <button class="button" onclick="toggleBomba()">Alternar Bomba</button>
         <p>Status: <span id="bombaStatus">Desligada</span></p>
+        <p>Irrigação automática: <span id="irrigacaoStatus">--</span></p>
 
         <h2>Configurar Limites de Alerta</h2>
         <form action="/salvar" method="GET">
+            <input type="hidden" id="zonaForm" name="zona" value="1">
             <label for="tempAlerta">Limite de Temperatura (°C):</label>
             <input type="number" step="0.1" id="tempAlerta" name="temp" value="">
             <br>
             <label for="umidadeAlerta">Limite de Umidade do Solo (%):</label>
             <input type="number" step="0.1" id="umidadeAlerta" name="umid" value="">
             <br>
+            <label for="irrLigar">Irrigação: liga abaixo de (%):</label>
+            <input type="number" step="0.1" id="irrLigar" name="irrLigar" value="">
+            <br>
+            <label for="irrDesligar">Irrigação: desliga em (%):</label>
+            <input type="number" step="0.1" id="irrDesligar" name="irrDesligar" value="">
+            <br>
+            <label for="irrAuto">Irrigação automática:</label>
+            <select id="irrAuto" name="irrAuto">
+                <option value="">Sem alteração</option>
+                <option value="1">Ligada</option>
+                <option value="0">Desligada</option>
+            </select>
+            <br>
+            <label for="blynk">Blynk:</label>
+            <select id="blynk" name="blynk">
+                <option value="">Sem alteração</option>
+                <option value="1">Habilitado</option>
+                <option value="0">Desabilitado</option>
+            </select>
+            <br>
+            <label for="painel">Telegram: painel fixado:</label>
+            <select id="painel" name="painel">
+                <option value="">Sem alteração</option>
+                <option value="1">Habilitado</option>
+                <option value="0">Desabilitado (mensagens novas)</option>
+            </select>
+            <br>
             <input class="button" type="submit" value="Salvar">
         </form>
     </div>
     
     <div class="container">
         <h2>📊 Gráficos de Monitoramento</h2>
-        <canvas id="chartTemp"></canvas>
-        <canvas id="chartUmidade"></canvas>
+        <div id="graficos"></div>
+        <noscript><img src="/grafico.svg?range=24h" alt="Gráfico das últimas medições" style="width:100%"></noscript>
+        <p><a href="/grafico.svg?range=24h">Gráfico leve (SVG, sem JavaScript)</a></p>
     </div>
     
 <script>
     console.log("📊 Iniciando configuração dos gráficos...");
 
-    let tempLabels = [];
-    let tempInternaData = [];
-    let tempExternaData = [];
-    let umidadeExternaData = [];
-    let umidadeSolo1Data = [];
-    let umidadeSolo2Data = [];
-
-    // Obtenção dos contextos dos gráficos
-    const ctxTempElement = document.getElementById('chartTemp');
-    const ctxUmidadeElement = document.getElementById('chartUmidade');
-
-    if (!ctxTempElement || !ctxUmidadeElement) {
-        console.error("❌ Não foi possível encontrar os elementos canvas.");
-    }
-
-    const ctxTemp = ctxTempElement.getContext('2d');
-    const ctxUmidade = ctxUmidadeElement.getContext('2d');
-
-    if (!ctxTemp || !ctxUmidade) {
-        console.error("❌ Falha ao obter o contexto 2D dos canvases.");
-    } else {
-        console.log("✅ Contextos 2D obtidos com sucesso.");
-    }
-
-    // Gráfico de Temperaturas
-    const chartTemp = new Chart(ctxTemp, {
-        type: 'line',
-        data: {
-            labels: tempLabels,
-            datasets: [
-                { label: 'Temp. Interna (°C)', data: tempInternaData, borderColor: 'red', fill: false },
-                { label: 'Temp. Externa (°C)', data: tempExternaData, borderColor: 'blue', fill: false }
-            ]
-        },
-        options: {
-            responsive: true,
-            maintainAspectRatio: false,
-            scales: {
-                y: { beginAtZero: true }
-            }
+    // Zona exibida (1 a N), escolhida por "?zona=" na URL
+    const zona = new URLSearchParams(location.search).get('zona') || '1';
+    document.getElementById('zonaForm').value = zona;
+
+    // Sensores vêm de /api/esquema (registro SENSORES do firmware): um cartão por
+    // sensor e um gráfico por unidade, com uma série por sensor
+    let sensores = [];
+    let graficos = [];
+    const rotulos = [];
+    const series = {};
+
+    // Sincronização incremental: sequência da última amostra recebida (cursor) e sessão
+    // do ESP32 (muda quando ele é religado). ultimoEpoch evita repetir o que veio do histórico.
+    let cursor = 0;
+    let sessao = null;
+    let ultimoEpoch = 0;
+
+    // Monta cartões e gráficos a partir do esquema
+    async function carregarEsquema() {
+        const response = await fetch('/api/esquema');
+        if (!response.ok) {
+            console.error("Erro ao carregar o esquema: " + response.status);
+            return;
         }
-    });
-
-    // Gráfico de Umidade
-    const chartUmidade = new Chart(ctxUmidade, {
-        type: 'line',
-        data: {
-            labels: tempLabels,
-            datasets: [
-                { label: 'Umidade Externa (%)', data: umidadeExternaData, borderColor: 'green', fill: false },
-                { label: 'Umidade Solo 1 (%)', data: umidadeSolo1Data, borderColor: 'brown', fill: false },
-                { label: 'Umidade Solo 2 (S12) (%)', data: umidadeSolo2Data, borderColor: 'orange', fill: false }
-            ]
-        },
-        options: {
-            responsive: true,
-            maintainAspectRatio: false,
-            scales: {
-                y: { beginAtZero: true }
-            }
+        sensores = (await response.json()).sensores;
+        const cartoes = document.getElementById('sensores');
+        const areaGraficos = document.getElementById('graficos');
+        const porUnidade = {};
+        for (const s of sensores) {
+            series[s.chave] = [];
+            const p = document.createElement('p');
+            p.className = 'data';
+            p.innerHTML = s.icone + ' ' + s.rotulo + ': <span id="sensor_' + s.chave + '">--</span> ' + s.unidade;
+            cartoes.appendChild(p);
+            (porUnidade[s.unidade] = porUnidade[s.unidade] || []).push(s);
         }
-    });
+        if (!window.Chart) {
+            return;  // Sem Chart.js: só os cartões
+        }
+        for (const unidade in porUnidade) {
+            const canvas = document.createElement('canvas');
+            areaGraficos.appendChild(canvas);
+            graficos.push(new Chart(canvas.getContext('2d'), {
+                type: 'line',
+                data: {
+                    labels: rotulos,
+                    datasets: porUnidade[unidade].map(s =>
+                        ({ label: s.rotulo + ' (' + unidade + ')', data: series[s.chave], borderColor: s.cor, fill: false }))
+                },
+                options: {
+                    responsive: true,
+                    maintainAspectRatio: false,
+                    scales: {
+                        y: { beginAtZero: true }
+                    }
+                }
+            }));
+        }
+        console.log("✅ " + sensores.length + " sensores em " + graficos.length + " gráfico(s).");
+    }
+
+    function atualizarTodosGraficos() {
+        for (const grafico of graficos) grafico.update();
+    }
 
-    // Função para buscar dados do servidor
+    // Busca só as amostras novas (desde o cursor) e o estado da bomba
     async function fetchData() {
-        console.log("🔄 Buscando dados do servidor...");
         try {
-            const response = await fetch('/dados');
+            const response = await fetch('/dados?zona=' + zona + '&since=' + cursor);
             if (!response.ok) {
                 console.error("Erro ao buscar dados: " + response.status);
                 return;
             }
             const data = await response.json();
-            console.log("✅ Dados recebidos:", data);
-
-            // Atualiza os dados nos elementos HTML
-            document.getElementById('tempInterna').innerText = data.tempInterna ?? '--';
-            document.getElementById('tempExterna').innerText = data.tempExterna ?? '--';
-            document.getElementById('umidadeExterna').innerText = data.umidadeExterna ?? '--';
-            document.getElementById('umidadeSolo1').innerText = data.umidadeSolo1 ?? '--';
-            document.getElementById('umidadeSolo2').innerText = data.umidadeSolo2 ?? '--';
-            document.getElementById('horaMedicao').innerText = data.horaMedicao ?? '--';
-            document.getElementById('bombaStatus').innerText = data.bombaLigada ? 'Ligada' : 'Desligada';
-
-            atualizarGraficos(data);
+            if (sessao !== null && data.sessao !== sessao) {
+                // ESP32 religado: a numeração recomeçou, busca tudo de novo
+                console.log("🔄 Nova sessão no ESP32, recomeçando a sincronização.");
+                sessao = data.sessao;
+                cursor = 0;
+                return fetchData();
+            }
+            sessao = data.sessao;
+            cursor = data.seq;
+
+            // Links para as outras zonas (só quando há mais de uma)
+            if (data.zonas && data.zonas.length > 1) {
+                document.getElementById('zonas').innerHTML = data.zonas.map((nome, i) =>
+                    (String(i + 1) === zona ? '<b>' + nome + '</b>' : '<a href="/?zona=' + (i + 1) + '">' + nome + '</a>')).join(' | ');
+            }
+
+            // Cartões com a amostra mais recente
+            if (data.amostras.length > 0) {
+                const ultima = data.amostras[data.amostras.length - 1];
+                for (const s of sensores) {
+                    document.getElementById('sensor_' + s.chave).innerText = ultima[s.chave] ?? '--';
+                }
+                document.getElementById('horaMedicao').innerText = ultima.hora;
+                atualizarGraficos(data.amostras);
+            }
+            document.getElementById('bombaStatus').innerText = data.bombaLigada ? 'Ligada' : (data.estadoBomba === 'repouso' ? 'Em repouso' : 'Desligada');
+            document.getElementById('irrigacaoStatus').innerText = data.irrigacaoAutomatica
+                ? 'Ligada (' + data.irrigacaoLigar + '% → ' + data.irrigacaoDesligar + '%)' : 'Desligada';
         } catch (error) {
             console.error("Erro ao buscar dados:", error);
         }
     }
 
-    // Função para atualizar os gráficos
-    function atualizarGraficos(data) {
-        const maxPontos = 50;
+    // Acrescenta aos gráficos as amostras novas (uma vez cada, pela sequência)
+    function atualizarGraficos(amostras) {
+        const maxPontos = 300;
 
-        // Adiciona novos dados
-        tempLabels.push(data.horaMedicao);
-        tempInternaData.push(parseFloat(data.tempInterna));
-        tempExternaData.push(parseFloat(data.tempExterna));
-        umidadeExternaData.push(parseFloat(data.umidadeExterna));
-        umidadeSolo1Data.push(parseFloat(data.umidadeSolo1));
-        umidadeSolo2Data.push(parseFloat(data.umidadeSolo2));
+        let novas = 0;
+        for (const a of amostras) {
+            if (a.epoch && a.epoch <= ultimoEpoch) continue;  // Já veio em /api/historico
+            rotulos.push(a.epoch ? new Date(a.epoch * 1000).toLocaleTimeString('pt-BR', { hour: '2-digit', minute: '2-digit' }) : a.hora);
+            for (const s of sensores) series[s.chave].push(a[s.chave]);
+            novas++;
+        }
+        if (novas === 0) return;
 
         // Remove dados antigos se exceder o limite
-        if (tempLabels.length > maxPontos) {
-            tempLabels.shift();
-            tempInternaData.shift();
-            tempExternaData.shift();
-            umidadeExternaData.shift();
-            umidadeSolo1Data.shift();
-            umidadeSolo2Data.shift();
+        while (rotulos.length > maxPontos) {
+            rotulos.shift();
+            for (const s of sensores) series[s.chave].shift();
         }
 
-        // Logs para depuração
-        console.log("📊 Atualizando gráfico com os seguintes dados:");
-        console.log("Horários:", tempLabels);
-        console.log("Temp Interna:", tempInternaData);
-        console.log("Umidade Solo 1:", umidadeSolo1Data);
-        console.log("Umidade Solo 2:", umidadeSolo2Data);
-
-        chartTemp.update();
-        chartUmidade.update();
-        console.log("✅ Gráficos atualizados.");
+        atualizarTodosGraficos();
+        console.log("📊 " + novas + " ponto(s) novo(s) no gráfico.");
     }
 
     // Controle da Bomba
     function toggleBomba() {
-        fetch('/bomba').then(() => fetchData());
+        fetch('/bomba?zona=' + zona).then(() => fetchData());
     }
 
-    // Atualiza os dados a cada 5 segundos
-    setInterval(fetchData, 5000);
-    fetchData();
+    // Carrega o histórico (últimas 24 h, um ponto a cada 5 min) em uma única requisição
+    async function carregarHistorico() {
+        console.log("🔄 Carregando histórico...");
+        try {
+            const agora = Math.floor(Date.now() / 1000);
+            const response = await fetch('/api/historico?zona=' + zona + '&from=' + (agora - 86400) + '&step=300');
+            if (!response.ok) {
+                console.error("Erro ao carregar histórico: " + response.status);
+                return;
+            }
+            const [cabecalho, ...linhas] = (await response.text()).trim().split('\n');
+            const colunas = cabecalho.split(',');
+            for (const linha of linhas) {
+                const valores = linha.split(',').map(Number);
+                const campo = (chave) => valores[colunas.indexOf(chave)];
+                if (!campo('epoch')) continue;
+                ultimoEpoch = campo('epoch');
+                rotulos.push(new Date(campo('epoch') * 1000).toLocaleTimeString('pt-BR', { hour: '2-digit', minute: '2-digit' }));
+                for (const s of sensores) series[s.chave].push(campo(s.chave));
+            }
+            atualizarTodosGraficos();
+            console.log("✅ Histórico carregado: " + linhas.length + " pontos.");
+        } catch (error) {
+            console.error("Erro ao carregar histórico:", error);
+        }
+    }
+
+    // Espera o Chart.js, monta a página pelo esquema, carrega o histórico e depois
+    // atualiza os dados a cada 5 segundos
+    chartPronto.then(carregarEsquema).then(carregarHistorico).then(() => {
+        setInterval(fetchData, 5000);
+        fetchData();
+    });
 </script>
 
 </body>
 </html>
   )rawliteral";
 
-  server.send(200, "text/html", page);
+// Handler para a rota raiz "/" – exibe status do sistema e formulários de controle
+// A página muda só com o firmware: o ETag (calculado na primeira requisição) evita reenviá-la
+void handleRoot(AsyncWebServerRequest* request) {
+  static char etag[11] = "";
+  if (etag[0] == '\0') {
+    snprintf(etag, sizeof(etag), "\"%08x\"", fnv1a(2166136261u, (const uint8_t*)PAGINA_PRINCIPAL, strlen_P(PAGINA_PRINCIPAL)));
+  }
+  AsyncWebServerResponse* response = naoModificado(request, etag)
+      ? request->beginResponse(304)
+      : request->beginResponse(200, "text/html", (const uint8_t*)PAGINA_PRINCIPAL, strlen_P(PAGINA_PRINCIPAL));
+  cabecalhosCache(response, etag, false);
+  request->send(response);
+}
+
+
+
+
+
+
+// "/dados?zona=N&since=S": sincronização incremental do dashboard. Devolve só as amostras
+// do histórico em RAM com sequência maior que o cursor S do cliente (S=0 traz todas) e o
+// estado da bomba; sem amostra nova a resposta tem poucas dezenas de bytes. O cliente
+// guarda "seq" como novo cursor e volta ao 0 quando "sessao" muda (ESP32 religado).
+void enviarDadosIncrementais(AsyncWebServerRequest* request, const Zona& zona, uint32_t desde) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->addHeader("Cache-Control", "no-store");
+  response->print("{\"sessao\":" + String(estadoRtc.sessaoAmostras) + ",");
+  if (desde == 0) {
+    response->print("\"zonas\":[");
+    for (int i = 0; i < NUM_ZONAS; i++) {
+      response->print(String(i > 0 ? "," : "") + "\"" + zonas[i].nome + "\"");
+    }
+    response->print("],");
+  }
+
+  response->print("\"amostras\":[");
+  uint32_t cursor = desde;
+  Medicao amostra;
+  bool primeira = true;
+  while (proximaAmostraHistorico(zona, cursor, amostra)) {
+    response->print(String(primeira ? "" : ",") + "{\"seq\":" + String(amostra.sequencia) +
+                    ",\"epoch\":" + String((uint32_t)amostra.epoch) + ",\"hora\":\"" + amostra.tempo + "\"");
+#define SENSOR_AMOSTRA(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+    response->print(",\"" chave "\":" + valorJson(amostra.campo, casas));
+    SENSORES(SENSOR_AMOSTRA)
+#undef SENSOR_AMOSTRA
+    response->print("}");
+    primeira = false;
+  }
+  response->print("],\"seq\":" + String(cursor) + ",");
+  response->print("\"bombaLigada\":" + String(bombaEstaLigada(zona) ? "true" : "false") + ",");
+  response->print("\"estadoBomba\":\"" + nomeEstadoBomba(zona) + "\",");
+  response->print("\"irrigacaoAutomatica\":" + String(zona.irrigacao.modoAutomatico ? "true" : "false") + ",");
+  response->print("\"irrigacaoLigar\":" + String(zona.irrigacao.limiteLigar, 1) + ",");
+  response->print("\"irrigacaoDesligar\":" + String(zona.irrigacao.limiteDesligar, 1));
+  response->print("}");
+  request->send(response);
+}
+
+// Handler para "/dados?zona=N" – última medição e estado da zona
+void handleDados(AsyncWebServerRequest* request) {
+  Zona* zona = zonaDaRequisicao(request);
+  if (zona == nullptr) {
+    request->send(404, "text/plain", "Zona inexistente");
+    return;
+  }
+  if (request->hasParam("since")) {
+    enviarDadosIncrementais(request, *zona, strtoul(request->getParam("since")->value().c_str(), nullptr, 10));
+    return;
+  }
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  response->print("{");
+  response->print("\"zona\":\"" + String(zona->nome) + "\",\"zonas\":[");
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    response->print(String(i > 0 ? "," : "") + "\"" + zonas[i].nome + "\"");
+  }
+  response->print("],");
+  Medicao medicao;
+  uint32_t versao = copiarMedicao(*zona, medicao);
+#define SENSOR_DADOS(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                     pinoBlynk, chaveSheets, chaveDados, ...) \
+  response->print("\"" chaveDados "\":" + valorJson(medicao.campo, casas) + ",");
+  SENSORES(SENSOR_DADOS)
+#undef SENSOR_DADOS
+  response->print("\"horaMedicao\":\"" + String(medicao.tempo) + "\",");
+  response->print("\"versaoMedicao\":" + String(versao) + ",");
+  response->print("\"bombaLigada\":" + String(bombaEstaLigada(*zona) ? "true" : "false") + ",");
+  response->print("\"estadoBomba\":\"" + nomeEstadoBomba(*zona) + "\",");
+  response->print("\"irrigacaoAutomatica\":" + String(zona->irrigacao.modoAutomatico ? "true" : "false") + ",");
+  response->print("\"irrigacaoLigar\":" + String(zona->irrigacao.limiteLigar, 1) + ",");
+  response->print("\"irrigacaoDesligar\":" + String(zona->irrigacao.limiteDesligar, 1) + ",");
+  response->print("\"limiteTemperatura\":" + String(zona->limiteTemperaturaAlerta, 1) + ",");
+  response->print("\"limiteUmidadeSolo\":" + String(zona->limiteUmidadeSoloAlerta, 1));
+  response->print("}");
+
+  request->send(response);
+}
+
+
+
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Conexão Wi-Fi
+// ---------------------------------------------------------------
+
+// Eventos do Wi-Fi (task do driver): só atualizam o estado; o resto fica com o loop
+void eventoWiFi(WiFiEvent_t evento, WiFiEventInfo_t info) {
+  switch (evento) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      tempoUltimaConexaoWiFiMs = millis() - inicioConexaoWiFi;
+      estadoWiFi = ESTADO_WIFI_CONECTADO;
+      conexaoWiFiPendente = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      if (estadoWiFi == ESTADO_WIFI_CONECTADO) {
+        quedasWiFi++;
+      }
+      motivoUltimaQuedaWiFi = info.wifi_sta_disconnected.reason;
+      estadoWiFi = ESTADO_WIFI_DESCONECTADO;
+      break;
+    default:
+      break;
+  }
+}
+
+// Registra os eventos e carrega da NVS o último AP (se a memória RTC não o tiver)
+void configurarWiFi() {
+  WiFi.persistent(false);        // Credenciais vêm do secrets.h: nada de gravar na flash a cada begin()
+  WiFi.setAutoReconnect(false);  // A reconexão com backoff é feita por gerenciarWiFi()
+  WiFi.onEvent(eventoWiFi);
+  if (!estadoRtc.wifiEmCache &&
+      preferencias.getBytes("wifi", &estadoRtc.wifi, sizeof(ConexaoWiFi)) == sizeof(ConexaoWiFi)) {
+    estadoRtc.wifiEmCache = true;
+  }
+}
+
+// Dispara uma tentativa de conexão sem esperar: rápida (AP, canal e IP salvos) se houver dados salvos
+void iniciarConexaoWiFi() {
+  conexaoRapidaWiFi = estadoRtc.wifiEmCache;
+  inicioConexaoWiFi = millis();
+  ultimaTentativaWiFi = millis();
+  estadoWiFi = ESTADO_WIFI_CONECTANDO;
+  if (conexaoRapidaWiFi) {
+    const ConexaoWiFi& salva = estadoRtc.wifi;
+    WiFi.config(IPAddress(salva.ip), IPAddress(salva.gateway), IPAddress(salva.mascara), IPAddress(salva.dns));
+    WiFi.begin(ssid, password, salva.canal, salva.bssid);
+  } else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // Volta ao DHCP
+    WiFi.begin(ssid, password);
+  }
+}
+
+// Contabiliza a conexão e grava o AP e a concessão de IP se mudaram
+void registrarConexaoWiFi() {
+  fecharConexoesTls();
+  unsigned long tempoMs = tempoUltimaConexaoWiFiMs;
+  int faixa = 0;
+  while (faixa < NUM_FAIXAS_WIFI - 1 && tempoMs >= limitesHistogramaWiFiMs[faixa]) {
+    faixa++;
+  }
+  histogramaConexaoWiFi[faixa]++;
+  if (conexaoRapidaWiFi) {
+    conexoesRapidasWiFi++;
+  } else {
+    conexoesCompletasWiFi++;
+  }
+  intervaloReconexaoWiFi = intervaloReconexaoWiFiMin;
+
+  ConexaoWiFi atual;
+  memset(&atual, 0, sizeof(atual));  // Zera o padding para a comparação com memcmp
+  memcpy(atual.bssid, WiFi.BSSID(), sizeof(atual.bssid));
+  atual.canal = WiFi.channel();
+  atual.ip = (uint32_t)WiFi.localIP();
+  atual.gateway = (uint32_t)WiFi.gatewayIP();
+  atual.mascara = (uint32_t)WiFi.subnetMask();
+  atual.dns = (uint32_t)WiFi.dnsIP();
+  if (memcmp(&atual, &estadoRtc.wifi, sizeof(atual)) != 0) {
+    estadoRtc.wifi = atual;
+    preferencias.putBytes("wifi", &atual, sizeof(atual));
+  }
+  estadoRtc.wifiEmCache = true;
+
+  logInfo(String("✅ Wi-Fi conectado em ") + tempoMs + " ms (" + (conexaoRapidaWiFi ? "rápida" : "completa") +
+                 "). IP: " + WiFi.localIP().toString());
+  conexaoRapidaWiFi = false;
+}
+
+// Chamada a cada loop: registra conexões novas, encerra tentativas que passaram
+// do prazo e reconecta com backoff exponencial depois de uma queda.
+void gerenciarWiFi() {
+  if (conexaoWiFiPendente) {
+    conexaoWiFiPendente = false;
+    registrarConexaoWiFi();
+  }
+  if (wifiDesligadoParaDormir) {
+    return;
+  }
+
+  if (estadoWiFi == ESTADO_WIFI_CONECTANDO) {
+    unsigned long prazo = conexaoRapidaWiFi ? timeoutConexaoRapidaWiFiMs : timeoutConexaoWiFiMs;
+    if (millis() - inicioConexaoWiFi < prazo) {
+      return;
+    }
+    WiFi.disconnect();
+    estadoWiFi = ESTADO_WIFI_DESCONECTADO;
+  }
+  if (estadoWiFi != ESTADO_WIFI_DESCONECTADO) {
+    return;
+  }
+
+  if (conexaoRapidaWiFi) {
+    // O AP salvo não respondeu (desligado, trocado ou em outro canal): conexão completa já
+    conexaoRapidaWiFi = false;
+    estadoRtc.wifiEmCache = false;
+    logAviso("⚠️ AP salvo não respondeu. Conectando com varredura e DHCP...");
+    iniciarConexaoWiFi();
+    return;
+  }
+  if (millis() - ultimaTentativaWiFi < intervaloReconexaoWiFi) {
+    return;
+  }
+  logInfo("🔄 Reconectando ao Wi-Fi (motivo da queda: " + String(motivoUltimaQuedaWiFi) + ")...");
+  iniciarConexaoWiFi();
+  intervaloReconexaoWiFi = min(intervaloReconexaoWiFi * 2, intervaloReconexaoWiFiMax);
+}
+
+// Conecta e espera (setup e volta do light-sleep). timeoutMs = 0 espera indefinidamente.
+bool aguardarWiFi(unsigned long timeoutMs) {
+  unsigned long inicio = millis();
+  iniciarConexaoWiFi();
+  while (!wifiConectado()) {
+    if (timeoutMs > 0 && millis() - inicio >= timeoutMs) {
+      logErro("❌ Wi-Fi indisponível. Seguindo sem rede.");
+      return false;
+    }
+    gerenciarWiFi();
+    delay(50);
+  }
+  gerenciarWiFi();
+  return true;
+}
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Baixo Consumo, Memória RTC e Fila de Envio
+// ---------------------------------------------------------------
+
+// Muda com o layout de EstadoRtc, então um firmware novo não aproveita dados de outro
+uint32_t assinaturaRtc() {
+  return 0x47520000u ^ (uint32_t)sizeof(EstadoRtc);
+}
+
+const char* nomeModoEnergia(ModoEnergia modo) {
+  switch (modo) {
+    case ENERGIA_MODEM:    return "modem";
+    case ENERGIA_LEVE:     return "leve";
+    case ENERGIA_PROFUNDO: return "profundo";
+    default:               return "normal";
+  }
+}
+
+bool interpretarModoEnergia(const String& texto, ModoEnergia& modo) {
+  for (int i = ENERGIA_NORMAL; i <= ENERGIA_PROFUNDO; i++) {
+    if (texto == nomeModoEnergia((ModoEnergia)i)) {
+      modo = (ModoEnergia)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Prepara a memória RTC no boot. Na volta de um deep-sleep restaura o histórico
+// recente e a configuração das zonas; nos outros resets mantém só a fila de envio
+// e o cache do Wi-Fi. Conteúdo de outro firmware (ou lixo do power-on) é zerado.
+void iniciarEstadoRtc() {
+  if (estadoRtc.assinatura != assinaturaRtc()) {
+    memset(&estadoRtc, 0, sizeof(estadoRtc));
+    estadoRtc.assinatura = assinaturaRtc();
+    estadoRtc.sessaoAmostras = esp_random();
+    return;
+  }
+  despertouDeepSleep = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+  if (!despertouDeepSleep) {
+    estadoRtc.tempoAcordadoMs = 0;
+    estadoRtc.tempoDormindoMs = 0;
+    estadoRtc.cargaMaMs = 0;
+    estadoRtc.despertares = 0;
+    return;
+  }
+
+  estadoRtc.despertares++;
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    Zona& zona = zonas[i];
+    memcpy(zona.historico, estadoRtc.historico[i], sizeof(zona.historico));
+    zona.indiceMedicao = estadoRtc.indiceMedicao[i];
+    publicarMedicao(zona, estadoRtc.ultimaMedicao[i]);
+    zona.soloControle = mediaSoloMedicao(estadoRtc.ultimaMedicao[i]);
+    // Só a configuração: a bomba estava desligada quando o ESP32 dormiu
+    const Irrigacao& irrigacao = estadoRtc.irrigacao[i];
+    zona.irrigacao.modoAutomatico = irrigacao.modoAutomatico;
+    zona.irrigacao.limiteLigar = irrigacao.limiteLigar;
+    zona.irrigacao.limiteDesligar = irrigacao.limiteDesligar;
+    zona.irrigacao.tempoMaximoLigada = irrigacao.tempoMaximoLigada;
+    zona.irrigacao.tempoMinimoDesligada = irrigacao.tempoMinimoDesligada;
+    zona.limiteTemperaturaAlerta = estadoRtc.limiteTemperaturaAlerta[i];
+    zona.limiteUmidadeSoloAlerta = estadoRtc.limiteUmidadeSoloAlerta[i];
+  }
+  logInfo("⏰ Despertou do deep-sleep (" + String(estadoRtc.despertares) + "º despertar)");
+}
+
+// Copia para a memória RTC o que precisa sobreviver ao deep-sleep
+void salvarEstadoRtc() {
+  portENTER_CRITICAL(&muxHistorico);
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    memcpy(estadoRtc.historico[i], zonas[i].historico, sizeof(zonas[i].historico));
+    estadoRtc.indiceMedicao[i] = zonas[i].indiceMedicao;
+    estadoRtc.ultimaMedicao[i] = medicaoAtual(zonas[i]);
+  }
+  portEXIT_CRITICAL(&muxHistorico);
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    estadoRtc.irrigacao[i] = zonas[i].irrigacao;
+    estadoRtc.limiteTemperaturaAlerta[i] = zonas[i].limiteTemperaturaAlerta;
+    estadoRtc.limiteUmidadeSoloAlerta[i] = zonas[i].limiteUmidadeSoloAlerta;
+  }
+}
+
+// Modem-sleep e CPU a 80 MHz em qualquer modo de economia (o Wi-Fi exige ao menos 80 MHz)
+void aplicarModoEnergia() {
+  bool economia = modoEnergia != ENERGIA_NORMAL;
+  WiFi.setSleep(economia ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+  setCpuFrequencyMhz(economia ? 80 : 240);
 }
 
+void definirModoEnergia(ModoEnergia modo) {
+  modoEnergia = modo;
+  preferencias.putUChar("energia", modo);
+  aplicarModoEnergia();
+  logInfo(String("🔋 Modo de energia: ") + nomeModoEnergia(modo));
+}
 
+// Soma um período à contabilidade de energia
+void contabilizarEnergia(unsigned long acordadoMs, unsigned long dormindoMs, float correnteSonoMa) {
+  estadoRtc.tempoAcordadoMs += acordadoMs;
+  estadoRtc.tempoDormindoMs += dormindoMs;
+  estadoRtc.cargaMaMs += (double)acordadoMs * correnteAcordadoMa + (double)dormindoMs * correnteSonoMa;
+}
 
+// % do tempo acordado desde o power-on (inclui o período acordado atual)
+float cicloTrabalhoEnergia() {
+  double acordado = estadoRtc.tempoAcordadoMs + (millis() - marcoEnergiaMs);
+  double total = acordado + estadoRtc.tempoDormindoMs;
+  return total > 0 ? 100.0 * acordado / total : 100.0;
+}
 
+// Corrente média estimada do módulo desde o power-on (mA)
+float correnteMediaEstimadaMa() {
+  unsigned long acordadoAtual = millis() - marcoEnergiaMs;
+  double carga = estadoRtc.cargaMaMs + (double)acordadoAtual * correnteAcordadoMa;
+  double total = (double)estadoRtc.tempoAcordadoMs + acordadoAtual + estadoRtc.tempoDormindoMs;
+  return total > 0 ? carga / total : correnteAcordadoMa;
+}
 
+// Guarda uma medição para envio posterior; com a fila cheia descarta a mais antiga
+void enfileirarEnvio(const Zona& zona, const Medicao& medicao) {
+  if (estadoRtc.tamanhoFila == MAX_FILA_ENVIO) {
+    estadoRtc.inicioFila = (estadoRtc.inicioFila + 1) % MAX_FILA_ENVIO;
+    estadoRtc.tamanhoFila--;
+    logAviso("⚠️ Fila de envio cheia: medição mais antiga descartada.");
+  }
+  ItemFilaEnvio& item = estadoRtc.fila[(estadoRtc.inicioFila + estadoRtc.tamanhoFila) % MAX_FILA_ENVIO];
+  item.zona = &zona - zonas;
+  item.medicao = medicao;
+  estadoRtc.tamanhoFila++;
+}
 
-void handleDados() {
-  String json = "{";
-  json += "\"tempInterna\":" + String(ultimaTempInterna, 1) + ",";
-  json += "\"tempExterna\":" + String(ultimaTempExterna, 1) + ",";
-  json += "\"umidadeExterna\":" + String(ultimaUmidadeExterna, 1) + ",";
-  json += "\"umidadeSolo1\":" + String(umidadeSolo1, 1) + ",";  // Sensor atual
-  json += "\"umidadeSolo2\":" + String(umidadeSolo2, 1) + ",";  // Sensor S12
-  json += "\"horaMedicao\":\"" + ultimaHoraMedicao + "\",";
-  json += "\"bombaLigada\":" + String(bombaLigada ? "true" : "false") + ",";
-  json += "\"limiteTemperatura\":" + String(limiteTemperaturaAlerta, 1) + ",";
-  json += "\"limiteUmidadeSolo\":" + String(limiteUmidadeSoloAlerta, 1);
-  json += "}";
+// Envia uma medição pendente por volta do loop, na ordem em que foram feitas
+void esvaziarFilaEnvio() {
+  if (estadoRtc.tamanhoFila == 0 || !wifiConectado()) {
+    return;
+  }
+  ItemFilaEnvio item = estadoRtc.fila[estadoRtc.inicioFila];
+  estadoRtc.inicioFila = (estadoRtc.inicioFila + 1) % MAX_FILA_ENVIO;
+  estadoRtc.tamanhoFila--;
+  if (item.zona >= NUM_ZONAS) {
+    return;  // Zona removida da configuração desde que a medição entrou na fila
+  }
+  const Zona& zona = zonas[item.zona];
+  CarimboTempo carimbo;
+  preencherCarimboTempo(carimbo, item.medicao.epoch);
+  logInfo(prefixoZona(zona) + "📤 Enviando medição da fila (" + String(item.medicao.tempo) + ")");
+  enviarIngestBinario(zona, item.medicao);
+  enviarGoogleSheets(zona, item.medicao);
+  enviarDadosFirestore(zona, item.medicao, carimbo);
+}
 
-  server.send(200, "application/json", json);
+// Dormir só quando nada depende do ESP32 acordado
+bool podeDormir() {
+  if (otaEmAndamento) {
+    return false;
+  }
+  if (!despertouDeepSleep && millis() < janelaManutencaoMs) {
+    return false;
+  }
+  if (millis() - marcoEnergiaMs < tempoMinimoAcordadoMs) {
+    return false;
+  }
+  if (estadoRtc.tamanhoFila > 0 && wifiConectado()) {
+    return false;
+  }
+  for (const Zona& zona : zonas) {
+    if (bombaEstaLigada(zona) || zona.corteBombaPendente) {
+      return false;
+    }
+  }
+  return true;
 }
 
+// Chamada ao fim de cada loop: nos modos de economia deixa o ESP32 ocioso ou
+// dormindo até a próxima medição, contabilizando o tempo de cada estado.
+void gerenciarEnergia() {
+  if (modoEnergia == ENERGIA_NORMAL) {
+    return;
+  }
+  if (modoEnergia == ENERGIA_MODEM) {
+    // O delay() libera a CPU para a task ociosa; o rádio dorme entre os beacons do AP
+    unsigned long inicioPausa = millis();
+    contabilizarEnergia(inicioPausa - marcoEnergiaMs, 0, 0);
+    delay(pausaLoopModemMs);
+    contabilizarEnergia(0, millis() - inicioPausa, correnteModemMa);
+    marcoEnergiaMs = millis();
+    return;
+  }
+  if (!podeDormir()) {
+    return;
+  }
 
+  unsigned long decorrido = millis() - ultimaExecucao;
+  unsigned long restanteMs = decorrido >= intervaloMedicao ? 0 : intervaloMedicao - decorrido;
+  if (restanteMs < duracaoMinimaSonoMs) {
+    return;
+  }
+  unsigned long acordadoMs = millis() - marcoEnergiaMs;
+  lcd.noBacklight();
+
+  if (modoEnergia == ENERGIA_PROFUNDO) {
+    // O próximo boot mede logo (ver setup()) e volta a dormir
+    logInfo("😴 Deep-sleep por " + String(restanteMs / 1000) + " s");
+    contabilizarEnergia(acordadoMs, restanteMs, correnteProfundoMa);
+    salvarEstadoRtc();
+    gravarLogArquivo(true);  // O anel fica na RAM comum e se perde no deep-sleep
+    Serial.flush();
+    esp_deep_sleep((uint64_t)restanteMs * 1000);
+  }
 
+  logInfo("😴 Light-sleep por " + String(restanteMs / 1000) + " s");
+  Serial.flush();
+  wifiDesligadoParaDormir = true;
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  unsigned long inicioSono = millis();
+  esp_sleep_enable_timer_wakeup((uint64_t)restanteMs * 1000);
+  esp_light_sleep_start();
+  // millis() continua contando durante o light-sleep
+  contabilizarEnergia(acordadoMs, millis() - inicioSono, correnteLeveMa);
+  estadoRtc.despertares++;
+  marcoEnergiaMs = millis();
+  lcd.backlight();
+  wifiDesligadoParaDormir = false;
+  aguardarWiFi(timeoutWiFiDespertarMs);
+}
 
 // ---------------------------------------------------------------
 // FUNÇÃO: Configurar Hardware e Conexões (Setup)
@@ -658,9 +4016,12 @@ void setup() {
   Serial.begin(115200);
   delay(1000);
 
-  // Configura o pino do relé (bomba) como saída e inicia desligado
-  pinMode(RELE_BOMBA, OUTPUT);
-  digitalWrite(RELE_BOMBA, LOW);
+  // Configura o relé (bomba) de cada zona como saída e inicia desligado
+  for (Zona& zona : zonas) {
+    pinMode(zona.releBomba, OUTPUT);
+    digitalWrite(zona.releBomba, LOW);
+    configurarTimerBomba(zona);
+  }
 
   Serial.println("\n=============================");
   Serial.println("🌱 Iniciando GrowMonitor...");
@@ -671,43 +4032,57 @@ void setup() {
 
 
   if (!LittleFS.begin(true)) {
-    Serial.println("❌ Erro ao montar o sistema de arquivos!");
+    logErro("❌ Erro ao montar o sistema de arquivos!");
     return;
   }
 
-  Serial.println("✅ Sistema de arquivos montado com sucesso!");
+  logInfo("✅ Sistema de arquivos montado com sucesso!");
+
+  // Carrega as configurações persistentes
+  preferencias.begin("growmonitor", false);
+  blynkHabilitado = preferencias.getBool("blynk", true);
+  modoEnergia = (ModoEnergia)preferencias.getUChar("energia", ENERGIA_NORMAL);
+  uint8_t nivelLogSalvo = preferencias.getUChar("log_nivel", LOG_INFO);
+  nivelMinimoLog = nivelLogSalvo <= LOG_ERRO ? (NivelLog)nivelLogSalvo : LOG_INFO;
+  logEmArquivo = preferencias.getBool("log_arquivo", false);
+  painelTelegram = preferencias.getBool("painel", true);
+  idMensagemPainel = preferencias.getLong("painel_id", 0);
+  verificarFormatoHistorico();
+  carregarArquivosEstaticos();
+  iniciarEstadoRtc();
 
 
   // Inicializa o LCD 20x4 com endereço 0x27
   lcd.begin(20, 4, 0x27);
-  Serial.println("✅ LCD 20x4 inicializado com sucesso!");
+  logInfo("✅ LCD 20x4 inicializado com sucesso!");
   lcd.backlight();
   lcd.clear();
   lcd.print("Iniciando...");
 
-  pinMode(SOIL_SENSOR1_PIN, INPUT);
+  for (const Zona& zona : zonas) {
+    pinMode(zona.solo1.pino, INPUT);
+    pinMode(zona.solo2.pino, INPUT);
+  }
 
 
   // Inicializa os sensores
   dht.begin();
   sensors.begin();
-  Serial.println("\n✅ Sensores iniciados");
-
-  // Conecta à rede Wi-Fi
-  Serial.print("🔌 Conectando ao Wi-Fi ");
-  WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-  }
+  iniciarSondasTemperatura();
+  logInfo("\n✅ Sensores iniciados");
 
-  Serial.println("\n✅ Wi-Fi conectado!");
+  // Conecta à rede Wi-Fi (na volta do deep-sleep sem esperar indefinidamente)
+  logInfo("🔌 Conectando ao Wi-Fi...");
+  configurarWiFi();
+  configurarConexoesTls();
+  aguardarWiFi(despertouDeepSleep ? timeoutWiFiDespertarMs : 0);
+  aplicarModoEnergia();
 
   if (!MDNS.begin("esp32")) {
-    Serial.println("Erro ao iniciar mDNS!");
+    logErro("Erro ao iniciar mDNS!");
     while (1) { delay(1000); }
   }
-  Serial.println("mDNS iniciado com sucesso. Use esp32.local para acessar o dispositivo.");
+  logInfo("mDNS iniciado com sucesso. Use esp32.local para acessar o dispositivo.");
 
 // Configura OTA
 ArduinoOTA.setHostname("meu-esp32");  // Nome do dispositivo na rede
@@ -716,33 +4091,51 @@ ArduinoOTA.setTimeout(20000);  // Aumenta o tempo limite para conexões OTA
 
 // Inicialização do OTA
 ArduinoOTA.onStart([]() {
-  Serial.println("Iniciando atualização OTA...");
+  otaEmAndamento = true;
+  logInfo("Iniciando atualização OTA...");
 });
 ArduinoOTA.onEnd([]() {
-  Serial.println("Atualização OTA finalizada.");
+  otaEmAndamento = false;
+  logInfo("Atualização OTA finalizada.");
 });
 ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
   Serial.printf("Progresso OTA: %u%%\r", (progress * 100) / total);
 });
 ArduinoOTA.onError([](ota_error_t error) {
-  Serial.printf("Erro OTA [%u]: ", error);
-  if (error == OTA_AUTH_ERROR) Serial.println("Falha de autenticação");
-  else if (error == OTA_BEGIN_ERROR) Serial.println("Falha ao iniciar OTA");
-  else if (error == OTA_CONNECT_ERROR) Serial.println("Falha de conexão");
-  else if (error == OTA_RECEIVE_ERROR) Serial.println("Erro na recepção");
-  else if (error == OTA_END_ERROR) Serial.println("Falha ao finalizar OTA");
+  otaEmAndamento = false;
+  const char* motivo = "";
+  if (error == OTA_AUTH_ERROR) motivo = "Falha de autenticação";
+  else if (error == OTA_BEGIN_ERROR) motivo = "Falha ao iniciar OTA";
+  else if (error == OTA_CONNECT_ERROR) motivo = "Falha de conexão";
+  else if (error == OTA_RECEIVE_ERROR) motivo = "Erro na recepção";
+  else if (error == OTA_END_ERROR) motivo = "Falha ao finalizar OTA";
+  logErro("Erro OTA [" + String(error) + "]: " + motivo);
 });
 ArduinoOTA.begin();
-Serial.println("OTA iniciado e pronto para atualizações.");
+logInfo("OTA iniciado e pronto para atualizações.");
   
  
 
-  // Configura os comandos do Telegram
-  configurarComandosTelegram();
+  // Configura os comandos do Telegram (já registrados se está voltando do deep-sleep)
+  if (!despertouDeepSleep) {
+    configurarComandosTelegram();
+  }
+
+  // Inicia o Blynk (sem bloquear: se a nuvem estiver fora, o loop tenta de novo com backoff)
+  Blynk.config(BLYNK_AUTH_TOKEN);
+  if (blynkHabilitado) {
+    conectarBlynk(true);
+  } else {
+    logInfo("ℹ️ Blynk desabilitado. Use /blynk on para habilitar.");
+  }
+
+  // Prepara o cliente MQTT (a conexão é feita no loop)
+  if (mqttConfigurado()) {
+    configurarMqtt();
+  }
 
-  // Inicia a conexão com o Blynk e o cliente NTP
-  Blynk.begin(BLYNK_AUTH_TOKEN, ssid, password);
-  timeClient.begin();
+  // Inicia o SNTP do ESP-IDF (configTzTime) com o fuso horário local
+  configurarRelogio();
 
   // Configura os LEDs de indicação
   pinMode(LED_VERDE, OUTPUT);
@@ -750,36 +4143,60 @@ Serial.println("OTA iniciado e pronto para atualizações.");
   digitalWrite(LED_VERDE, LOW);
   digitalWrite(LED_VERMELHO, HIGH);
 
+  // Fila de comandos entre os handlers assíncronos e o loop()
+  filaComandosWeb = xQueueCreate(tamanhoFilaComandosWeb, sizeof(ComandoWeb));
+
   // Configura as rotas do servidor web
-  server.on("/", handleRoot);
-  server.on("/salvar", handleSave);
-  server.on("/bomba", handleBomba);  // Rota para controle da bomba
-  server.on("/dados", handleDados);
-  server.on("/favicon.png", HTTP_GET, handleFavicon);
+  server.on("/", HTTP_GET, handleRoot);
+  server.on("/salvar", HTTP_GET, handleSave);
+  server.on("/bomba", HTTP_GET, handleBomba);  // Rota para controle da bomba
+  server.on("/dados", HTTP_GET, handleDados);
+  server.on("/metrics", HTTP_GET, handleMetricas);
+  server.on("/api/historico", HTTP_GET, handleHistorico);
+  server.on("/grafico.svg", HTTP_GET, handleGraficoSvg);
+  server.on("/api/esquema", HTTP_GET, handleEsquema);
+  server.on("/logs", HTTP_GET, handleLogs);
+  for (const ArquivoEstatico& arquivo : arquivosEstaticos) {
+    server.on(arquivo.url, HTTP_GET, handleArquivoEstatico);
+  }
 
   
-  server.on("/realizar-medicao", HTTP_GET, []() {
-    realizarMedicao(true); // Força uma medição imediata
-    server.send(200, "text/plain", "Medição realizada com sucesso!");
+  server.on("/realizar-medicao", HTTP_GET, [](AsyncWebServerRequest* request) {
+    // A medição roda no loop(); responde na hora com o id do trabalho (consultado em
+    // /medicao?id=N). Uma medição recente é devolvida como concluída (200)
+    bool emCache;
+    uint32_t id = pedirMedicao(PEDIDO_WEB, emCache);
+    request->send(emCache ? 200 : 202, "application/json",
+                  "{\"id\":" + String(id) + ",\"estado\":\"" + (emCache ? "concluido" : "agendado") + "\"}");
   });
 
+  server.on("/medicao", HTTP_GET, handleEstadoMedicao);
+
 
 
-  server.on("/sensor-data", HTTP_GET, []() {
-    String json = "{";
-    json += "\"temperaturaInterna\":" + String(ultimaTempInterna) + ",";
-    json += "\"temperaturaExterna\":" + String(ultimaTempExterna) + ",";
-    json += "\"umidadeExterna\":" + String(ultimaUmidadeExterna) + ",";
-    json += "\"umidadeSolo1\":" + String(umidadeSolo1) + ",";
-    json += "\"umidadeSolo2\":" + String(umidadeSolo2) + ",";
-    json += "\"horaMedicao\":\"" + String(ultimaHoraMedicao) + "\""; // Adiciona o horário ao JSON
-    json += "}";
-    server.send(200, "application/json", json);
+  server.on("/sensor-data", HTTP_GET, [](AsyncWebServerRequest* request) {
+    Zona* zona = zonaDaRequisicao(request);
+    if (zona == nullptr) {
+      request->send(404, "text/plain", "Zona inexistente");
+      return;
+    }
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->print("{");
+    Medicao medicao;
+    uint32_t versao = copiarMedicao(*zona, medicao);
+#define SENSOR_JSON(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+    response->print("\"" #campo "\":" + valorJson(medicao.campo, casas) + ",");
+    SENSORES(SENSOR_JSON)
+#undef SENSOR_JSON
+    response->print("\"versaoMedicao\":" + String(versao) + ",");
+    response->print("\"horaMedicao\":\"" + String(medicao.tempo) + "\""); // Adiciona o horário ao JSON
+    response->print("}");
+    request->send(response);
   });
 
   // Inicia o servidor web
   server.begin();
-  Serial.println("🌐 Servidor web iniciado. Acesse: http://" + WiFi.localIP().toString());
+  logInfo("🌐 Servidor web iniciado. Acesse: http://" + WiFi.localIP().toString());
 
   // Atualiza o LCD para indicar que o sistema está pronto
   lcd.clear();
@@ -787,7 +4204,13 @@ Serial.println("OTA iniciado e pronto para atualizações.");
   lcd.print("Sistema pronto!");
   lcd.setCursor(0, 1);
   lcd.print("Aguardando...");
-  Serial.println("✅ Sistema pronto! Aguardando medições...");
+  logInfo("✅ Sistema pronto! Aguardando medições...");
+
+  // Na volta do deep-sleep mede logo e não repete o aviso de inicialização
+  if (despertouDeepSleep) {
+    ultimaExecucao = millis() - intervaloMedicao;
+    return;
+  }
 
   // Envia mensagem ao Telegram indicando que o sistema foi iniciado
   String mensagemInicio = "🚀 GrowMonitor iniciado com sucesso!\n"
@@ -802,251 +4225,683 @@ Serial.println("OTA iniciado e pronto para atualizações.");
 
 
 
-void enviarDadosFirestore(float temperaturaInterna, float temperaturaExterna, float umidadeExterna, float umidadeSolo1, float umidadeSolo2, String horaMedicao) {
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    String url = "https://firestore.googleapis.com/v1/projects/growmonitor-94f3b/databases/(default)/documents/dados"; 
-    http.begin(url);
-    http.addHeader("Content-Type", "application/json");
+// Um documento por zona com todos os sensores da medição
+void enviarDadosFirestore(const Zona& zona, const Medicao& medicao, const CarimboTempo& carimbo) {
+  if (wifiConectado()) {
+    String url = "https://firestore.googleapis.com/v1/projects/growmonitor-94f3b/databases/(default)/documents/dados"; 
+
+    // Criando JSON
+    // Um campo por sensor + zona + horaMedicao + createdAt, cada um em um objeto de 1 membro
+    StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(NUM_SENSORES + 3) + (NUM_SENSORES + 3) * JSON_OBJECT_SIZE(1)> json;
+#define SENSOR_FIRESTORE(campo, ...) \
+    if (isnan(medicao.campo)) json["fields"][#campo]["nullValue"] = nullptr; \
+    else json["fields"][#campo]["doubleValue"] = medicao.campo;
+    SENSORES(SENSOR_FIRESTORE)
+#undef SENSOR_FIRESTORE
+    json["fields"]["zona"]["stringValue"] = zona.id;
+    json["fields"]["horaMedicao"]["stringValue"] = carimbo.hora;
+    // Timestamp ISO 8601 (UTC) já formatado no carimbo; omitido se o relógio não sincronizou
+    if (carimbo.epoch != 0) {
+      json["fields"]["createdAt"]["timestampValue"] = carimbo.iso;
+    }
+
+    // Serializa para string JSON
+    String jsonString;
+    serializeJson(json, jsonString);
+
+    // Documento completo só no log de depuração (/log nivel debug)
+    logDebug(prefixoZona(zona) + "📤 Firestore: " + jsonString);
+
+    HTTPClient http;
+    int httpResponseCode = requisicaoHttps(HOST_FIRESTORE, http, url, &jsonString);
+    contarBytesUplink(UPLINK_FIRESTORE, jsonString.length());
+    if (httpResponseCode > 0) {
+      http.getString();  // Documento criado: só esvazia o socket para reaproveitar a conexão
+      logInfo(prefixoZona(zona) + "🔥 Dados enviados ao Firestore. Código: " + String(httpResponseCode));
+    } else {
+      logErro(prefixoZona(zona) + "❌ Erro ao enviar ao Firestore. Código HTTP: " + String(httpResponseCode));
+    }
+    http.end();
+  } else {
+    logAviso("⚠️ Wi-Fi desconectado. Não foi possível enviar dados ao Firestore.");
+  }
+}
+
+
+
+
+
+
+
+// ---------------------------------------------------------------
+// FUNÇÕES: Saúde dos Sensores
+// ---------------------------------------------------------------
+
+const char* nomeBarramento(Barramento barramento) {
+  switch (barramento) {
+    case BARRAMENTO_ONEWIRE: return "OneWire";
+    case BARRAMENTO_DHT:     return "DHT";
+    default:                 return "ADC";
+  }
+}
+
+// Classifica a leitura de um canal, atualiza a sua saúde e acrescenta a avisos
+// as mudanças que devem ir ao Telegram. Retorna true se o valor pode ser usado.
+bool avaliarCanal(const Zona& zona, SaudeSensor& saude, const char* rotulo, float bruto, float valor,
+                  float minimo, float maximo, uint16_t travamento, String& avisos) {
+  FalhaSensor falha = FALHA_NENHUMA;
+  if (bruto == LEITURA_DESCONECTADA) {
+    falha = FALHA_DESCONECTADO;
+  } else if (isnan(valor)) {
+    falha = FALHA_NAN;
+  } else if (valor < minimo || valor > maximo) {
+    falha = FALHA_FORA_FAIXA;
+  } else {
+    // Valores no limite da faixa (ex.: solo saturado em 0% ou 100%) não contam como travamento
+    if (valor == saude.ultimoValor && valor > minimo && valor < maximo) {
+      saude.repeticoes++;
+    } else {
+      saude.repeticoes = 0;
+    }
+    saude.ultimoValor = valor;
+    if (travamento > 0 && saude.repeticoes >= travamento) {
+      falha = FALHA_TRAVADO;
+    }
+  }
+
+  saude.falha = falha;
+  saude.taxaFalhas = saude.taxaFalhas * 0.9f + (falha != FALHA_NENHUMA ? 0.1f : 0.0f);
+  if (falha == FALHA_NENHUMA) {
+    saude.falhasSeguidas = 0;
+    if (saude.avisada) {
+      saude.avisada = false;
+      avisos += prefixoZona(zona) + "✅ Sensor " + rotulo + " voltou a responder.\n";
+    }
+    return true;
+  }
+
+  if (saude.falhasSeguidas < 255) {
+    saude.falhasSeguidas++;
+  }
+  logErro(prefixoZona(zona) + "❌ " + rotulo + ": " + descreverFalha(falha));
+  if (!saude.avisada && saude.falhasSeguidas >= falhasParaAvisar) {
+    saude.avisada = true;
+    avisos += prefixoZona(zona) + "⚠️ Sensor " + rotulo + " com falha (" + descreverFalha(falha) + ").\n";
+  }
+  return false;
+}
+
+// Reinicia o barramento de um canal com falha. Com as sondas DS18B20 a lista de
+// endereços é refeita, o que também recupera uma sonda religada.
+void reiniciarBarramento(Zona& zona, Barramento barramento) {
+  switch (barramento) {
+    case BARRAMENTO_ONEWIRE:
+      sensors.begin();
+      iniciarSondasTemperatura();
+      break;
+    case BARRAMENTO_DHT:
+      zona.dht->begin();
+      break;
+    case BARRAMENTO_ADC:
+      pinMode(zona.solo1.pino, INPUT);
+      pinMode(zona.solo2.pino, INPUT);
+      break;
+    default:
+      break;
+  }
+}
 
-    // Obtém timestamp no formato correto (ISO 8601)
-    time_t now = timeClient.getEpochTime();  
-    struct tm *timeinfo = gmtime(&now); // Converte para UTC
-    char timestampISO[25];
-    strftime(timestampISO, sizeof(timestampISO), "%Y-%m-%dT%H:%M:%SZ", timeinfo); 
+// Com falha, reinicia o barramento com espera dobrando entre tentativas (30 s a 30 min);
+// sem falha, zera o backoff.
+void atualizarRecuperacao(Zona& zona, Barramento barramento, bool falhou) {
+  RecuperacaoBarramento& recuperacao = zona.recuperacao[barramento];
+  if (!falhou) {
+    recuperacao.intervalo = 0;
+    return;
+  }
+  if (recuperacao.intervalo != 0 && millis() - recuperacao.ultimaTentativa < recuperacao.intervalo) {
+    return;
+  }
+  recuperacao.ultimaTentativa = millis();
+  recuperacao.intervalo = recuperacao.intervalo == 0 ? intervaloRecuperacaoMin
+                                                     : min(recuperacao.intervalo * 2, intervaloRecuperacaoMax);
+  reiniciarBarramento(zona, barramento);
+  logInfo(prefixoZona(zona) + "🔄 Barramento " + nomeBarramento(barramento) +
+                 " reiniciado. Próxima tentativa em " + String(recuperacao.intervalo / 1000) + " s");
+}
 
-    // Criando JSON
-    StaticJsonDocument<256> json;
-    json["fields"]["temperaturaInterna"]["doubleValue"] = temperaturaInterna;
-    json["fields"]["temperaturaExterna"]["doubleValue"] = temperaturaExterna;
-    json["fields"]["umidadeExterna"]["doubleValue"] = umidadeExterna;
-    json["fields"]["umidadeSolo1"]["doubleValue"] = umidadeSolo1;
-    json["fields"]["umidadeSolo2"]["doubleValue"] = umidadeSolo2;
-    json["fields"]["horaMedicao"]["stringValue"] = horaMedicao;
-    json["fields"]["createdAt"]["timestampValue"] = String(timestampISO); // 🔥 Agora está correto!
+// Lê os sensores da zona, guarda a medição no histórico e monta os alertas.
+// A conversão do DS18B20 já foi disparada para todas as zonas em realizarMedicao().
+// Canais com falha ficam NAN e os demais seguem normalmente; avisos recebe as
+// falhas e recuperações para o Telegram. Retorna false se nenhum sensor respondeu.
+bool medirZona(Zona& zona, const CarimboTempo& carimbo, String& alerta, String& avisos) {
+  Medicao nova;
+  int indice = 0;
+  int canaisValidos = 0;
+  bool barramentoFalhou[NUM_BARRAMENTOS] = {};
+#define SENSOR_LER(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                   pinoBlynk, chaveSheets, chaveDados, classeHa, cor, minimo, maximo, travamento, barramento, papel) \
+  { \
+    float bruto; \
+    nova.campo = lerCalibrado_##campo(zona, bruto); \
+    if (avaliarCanal(zona, zona.saude[indice], rotulo, bruto, nova.campo, minimo, maximo, travamento, avisos)) { \
+      canaisValidos++; \
+    } else { \
+      nova.campo = NAN; \
+      barramentoFalhou[barramento] = true; \
+    } \
+    indice++; \
+  }
+  SENSORES(SENSOR_LER)
+#undef SENSOR_LER
 
-    // Serializa para string JSON
-    String jsonString;
-    serializeJson(json, jsonString);
+  for (int i = 0; i < NUM_BARRAMENTOS; i++) {
+    atualizarRecuperacao(zona, (Barramento)i, barramentoFalhou[i]);
+  }
+
+  if (canaisValidos == 0) {
+    logErro(prefixoZona(zona) + "❌ Erro: Nenhum sensor respondeu!");
+    lcd.clear();
+    lcd.print("Erro sensores!");
+    if (NUM_ZONAS > 1) {
+      lcd.setCursor(0, 1);
+      lcd.print(zona.nome);
+    }
+    return false;
+  }
 
-    // Enviar logs via Telegram para depuração remota
-    enviarMensagemTelegram("📤 Enviando dados para Firestore...\n" + jsonString, false, "MarkdownV2");
+  strcpy(nova.tempo, carimbo.hora);
+  nova.epoch = carimbo.epoch;
+  nova.sequencia = ++estadoRtc.sequenciaAmostras;
+
+  // Armazena a medição no histórico da zona para o gráfico e como última medição
+  portENTER_CRITICAL(&muxHistorico);
+  if (zona.indiceMedicao < MAX_MEDICOES) {
+    zona.historico[zona.indiceMedicao++] = nova;
+  } else {
+    for (int i = 1; i < MAX_MEDICOES; i++) {
+      zona.historico[i - 1] = zona.historico[i];
+    }
+    zona.historico[MAX_MEDICOES - 1] = nova;
+  }
+  portEXIT_CRITICAL(&muxHistorico);
+
+  // Publica a amostra inteira de uma vez, antes de qualquer envio (dashboard e LCD
+  // passam a mostrá-la já), e alimenta o controle de irrigação com o solo medido
+  publicarMedicao(zona, nova);
+  zona.soloControle = mediaSoloMedicao(nova);
+  zona.leituraSoloValida = true;
+
+  // Grava a amostra no histórico em flash (consultado por /api/historico)
+  registrarHistoricoFlash(zona);
+
+  // ⚠️ Verifica condições de alerta (pelo papel de cada canal no registro)
+  alerta = "";
+#define SENSOR_ALERTA(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                      pinoBlynk, chaveSheets, chaveDados, classeHa, cor, minimo, maximo, travamento, barramento, papel) \
+  if (alertaSensor(zona, papel, nova.campo)) { \
+    alerta += String("🚨 Alerta: ") + textoAlerta(papel) + " " rotulo " em " + String(nova.campo, casas) + unidade "\n"; \
+  }
+  SENSORES(SENSOR_ALERTA)
+#undef SENSOR_ALERTA
+  return true;
+}
 
-    int httpResponseCode = http.POST(jsonString);
+// Envia uma medição da zona ao Google Sheets via requisição HTTP POST
+void enviarGoogleSheets(const Zona& zona, const Medicao& medicao) {
+  if (wifiConectado()) {
+    // Monta o JSON com os campos esperados pelo Apps Script (coluna chaveSheets do registro)
+    String postData = "{\"zona\":\"" + String(zona.id) + "\"";
+#define SENSOR_SHEETS(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                      pinoBlynk, chaveSheets, ...) \
+    if (sizeof(chaveSheets) > 1) { \
+      postData += ",\"" chaveSheets "\":" + valorJson(medicao.campo, casas); \
+    }
+    SENSORES(SENSOR_SHEETS)
+#undef SENSOR_SHEETS
+    postData += "}";
+    // scriptURL deve apontar para script.google.com (conexão persistente do host HOST_SHEETS)
+    HTTPClient http;
+    const char* cabecalhos[] = { "Location" };
+    http.collectHeaders(cabecalhos, 1);
+    int httpResponseCode = requisicaoHttps(HOST_SHEETS, http, scriptURL, &postData);
+    contarBytesUplink(UPLINK_SHEETS, postData.length());
     if (httpResponseCode > 0) {
-      enviarMensagemTelegram("✅ Dados enviados com sucesso ao Firestore! Código: " + String(httpResponseCode), false, "MarkdownV2");
+      http.getString();  // Só esvazia o socket para reaproveitar a conexão
+    }
+    // O Apps Script executa o doPost() e responde 302 para script.googleusercontent.com,
+    // onde fica só o texto de retorno; o redirecionamento não é seguido (seria outro host
+    // e outro handshake). Um 302 para outro lugar (ex.: accounts.google.com, implantação
+    // sem acesso "Qualquer pessoa") significa que o script não rodou.
+    String destino = http.header("Location");
+    if (httpResponseCode == 200) {
+      logInfo(prefixoZona(zona) + "🌐 Dados enviados ao Google Sheets com sucesso!");
+    } else if ((httpResponseCode == 302 || httpResponseCode == 303) &&
+               destino.startsWith("https://script.googleusercontent.com/")) {
+      logInfo(prefixoZona(zona) + "🌐 Dados enviados ao Google Sheets (Apps Script executado, " +
+              String(httpResponseCode) + " para script.googleusercontent.com)");
+    } else if (httpResponseCode == 302 || httpResponseCode == 303) {
+      logErro(prefixoZona(zona) + "❌ Google Sheets redirecionou para " + destino.substring(0, 60) +
+              ": confira a implantação do Apps Script");
     } else {
-      enviarMensagemTelegram("❌ ERRO ao enviar para Firestore! Código: " + String(httpResponseCode), false, "MarkdownV2");
+      logErro(prefixoZona(zona) + "❌ Erro ao enviar ao Google Sheets. Código HTTP: " + String(httpResponseCode));
     }
     http.end();
   } else {
-    enviarMensagemTelegram("❌ Wi-Fi desconectado. Não foi possível enviar dados ao Firestore.", false, "MarkdownV2");
+    logAviso("⚠️ Wi-Fi desconectado. Não foi possível enviar ao Google Sheets.");
   }
 }
 
+void preencherPacoteAmostra(PacoteAmostra& pacote, const Zona& zona, const Medicao& medicao) {
+  preencherCabecalhoPacote(pacote, &zona - zonas, (uint32_t)medicao.epoch);
+  int indice = 0;
+#define SENSOR_PACOTE(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+  pacote.valores[indice++] = valorPontoFixo(medicao.campo, casas);
+  SENSORES(SENSOR_PACOTE)
+#undef SENSOR_PACOTE
+}
 
+// Envia a amostra ao endpoint de ingestão (ingestURL vazio = desativado). Só para a rede
+// local: vai em HTTP puro, sem TLS (o pool TLS tem CAs fixadas só para os serviços
+// conhecidos), então URLs https:// ou de outro esquema são recusadas.
+void enviarIngestBinario(const Zona& zona, const Medicao& medicao) {
+  if (ingestURL == nullptr || ingestURL[0] == '\0' || !wifiConectado()) {
+    return;
+  }
+  if (strncmp(ingestURL, "http://", 7) != 0) {
+    static bool avisado = false;
+    if (!avisado) {
+      logErro("❌ ingestURL deve ser http:// na rede local (ex.: tools/ingest_growmonitor.py); envio binário desativado");
+      avisado = true;
+    }
+    return;
+  }
+  PacoteAmostra pacote;
+  preencherPacoteAmostra(pacote, zona, medicao);
+  HTTPClient http;
+  http.begin(ingestURL);
+  http.addHeader("Content-Type", "application/octet-stream");
+  int httpResponseCode = http.POST((uint8_t*)&pacote, sizeof(pacote));
+  contarBytesUplink(UPLINK_BINARIO, sizeof(pacote));
+  if (httpResponseCode > 0) {
+    logInfo(prefixoZona(zona) + "📦 Amostra binária enviada (" + String(sizeof(pacote)) + " bytes)");
+  } else {
+    logErro(prefixoZona(zona) + "❌ Erro ao enviar a amostra binária. Código HTTP: " + String(httpResponseCode));
+  }
+  http.end();
+}
 
+// Envia a última medição da zona aos destinos externos (um payload por zona e destino)
+void enviarMedicaoZona(const Zona& zona, const CarimboTempo& carimbo) {
+  const Medicao& medicao = medicaoAtual(zona);
 
+  // Atualiza os dados enviados via Blynk (todos os canais em uma mensagem)
+  if (&zona == &zonas[0]) {
+    publicarBlynk(zona);
+  }
 
+  // Sheets e Firestore guardam a série: sem Wi-Fi a medição espera na fila de envio
+  if (wifiConectado()) {
+    enviarIngestBinario(zona, medicao);
+    enviarGoogleSheets(zona, medicao);
+    enviarDadosFirestore(zona, medicao, carimbo);
+  } else {
+    logAviso(prefixoZona(zona) + "⚠️ Wi-Fi desconectado. Medição guardada na fila de envio.");
+    enfileirarEnvio(zona, medicao);
+  }
 
+  // Publica o snapshot e a saúde dos sensores no MQTT (retidos)
+  publicarEstadoMqtt(zona);
+  publicarSaudeMqtt(zona);
+}
 
 // ---------------------------------------------------------------
-// FUNÇÃO: Realizar Medição e Atualizar Sistema
+// FUNÇÕES: Sondas DS18B20
 // ---------------------------------------------------------------
-void realizarMedicao(bool forcarEnvioTelegram) {
-  Serial.println("\n📡 Iniciando nova medição...");
-  digitalWrite(LED_VERDE, HIGH);
-  digitalWrite(LED_VERMELHO, LOW);
 
-  // Solicita e lê os dados dos sensores
-  sensors.requestTemperatures();
-  float temperaturaInterna = sensors.getTempCByIndex(0);
-  float temperaturaExterna = dht.readTemperature();
-  float umidadeExterna = dht.readHumidity();
-
-  // Leitura do sensor de umidade do solo (valor analógico de 0 a 4095)
-  // Converte para porcentagem (0 a 100%); ajuste os limites conforme sua calibração.
-  // Leitura dos sensores de umidade do solo
-  int rawSoil1 = analogRead(SOIL_SENSOR1_PIN);  // Sensor atual
-  int rawSoil2 = analogRead(SOIL_SENSOR2_PIN);  // Sensor S12
-  
-  Serial.println("🔍 Leituras Analógicas dos Sensores de Solo:");
-  Serial.print(" - Sensor 1 (Atual): ");
-  Serial.println(rawSoil1);
-  Serial.print(" - Sensor 2 (S12): ");
-  Serial.println(rawSoil2);
+// Endereço ROM em hexadecimal, como aparece no log do boot
+String enderecoSondaTexto(const DeviceAddress endereco) {
+  char texto[17];
+  for (uint8_t i = 0; i < 8; i++) {
+    snprintf(texto + 2 * i, 3, "%02X", endereco[i]);
+  }
+  return String(texto);
+}
 
+// Carrega os endereços gravados na NVS e acrescenta ao fim da lista as sondas
+// novas encontradas no barramento. A enumeração do OneWire segue a ordem dos
+// ROMs, então ligar uma sonda nova mudaria os índices; com a lista gravada,
+// cada zona continua apontando para a mesma sonda.
+void iniciarSondasTemperatura() {
+  numeroSondas = preferencias.getBytes("sondas", enderecosSondas, sizeof(enderecosSondas)) / sizeof(DeviceAddress);
+
+  bool listaAlterada = false;
+  DeviceAddress endereco;
+  uint8_t encontradas = sensors.getDeviceCount();
+  for (uint8_t i = 0; i < encontradas && numeroSondas < MAX_SONDAS; i++) {
+    if (!sensors.getAddress(endereco, i)) {
+      continue;
+    }
+    bool conhecida = false;
+    for (uint8_t j = 0; j < numeroSondas && !conhecida; j++) {
+      conhecida = memcmp(enderecosSondas[j], endereco, sizeof(DeviceAddress)) == 0;
+    }
+    if (!conhecida) {
+      memcpy(enderecosSondas[numeroSondas++], endereco, sizeof(DeviceAddress));
+      listaAlterada = true;
+    }
+  }
+  if (listaAlterada) {
+    preferencias.putBytes("sondas", enderecosSondas, numeroSondas * sizeof(DeviceAddress));
+  }
+
+  // Sondas sem zona ficam em 9 bits para não alongar a conversão do barramento,
+  // que só termina quando a sonda mais lenta termina.
+  for (uint8_t i = 0; i < numeroSondas; i++) {
+    bool presente = sensors.isConnected(enderecosSondas[i]);
+    if (presente) {
+      sensors.setResolution(enderecosSondas[i], 9);
+    }
+    logInfo("🌡️ Sonda " + String(i) + ": " + enderecoSondaTexto(enderecosSondas[i]) + (presente ? "" : " (ausente)"));
+  }
+  for (const Zona& zona : zonas) {
+    if (zona.sondaTemperatura < numeroSondas) {
+      sensors.setResolution(enderecosSondas[zona.sondaTemperatura], zona.resolucaoSonda);
+    } else {
+      logAviso(prefixoZona(zona) + "⚠️ Sonda DS18B20 " + String(zona.sondaTemperatura) + " não encontrada!");
+    }
+  }
+}
 
+// Dispara a conversão em todas as sondas de uma vez (comando sem endereço)
+// e espera a mais lenta; depois cada zona lê a sua pelo endereço.
+void converterTemperaturas() {
+  unsigned long inicio = micros();
+  sensors.requestTemperatures();
+  tempoConversaoSondasUs = micros() - inicio;
+  tempoLeituraSondasUs = 0;
+}
 
-  // Conversão para porcentagem usando as médias aferidas
-  umidadeSolo1 = converterParaPorcentagem(rawSoil1, 3208, 1521);  // Sensor atual
-  umidadeSolo2 = converterParaPorcentagem(rawSoil2, 3716, 1979);  // Sensor S12
-  
-  // Garante que o valor fique entre 0% e 100%
-  if (umidadeSolo1 < 0) umidadeSolo1 = 0;
-  if (umidadeSolo1 > 100) umidadeSolo1 = 100;
-  
+// ---------------------------------------------------------------
+// FUNÇÃO: Realizar Medição e Atualizar Sistema
+// ---------------------------------------------------------------
+// Agendador único de todas as zonas: uma conversão no barramento OneWire
+// para todas as sondas, depois cada zona é lida e enviada.
+// Seção de uma zona na mensagem (ou no painel) do Telegram
+String textoZonaTelegram(const Zona& zona) {
+  String texto = NUM_ZONAS > 1 ? "🌿 " + String(zona.nome) + "\n" : String("");
+#define SENSOR_TELEGRAM(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+  texto += icone " " rotulo ": " + valorTexto(medicaoAtual(zona).campo, casas, unidade) + "\n";
+  SENSORES(SENSOR_TELEGRAM)
+#undef SENSOR_TELEGRAM
+  return texto;
+}
 
-  // Verifica se os dados lidos são válidos
-  if (temperaturaInterna == DEVICE_DISCONNECTED_C || isnan(temperaturaExterna) || isnan(umidadeExterna)) {
-    Serial.println("❌ Erro: Falha na leitura dos sensores!");
-    lcd.clear();
-    lcd.print("Erro sensores!");
-    delay(2000);
-    return;
+// Última medição de todas as zonas, para responder pedidos dentro da janela de frescor
+String textoMedicaoTelegram() {
+  String texto;
+  for (const Zona& zona : zonas) {
+    texto += textoZonaTelegram(zona);
   }
+  return texto + "🕒 Hora: " + String(medicaoAtual(zonas[0]).tempo) + "\n";
+}
 
-  // Atualiza o tempo atual via NTP
-  timeClient.update();
-  String horaAtual = timeClient.getFormattedTime();
+// ---------------------------------------------------------------
+// FUNÇÕES: Coordenador de Medição
+// ---------------------------------------------------------------
 
-  // Armazena a medição no histórico para o gráfico
-  if (indiceMedicao < MAX_MEDICOES) {
-    historico[indiceMedicao].tempo = horaAtual;
-    historico[indiceMedicao].temperaturaInterna = temperaturaInterna;
-    historico[indiceMedicao].temperaturaExterna = temperaturaExterna;
-    historico[indiceMedicao].umidade = umidadeExterna;
-    historico[indiceMedicao].umidadeSolo1 = umidadeSolo1;
-    historico[indiceMedicao].umidadeSolo2 = umidadeSolo2;  // Armazena dados do S12
-    indiceMedicao++;
+// Registra um pedido e devolve o id do trabalho que o atende: o agendado/em andamento,
+// o último concluído (emCache) se tiver menos de janelaFrescorMedicao, ou um novo
+uint32_t pedirMedicao(OrigemPedidoMedicao origem, bool& emCache) {
+  CoordenadorMedicao& c = coordenadorMedicao;
+  uint32_t id;
+  portENTER_CRITICAL(&muxMedicao);
+  c.pedidos++;
+  emCache = false;
+  if (c.pendente != 0) {
+    id = c.pendente;
+    c.compartilhados++;
+  } else if (origem != PEDIDO_PERIODICO && c.concluido != 0 && millis() - c.concluidoEm < janelaFrescorMedicao) {
+    id = c.concluido;
+    emCache = true;
+    c.respondidosCache++;
   } else {
-    for (int i = 1; i < MAX_MEDICOES; i++) {
-      historico[i - 1] = historico[i];
-    }
-    historico[MAX_MEDICOES - 1].tempo = horaAtual;
-    historico[MAX_MEDICOES - 1].temperaturaInterna = temperaturaInterna;
-    historico[MAX_MEDICOES - 1].temperaturaExterna = temperaturaExterna;
-    historico[MAX_MEDICOES - 1].umidade = umidadeExterna;
-    historico[MAX_MEDICOES - 1].umidadeSolo1 = umidadeSolo1;
-    historico[MAX_MEDICOES - 1].umidadeSolo2 = umidadeSolo2;  // Atualização
+    id = c.pendente = ++c.ultimoId;
+    c.forcarTelegram = false;
   }
-  
+  if (!emCache && origem != PEDIDO_PERIODICO) {
+    c.forcarTelegram = true;
+  }
+  portEXIT_CRITICAL(&muxMedicao);
+  return id;
+}
 
-  // ⚠️ Verifica condições de alerta e adiciona mensagens de aviso
-  String alerta = "";
-  if (temperaturaInterna > limiteTemperaturaAlerta) {
-    alerta += "🚨 Alerta: Temperatura alta (" + String(temperaturaInterna, 1) + "°C)\n";
+// Roda no loop() o trabalho pendente. Pedidos feitos durante a leitura e os envios
+// continuam recebendo o mesmo id até ele terminar.
+void executarMedicaoPendente() {
+  CoordenadorMedicao& c = coordenadorMedicao;
+  portENTER_CRITICAL(&muxMedicao);
+  uint32_t id = c.pendente;
+  bool forcar = c.forcarTelegram;
+  c.emAndamento = id != 0;
+  portEXIT_CRITICAL(&muxMedicao);
+  if (id == 0) {
+    return;
   }
-  if (umidadeExterna < 20.0) {
-    alerta += "🚨 Alerta: Umidade baixa (" + String(umidadeExterna, 1) + "%)\n";
+
+  bool medida = realizarMedicao(forcar);
+
+  portENTER_CRITICAL(&muxMedicao);
+  if (medida) {
+    c.concluido = id;
+    c.concluidoEm = millis();
   }
-  if (umidadeSolo1 < limiteUmidadeSoloAlerta) {
-    alerta += "🚨 Alerta: Solo seco! Sensor Atual em " + String(umidadeSolo1, 1) + "%\n";
+  c.resultados[c.proximoResultado] = { id, medida };
+  c.proximoResultado = (c.proximoResultado + 1) % NUM_RESULTADOS_MEDICAO;
+  c.pendente = 0;
+  c.emAndamento = false;
+  c.execucoes++;
+  portEXIT_CRITICAL(&muxMedicao);
+}
+
+// Pedido manual chegou desde que o trabalho em andamento começou (ele se juntou ao
+// trabalho e espera a resposta no Telegram)
+bool pedidoTelegramPendente() {
+  portENTER_CRITICAL(&muxMedicao);
+  bool forcar = coordenadorMedicao.forcarTelegram;
+  portEXIT_CRITICAL(&muxMedicao);
+  return forcar;
+}
+
+// Estado de um trabalho: agendado, em_andamento, concluido, falhou ou desconhecido
+// (id nunca emitido ou antigo demais, fora dos NUM_RESULTADOS_MEDICAO últimos)
+const char* estadoTrabalhoMedicao(uint32_t id) {
+  const CoordenadorMedicao& c = coordenadorMedicao;
+  if (id == 0 || id > c.ultimoId) {
+    return "desconhecido";
   }
-  if (umidadeSolo2 < limiteUmidadeSoloAlerta) {
-    alerta += "🚨 Alerta: Solo seco! Sensor S12 em " + String(umidadeSolo2, 1) + "%\n";
+  if (id == c.pendente) {
+    return c.emAndamento ? "em_andamento" : "agendado";
   }
-  
-
-  // Atualiza o monitor serial com os dados da medição e alertas
-  String mensagemSerial = "🌡️ TI: " + String(temperaturaInterna, 1) + "°C | " +
-                          "🌡️ TE: " + String(temperaturaExterna, 1) + "°C | " +
-                          "💧 UE: " + String(umidadeExterna, 1) + "% | " +
-                          "🌱 Solo 1 (Atual): " + String(umidadeSolo1, 1) + "% | " +
-                          "🌱 Solo 2 (S12): " + String(umidadeSolo2, 1) + "% | " +
-                          "🕒 Hora: " + horaAtual + "\n" + alerta;
-  Serial.println(mensagemSerial);
+  for (const ResultadoTrabalho& resultado : c.resultados) {
+    if (resultado.id == id) {
+      return resultado.medido ? "concluido" : "falhou";
+    }
+  }
+  return "desconhecido";
+}
 
+// GET /medicao?id=N: estado do trabalho devolvido por /realizar-medicao
+void handleEstadoMedicao(AsyncWebServerRequest* request) {
+  uint32_t id = request->hasParam("id") ? request->getParam("id")->value().toInt() : 0;
+  portENTER_CRITICAL(&muxMedicao);
+  const char* estado = estadoTrabalhoMedicao(id);
+  uint32_t concluido = coordenadorMedicao.concluido;
+  unsigned long idadeMs = millis() - coordenadorMedicao.concluidoEm;
+  portEXIT_CRITICAL(&muxMedicao);
+
+  String json = "{\"id\":" + String(id) + ",\"estado\":\"" + estado + "\"";
+  if (strcmp(estado, "concluido") == 0) {
+    // Trabalhos antigos apontam para a medição mais recente
+    json += ",\"medicao\":" + String(concluido) + ",\"idadeMs\":" + String(idadeMs);
+  }
+  request->send(strcmp(estado, "desconhecido") == 0 ? 404 : 200, "application/json", json + "}");
+}
 
-  // Atualiza os dados enviados via Blynk (v0: TI, v1: TE, v2: UE, v4: Hora)
-  conectarBlynk();
-  Blynk.virtualWrite(V0, temperaturaInterna);
-  Blynk.virtualWrite(V1, temperaturaExterna);
-  Blynk.virtualWrite(V2, umidadeExterna);
-  Blynk.virtualWrite(V4, horaAtual);
+// Devolve false quando nenhuma zona pôde ser medida
+bool realizarMedicao(bool forcarEnvioTelegram) {
+  logInfo("\n📡 Iniciando nova medição...");
+  digitalWrite(LED_VERDE, HIGH);
+  digitalWrite(LED_VERMELHO, LOW);
 
-  // Se for para enviar via Telegram (botão pressionado ou tempo decorrido)
-  if (forcarEnvioTelegram || millis() - ultimaExecucao >= intervaloMedicao) {
-      String mensagemTelegram = "🌡️ Temperatura Interna2: " + String(temperaturaInterna, 1) + "°C\n" +
-      "🌡️ Temperatura Externa: " + String(temperaturaExterna, 1) + "°C\n" +
-      "💧 Umidade Externa: " + String(umidadeExterna, 1) + "%\n" +
-      "🌱 Umidade do Solo (Sensor Atual): " + String(umidadeSolo1, 1) + "%\n" +
-      "🌱 Umidade do Solo (S12): " + String(umidadeSolo2, 1) + "%\n" +
-      "🕒 Hora: " + horaAtual + "\n" +
-      alerta;
-
-    enviarMensagemTelegram(mensagemTelegram, false, "MarkdownV2");
-    ultimaExecucao = millis();
+  // Uma única conversão no barramento OneWire para as sondas de todas as zonas
+  converterTemperaturas();
+
+  // Carimbo de tempo da amostra (relógio do sistema, sem acesso à rede), comum a todas as zonas
+  CarimboTempo carimbo;
+  gerarCarimboTempo(carimbo);
+  const char* horaAtual = carimbo.hora;
+
+  bool enviarTelegram = forcarEnvioTelegram || millis() - ultimaExecucao >= intervaloMedicao;
+  String mensagemTelegram = "";
+  String alertasTelegram = "";
+  String avisosSaude = "";
+  bool algumaZonaMedida = false;
+  bool zonaMedida[NUM_ZONAS] = {};
+
+  for (Zona& zona : zonas) {
+    String alerta;
+    if (!medirZona(zona, carimbo, alerta, avisosSaude)) {
+      continue;
+    }
+    algumaZonaMedida = true;
+    zonaMedida[&zona - zonas] = true;
+    const Medicao& nova = medicaoAtual(zona);
+
+    // Atualiza o monitor serial com os dados da medição e alertas
+    String mensagemSerial = prefixoZona(zona);
+#define SENSOR_SERIAL(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+    mensagemSerial += icone " " rotuloLcd ": " + valorTexto(nova.campo, casas, unidade) + " | ";
+    SENSORES(SENSOR_SERIAL)
+#undef SENSOR_SERIAL
+    mensagemSerial += "🕒 Hora: " + String(horaAtual) + "\n" + alerta;
+    logInfo(mensagemSerial);
+
+    // Uma seção por zona na mensagem do Telegram (montada sempre: um pedido manual
+    // ainda pode chegar durante os envios e pedir o resultado)
+    mensagemTelegram += textoZonaTelegram(zona) + alerta;
+    if (alerta.length() > 0) {
+      alertasTelegram += (NUM_ZONAS > 1 ? "🌿 " + String(zona.nome) + "\n" : String("")) + alerta;
+    }
   }
 
-  // Envia os dados para o Google Sheets via requisição HTTP POST
-  if (WiFi.status() == WL_CONNECTED) {
-    HTTPClient http;
-    http.begin(scriptURL); 
-    http.addHeader("Content-Type", "application/json");
-
-    // Monta o JSON com os campos esperados pelo Apps Script:
-    // "temperatura" (TE), "umidade" (UE) e "temperatura_sensor" (TI)
-    String postData = "{\"temperatura\":" + String(temperaturaExterna) +
-                      ",\"umidade\":" + String(umidadeExterna) +
-                      ",\"temperatura_sensor\":" + String(temperaturaInterna) +
-                      ",\"umidade_solo\":" + String(umidadeSolo1) + "}";
-    int httpResponseCode = http.POST(postData);
-    if (httpResponseCode > 0) {
-      Serial.println("🌐 Dados enviados ao Google Sheets com sucesso!");
-      //String response = http.getString(); // (Opcional) para debug
-    } else {
-      Serial.print("❌ Erro ao enviar ao Google Sheets. Código HTTP: ");
-      Serial.println(httpResponseCode);
+  // Todas as zonas já estão publicadas: o LCD mostra a amostra nova antes dos envios,
+  // que levam segundos (TLS); o dashboard já a recebe em /dados
+  if (algumaZonaMedida) {
+    atualizarLCD();
+  }
+  for (int i = 0; i < NUM_ZONAS; i++) {
+    if (zonaMedida[i]) {
+      enviarMedicaoZona(zonas[i], carimbo);
     }
-    http.end();
-  } else {
-    Serial.println("⚠️ Wi-Fi desconectado. Não foi possível enviar ao Google Sheets.");
   }
 
-  enviarDadosFirestore(temperaturaInterna, temperaturaExterna, umidadeExterna, umidadeSolo1, umidadeSolo2, horaAtual);
+  // Falhas e recuperações de sensores vão na hora, fora do intervalo do Telegram
+  if (avisosSaude.length() > 0) {
+    enviarMensagemTelegram(avisosSaude, false, "MarkdownV2");
+  }
+
+  if (!algumaZonaMedida) {
+    // Nenhum sensor respondeu: nova tentativa em 30 s sem bloquear o loop
+    ultimaExecucao = millis() - intervaloMedicao + intervaloNovaTentativaMedicao;
+    digitalWrite(LED_VERDE, LOW);
+    digitalWrite(LED_VERMELHO, HIGH);
+    return false;
+  }
 
-  // Atualiza as variáveis globais com os últimos valores medidos
-  ultimaTempInterna = temperaturaInterna;
-  ultimaTempExterna = temperaturaExterna;
-  ultimaUmidadeExterna = umidadeExterna;
-  ultimaHoraMedicao = horaAtual;
-  ultimaUmidadeSolo = umidadeSolo1;
+  // Pedidos manuais que se juntaram a este trabalho durante a leitura e os envios
+  // (ex.: /medir enquanto a medição periódica rodava) também recebem a resposta
+  if (!forcarEnvioTelegram && pedidoTelegramPendente()) {
+    forcarEnvioTelegram = true;
+    enviarTelegram = true;
+  }
 
+  // Se for para enviar via Telegram (botão pressionado ou tempo decorrido)
+  if (enviarTelegram) {
+    if (painelTelegram) {
+      // Edita o painel fixado; mensagem nova (com notificação) só quando há alerta
+      atualizarPainelTelegram(mensagemTelegram, horaAtual, forcarEnvioTelegram);
+      if (alertasTelegram.length() > 0) {
+        enviarMensagemTelegram(alertasTelegram, false, "MarkdownV2");
+        contarBytesUplink(UPLINK_TELEGRAM, alertasTelegram.length());
+      }
+    } else {
+      mensagemTelegram += "🕒 Hora: " + String(horaAtual) + "\n";
+      enviarMensagemTelegram(mensagemTelegram, false, "MarkdownV2");
+      contarBytesUplink(UPLINK_TELEGRAM, mensagemTelegram.length());
+    }
+    ultimaExecucao = millis();
+  }
 
   // Desliga os LEDs indicativos
   digitalWrite(LED_VERDE, LOW);
   digitalWrite(LED_VERMELHO, HIGH);
+  return true;
 }
 
 
+// O LCD (HD44780) não tem UTF-8: troca "°" pelo caractere 0xDF da ROM do display
+String unidadeLcd(const char* unidade) {
+  String texto(unidade);
+  texto.replace("°", "\xDF");
+  return texto;
+}
+
 void atualizarLCD() {
   lcd.clear();
-  switch (telaAtual) {
-    case 0:
-      // Tela de Temperaturas
-      lcd.setCursor(0, 0);
-      lcd.print("Temp Int: " + String(ultimaTempInterna, 1) + "C");
-      lcd.setCursor(0, 1);
-      lcd.print("Temp Ext: " + String(ultimaTempExterna, 1) + "C");
-      lcd.setCursor(0, 2);
-      lcd.print("Hora: " + ultimaHoraMedicao.substring(0, 5));
-      break;
-
-    case 1:
-      // Tela de Umidades
-      lcd.setCursor(0, 0);
-      lcd.print("Umid Ext: " + String(ultimaUmidadeExterna, 1) + "%");
-      lcd.setCursor(0, 1);
-      lcd.print("Solo 1: " + String(umidadeSolo1, 1) + "%");
-      lcd.setCursor(0, 2);
-      lcd.print("Solo S12: " + String(umidadeSolo2, 1) + "%");
-      break;
+  const Zona& zona = zonas[telaAtual / telasPorZonaLcd];
+  int tela = telaAtual % telasPorZonaLcd;
+
+  if (tela < telasSensoresLcd) {
+    // Telas de sensores: três por tela, na ordem do registro
+    int indice = 0;
+#define SENSOR_LCD(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, ...) \
+    if (indice / 3 == tela) { \
+      lcd.setCursor(0, indice % 3); \
+      lcd.print(rotuloLcd ": " + valorTexto(medicaoAtual(zona).campo, casas, unidadeLcd(unidade))); \
+    } \
+    indice++;
+    SENSORES(SENSOR_LCD)
+#undef SENSOR_LCD
+    if (NUM_ZONAS > 1) {
+      lcd.setCursor(0, 3);
+      lcd.print(zona.nome);
+    }
+    return;
+  }
 
-    case 2:
-      // Tela de Status e Alertas
-      lcd.setCursor(0, 0);
-      lcd.print("Bomba: " + String(bombaLigada ? "Ligada" : "Desligada"));
-      lcd.setCursor(0, 1);
-      if (ultimaTempInterna > limiteTemperaturaAlerta) {
-        lcd.print("! Alerta: Temp Alta");
-      } else if (umidadeSolo1 < limiteUmidadeSoloAlerta || umidadeSolo2 < limiteUmidadeSoloAlerta) {
-        lcd.print("! Alerta: Solo Seco");
-      } else {
-        lcd.print("Status: Normal");
-      }
-      break;
+  // Tela de Status e Alertas
+  lcd.setCursor(0, 0);
+  lcd.print("Bomba: " + String(bombaEstaLigada(zona) ? "Ligada" : (zona.irrigacao.estado == BOMBA_REPOUSO ? "Repouso" : "Desligada")));
+  lcd.setCursor(0, 1);
+  // Primeiro canal em alerta, na ordem do registro
+  const Medicao& atual = medicaoAtual(zona);
+  const char* alertaAtual = nullptr;
+#define SENSOR_ALERTA_LCD(campo, chave, rotulo, rotuloLcd, icone, unidade, casas, leitura, escala, deslocamento, \
+                          pinoBlynk, chaveSheets, chaveDados, classeHa, cor, minimo, maximo, travamento, barramento, papel) \
+  if (alertaAtual == nullptr && alertaSensor(zona, papel, atual.campo)) alertaAtual = alertaLcd(papel);
+  SENSORES(SENSOR_ALERTA_LCD)
+#undef SENSOR_ALERTA_LCD
+  if (alertaAtual != nullptr) {
+    lcd.print(String("! Alerta: ") + alertaAtual);
+  } else {
+    lcd.print("Status: Normal");
   }
+  lcd.setCursor(0, 2);
+  lcd.print("Irrigacao: " + String(zona.irrigacao.modoAutomatico ? "Auto" : "Manual"));
+  lcd.setCursor(0, 3);
+  String hora = String(medicaoAtual(zona).tempo).substring(0, 5);
+  lcd.print(NUM_ZONAS > 1 ? String(zona.nome) + " " + hora : "Hora: " + hora);
 }
 
 
@@ -1057,90 +4912,210 @@ void atualizarLCD() {
 // ---------------------------------------------------------------
 // FUNÇÃO: Enviar Mensagem via Telegram
 // ---------------------------------------------------------------
-void enviarMensagemTelegram(const String& mensagemIn, bool usarMarkdown, String modo) {
-  // Reinicia o cliente seguro e ignora a verificação de certificado SSL
-  telegramClient.reset(new WiFiClientSecure);
-  telegramClient->setInsecure();
-
-  // Cria uma cópia da mensagem para manipulação
-  String msgProcessada = mensagemIn;
-
-  // Se o modo for MarkdownV2, realiza o escape de caracteres especiais
-  if (modo == "MarkdownV2") {
-    msgProcessada.replace("_",  "\\_");
-    msgProcessada.replace("*",  "\\*");
-    msgProcessada.replace("[",  "\\[");
-    msgProcessada.replace("]",  "\\]");
-    msgProcessada.replace("(",  "\\(");
-    msgProcessada.replace(")",  "\\)");
-    msgProcessada.replace("~",  "\\~");
-    msgProcessada.replace("`",  "\\`");
-    msgProcessada.replace(">",  "\\>");
-    msgProcessada.replace("#",  "\\#");
-    msgProcessada.replace("+",  "\\+");
-    msgProcessada.replace("-",  "\\-");
-    msgProcessada.replace("=",  "\\=");
-    msgProcessada.replace("|",  "\\|");
-    msgProcessada.replace("{",  "\\{");
-    msgProcessada.replace("}",  "\\}");
-    msgProcessada.replace(".",  "\\.");
-    msgProcessada.replace("!",  "\\!");
-  }
-  // Se o modo for HTML, codifica a mensagem via URL encoding
-  else if (modo == "HTML") {
-    msgProcessada = urlEncode(msgProcessada);
-  }
-
-  // Tenta conectar ao servidor da API do Telegram (HTTPS na porta 443)
-  if (telegramClient->connect("api.telegram.org", 443)) {
-    Serial.println("📡 Enviando mensagem ao Telegram...");
-
-    // Define o parse mode conforme o modo desejado
-    String parseMode = "";
-    if (modo == "MarkdownV2") {
-      parseMode = "&parse_mode=MarkdownV2";
-    } else if (modo == "HTML") {
-      parseMode = "&parse_mode=HTML";
-    }
-
-    // Monta a URL final para o GET request
-    String url = "/bot" + String(botToken) +
-                 "/sendMessage?chat_id=" + String(chatID) +
-                 "&text=" + msgProcessada + parseMode;
-    
-    // Se não for HTML, substitui espaços e quebras de linha para compatibilidade
-    if (modo != "HTML") {
-      url.replace(" ", "%20");
-      url.replace("\n", "%0A");
+
+// Conta uma chamada à Bot API; a cada hora a janela vira "chamadasTelegramHora"
+void contarChamadaTelegram(TipoChamadaTelegram tipo) {
+  if (millis() - inicioJanelaTelegram >= janelaChamadasTelegram) {
+    memcpy(chamadasTelegramHora, chamadasTelegramJanela, sizeof(chamadasTelegramHora));
+    memset(chamadasTelegramJanela, 0, sizeof(chamadasTelegramJanela));
+    inicioJanelaTelegram = millis();
+  }
+  chamadasTelegram[tipo]++;
+  chamadasTelegramJanela[tipo]++;
+}
+
+// Chamada à Bot API por POST com corpo JSON escrito direto no socket: inicioCorpo,
+// o texto (medido para o Content-Length e depois escapado/codificado em blocos) e
+// fimCorpo, sem montar a requisição inteira na memória. Só o começo da resposta fica
+// em resposta. Devolve o status HTTP, ou -1 sem conexão.
+int chamarApiTelegram(TipoChamadaTelegram tipo, const char* metodo, const String& inicioCorpo,
+                      const String& texto, bool escaparMarkdown, const String& fimCorpo,
+                      char* resposta, size_t capacidade) {
+  size_t tamanhoCorpo = inicioCorpo.length() + codificarJson<EscritaTls>(texto.c_str(), nullptr, escaparMarkdown) + fimCorpo.length();
+  resposta[0] = '\0';
+  contarChamadaTelegram(tipo);
+
+  for (int tentativa = 0; tentativa < 2; tentativa++) {
+    bool reaproveitada;
+    SlotTls* slot = conectarTls(HOST_TELEGRAM, reaproveitada);
+    if (slot == nullptr) {
+      return -1;
+    }
+    EscritaTls escrita = { &slot->cliente };
+    escreverTls(escrita, String("POST /bot") + botToken + "/" + metodo + " HTTP/1.1\r\n"
+                         "Host: api.telegram.org\r\n"
+                         "Content-Type: application/json\r\n"
+                         "Content-Length: " + String(tamanhoCorpo) + "\r\n"
+                         "Connection: keep-alive\r\n\r\n");
+    escreverTls(escrita, inicioCorpo);
+    codificarJson(texto.c_str(), &escrita, escaparMarkdown);
+    escreverTls(escrita, fimCorpo);
+    descarregarTls(escrita);
+
+    bool manterConexao = false;
+    int status = escrita.falhou ? -1 : lerRespostaHttp(slot->cliente, resposta, capacidade, manterConexao);
+    slot->ultimoUso = millis();
+    if (!manterConexao) {
+      slot->cliente.stop();
+    }
+    if (status < 0 && reaproveitada) {
+      continue;  // O servidor tinha fechado a conexão ociosa: novo handshake
     }
+    return status;
+  }
+  return -1;
+}
+
+// Fim do corpo JSON das mensagens: fecha "text" e acrescenta o parse_mode
+String fimCorpoTelegram(const String& modo) {
+  String fimCorpo = "\"";
+  if (modo == "MarkdownV2" || modo == "HTML") {
+    fimCorpo += ",\"parse_mode\":\"" + modo + "\"";
+  }
+  return fimCorpo + "}";
+}
 
-    // Envia a requisição HTTP
-    telegramClient->print(String("GET ") + url + " HTTP/1.1\r\n" +
-                            "Host: api.telegram.org\r\n" +
-                            "Connection: close\r\n\r\n");
+void enviarMensagemTelegram(const String& mensagemIn, bool usarMarkdown, String modo) {
+  logInfo("📡 Enviando mensagem ao Telegram...");
+
+  // Só o status e o começo do corpo (descrição do erro) são guardados
+  char resposta[160];
+  int status = chamarApiTelegram(TG_ENVIO, "sendMessage", "{\"chat_id\":\"" + String(chatID) + "\",\"text\":\"",
+                                 mensagemIn, modo == "MarkdownV2", fimCorpoTelegram(modo), resposta, sizeof(resposta));
+  if (status == HTTP_CODE_OK) {
+    logInfo("✅ Mensagem enviada!");
+  } else if (status > 0) {
+    logErro("❌ Erro ao enviar mensagem! Verifique o formato ou tokens inválidos.");
+    logDebug("📩 Telegram " + String(status) + ": " + resposta);
+  } else {
+    logErro("❌ Erro ao conectar ao Telegram.");
+  }
+}
 
-    Serial.println("✅ Mensagem enviada! Aguardando resposta...");
+// ---------------------------------------------------------------
+// FUNÇÕES: Painel Fixado no Telegram
+// ---------------------------------------------------------------
 
-    // Aguarda e lê a resposta do Telegram (opcional para debug)
-    String response = "";
-    while (telegramClient->connected() || telegramClient->available()) {
-      if (telegramClient->available()) {
-        response += telegramClient->readStringUntil('\n');
-      }
+// FNV-1a de 32 bits: compara o conteúdo do painel sem guardar o texto anterior
+uint32_t hashTexto(const String& texto) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < texto.length(); i++) {
+    hash = (hash ^ (uint8_t)texto[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Envia o painel como mensagem nova e o fixa no chat (sem notificação)
+bool criarPainelTelegram(const String& texto) {
+  char resposta[160];
+  int status = chamarApiTelegram(TG_ENVIO, "sendMessage", "{\"chat_id\":\"" + String(chatID) + "\",\"disable_notification\":true,\"text\":\"",
+                                 texto, true, fimCorpoTelegram("MarkdownV2"), resposta, sizeof(resposta));
+  const char* id = strstr(resposta, "\"message_id\":");
+  if (status != HTTP_CODE_OK || id == nullptr) {
+    logErro("❌ Erro ao criar o painel no Telegram (código " + String(status) + ").");
+    return false;
+  }
+  idMensagemPainel = atol(id + 13);
+  preferencias.putLong("painel_id", idMensagemPainel);
+
+  status = chamarApiTelegram(TG_OUTRAS, "pinChatMessage", "{\"chat_id\":\"" + String(chatID) + "\",\"message_id\":" +
+                             String(idMensagemPainel) + ",\"disable_notification\":true}", "", false, "", resposta, sizeof(resposta));
+  if (status != HTTP_CODE_OK) {
+    logAviso("⚠️ Painel criado, mas não fixado (código " + String(status) + "). O bot precisa de permissão para fixar mensagens.");
+  } else {
+    logInfo("📌 Painel fixado no Telegram (mensagem " + String(idMensagemPainel) + ").");
+  }
+  return true;
+}
+
+// Edita o painel com a medição atual. Sem mudança nos valores a edição só acontece
+// depois de intervaloMaximoPainel, para o horário mostrar que o sistema está vivo.
+// Se a mensagem foi apagada (ou nunca existiu), cria e fixa outra.
+void atualizarPainelTelegram(const String& conteudo, const char* hora, bool forcar) {
+  uint32_t hash = hashTexto(conteudo);
+  if (!forcar && idMensagemPainel != 0 && hash == hashPainel &&
+      millis() - ultimaAtualizacaoPainel < intervaloMaximoPainel) {
+    atualizacoesPainelPuladas++;
+    logDebug("📌 Painel sem mudança, edição pulada.");
+    return;
+  }
+
+  String texto = "📌 GrowMonitor\n\n" + conteudo + "🕒 Atualizado: " + String(hora) + "\n";
+  bool atualizado = false;
+  if (idMensagemPainel != 0) {
+    char resposta[160];
+    int status = chamarApiTelegram(TG_EDICAO, "editMessageText", "{\"chat_id\":\"" + String(chatID) + "\",\"message_id\":" +
+                                   String(idMensagemPainel) + ",\"text\":\"", texto, true, fimCorpoTelegram("MarkdownV2"),
+                                   resposta, sizeof(resposta));
+    if (status <= 0) {
+      logErro("❌ Erro ao conectar ao Telegram.");
+      return;  // Tenta de novo na próxima medição, sem criar outro painel
     }
-    // Se houver erro na resposta, imprime aviso
-    if (response.indexOf("\"ok\":false") != -1) {
-      Serial.println("❌ Erro ao enviar mensagem! Verifique o formato ou tokens inválidos.");
+    // "message is not modified" também conta: o painel já mostra este texto
+    atualizado = status == HTTP_CODE_OK || strstr(resposta, "message is not modified") != nullptr;
+    if (!atualizado) {
+      logAviso("⚠️ Painel do Telegram não pôde ser editado (código " + String(status) + "). Criando outro.");
+      logDebug("📩 Telegram " + String(status) + ": " + resposta);
     }
-    telegramClient->stop();
-  } else {
-    Serial.println("❌ Erro ao conectar ao Telegram.");
   }
+  if (!atualizado) {
+    atualizado = criarPainelTelegram(texto);
+  }
+  if (atualizado) {
+    hashPainel = hash;
+    ultimaAtualizacaoPainel = millis();
+    contarBytesUplink(UPLINK_TELEGRAM, texto.length());
+  }
+}
+
+// Liga/desliga o painel; ao desligar, as medições voltam a ir como mensagens novas
+void definirPainelTelegram(bool habilitado) {
+  painelTelegram = habilitado;
+  preferencias.putBool("painel", habilitado);
+  hashPainel = 0;
+  logInfo(String("✅ Painel do Telegram ") + (habilitado ? "HABILITADO" : "DESABILITADO"));
 }
 
 // ---------------------------------------------------------------
 // FUNÇÃO: Verificar Mensagens e Comandos do Telegram
 // ---------------------------------------------------------------
+
+// Procura "/comando" na resposta do getUpdates e separa os argumentos.
+// Os comandos de zona aceitam "zN" como primeiro argumento (ex.: "/bombaligar z2 30");
+// sem ele vale a primeira zona. zona fica nullptr se o número não existir.
+bool argumentosComando(const String& resposta, const char* comando, Zona*& zona, String& argumentos) {
+  String prefixo = String("\"text\":\"") + comando;
+  int pos = resposta.indexOf(prefixo);
+  while (pos != -1) {
+    int inicio = pos + prefixo.length();
+    char proximo = resposta.charAt(inicio);
+    if (proximo == '"' || proximo == ' ') {
+      int fim = resposta.indexOf('"', inicio);
+      argumentos = (proximo == ' ' && fim != -1) ? resposta.substring(inicio + 1, fim) : String("");
+      argumentos.trim();
+      zona = &zonas[0];
+      if (argumentos.length() >= 2 && (argumentos[0] == 'z' || argumentos[0] == 'Z') && isdigit(argumentos[1])) {
+        int espaco = argumentos.indexOf(' ');
+        zona = buscarZona(argumentos.substring(1, espaco == -1 ? argumentos.length() : espaco).toInt());
+        argumentos = (espaco == -1) ? String("") : argumentos.substring(espaco + 1);
+        argumentos.trim();
+      }
+      return true;
+    }
+    pos = resposta.indexOf(prefixo, inicio);
+  }
+  return false;
+}
+
+// Avisa pelo Telegram quando o comando citou uma zona inexistente
+bool zonaValidaComando(const Zona* zona) {
+  if (zona == nullptr) {
+    enviarMensagemTelegram("❌ Zona inexistente! Use z1 a z" + String(NUM_ZONAS) + ".", false, "MarkdownV2");
+    return false;
+  }
+  return true;
+}
+
 void verificarMensagensTelegram() {
   // Verifica se o intervalo mínimo para checagem passou
   if (millis() - ultimaVerificacaoTelegram < intervaloVerificacaoTelegram) {
@@ -1148,34 +5123,28 @@ void verificarMensagensTelegram() {
   }
   ultimaVerificacaoTelegram = millis();
 
-  // Reinicia o cliente seguro
-  telegramClient.reset(new WiFiClientSecure);
-  telegramClient->setInsecure();
-
-  // Tenta conectar ao Telegram
-  if (!telegramClient->connect("api.telegram.org", 443)) {
-    Serial.println("❌ Erro ao conectar ao Telegram.");
-    return;
-  }
-
-  Serial.println("\n🔍 Verificando mensagens no Telegram...");
+  // Roda a cada poucos segundos: fica no nível de depuração para não encher o log em RAM
+  logDebug("🔍 Verificando mensagens no Telegram...");
 
   // Usa um offset para evitar ler as mesmas mensagens novamente
   static long ultimaMensagemID = 0;
-  String url = "/bot" + String(botToken) + "/getUpdates?offset=" + String(ultimaMensagemID + 1);
-  telegramClient->print(String("GET ") + url + " HTTP/1.1\r\n" +
-                        "Host: api.telegram.org\r\n" +
-                        "Connection: close\r\n\r\n");
-
-  // Lê a resposta completa
-  String resposta = "";
-  while (telegramClient->connected() || telegramClient->available()) {
-    if (telegramClient->available()) {
-      resposta += telegramClient->readStringUntil('\n');
-    }
+  // Uma atualização por vez e só mensagens: a resposta fica pequena e é lida do socket
+  // direto para um buffer fixo (lerRespostaHttp), sem um String do tamanho dela. Uma
+  // mensagem maior que o buffer é cortada, mas o update_id vem no começo e o offset avança.
+  static char respostaPolling[1024];
+  String corpo = "{\"offset\":" + String(ultimaMensagemID + 1) + ",\"limit\":1,\"allowed_updates\":[\"message\"]}";
+  int status = chamarApiTelegram(TG_POLLING, "getUpdates", corpo, "", false, "", respostaPolling, sizeof(respostaPolling));
+  if (status < 0) {
+    logErro("❌ Erro ao conectar ao Telegram.");
+    return;
+  }
+  if (status != 200) {
+    logDebug("⚠️ getUpdates respondeu " + String(status));  // Ex.: 502 passageiro; tenta de novo em 1 s
+    return;
   }
+  String resposta = respostaPolling;
 
-  Serial.println("📩 Resposta recebida do Telegram");
+  logDebug("📩 Resposta recebida do Telegram");
   // (Opcional) Para depuração, descomente a linha abaixo:
   // Serial.println(resposta);
 
@@ -1189,117 +5158,239 @@ void verificarMensagensTelegram() {
 
   // Processa os comandos recebidos
   if (resposta.indexOf("\"text\":\"/medir\"") >= 0) {
-    Serial.println("✅ Comando /medir detectado! Iniciando medição...");
-    realizarMedicao(true);
+    logInfo("✅ Comando /medir detectado!");
+    bool emCache;
+    uint32_t id = pedirMedicao(PEDIDO_TELEGRAM, emCache);
+    if (emCache) {
+      unsigned long idadeS = (millis() - coordenadorMedicao.concluidoEm) / 1000;
+      enviarMensagemTelegram("♻️ Medição de " + String(idadeS) + " s atrás:\n\n" + textoMedicaoTelegram(), false, "MarkdownV2");
+    } else {
+      logInfo("📡 Medição #" + String(id) + " agendada.");
+    }
   }
   else if (resposta.indexOf("\"text\":\"/start\"") >= 0) {
-    Serial.println("✅ Comando /start detectado!");
+    logInfo("✅ Comando /start detectado!");
     enviarMensagemTelegram("Oi! Eu sou o GrowMonitor Bot.\nUse /help para ver os comandos possíveis.", false, "MarkdownV2");
   }
   else if (resposta.indexOf("\"text\":\"/help\"") >= 0) {
-    Serial.println("✅ Comando /help detectado!");
+    logInfo("✅ Comando /help detectado!");
     String mensagem = "📖 Lista de Comandos:\n\n"
                       "🌡️ Monitoramento:\n"
                       "• /medir - Faz uma medição agora\n"
-                      "• /grafico - Exibe gráfico das últimas medições\n\n"
+                      "• /grafico - Exibe gráfico das últimas medições\n"
+                      "• /saude - Saúde de cada sensor (0 a 100%)\n\n"
                       "⚙️ Configurações:\n"
                       "• /alertatemperatura XX - Altera alerta de temperatura (exemplo: /alertatemperatura 28)\n"
                       "• /alertaumidade XX - Altera alerta de umidade do solo (exemplo: /alertaumidade 35)\n\n"
                       "💧 Bomba d'água:\n"
-                      "• /bombaligar - Liga a bomba\n"
-                      "• /bombadesligar - Desliga a bomba\n\n"
+                      "• /bombaligar - Liga a bomba (até o tempo máximo)\n"
+                      "• /bombaligar XX - Liga a bomba por XX segundos\n"
+                      "• /bombadesligar - Desliga a bomba\n"
+                      "• /irrigacaoauto on|off - Liga/desliga a irrigação automática\n"
+                      "• /irrigacaolimites XX YY - Liga abaixo de XX% e desliga em YY%\n\n"
+                      "🌿 Zonas:\n"
+                      "• Comandos de bomba, irrigação, alertas e gráfico aceitam zN antes dos valores "
+                      "(exemplo: /bombaligar z2 30). Sem zN vale a zona 1.\n\n"
+                      "🔋 Energia:\n"
+                      "• /energia - Mostra o modo de energia e o consumo estimado\n"
+                      "• /energia normal|modem|leve|profundo - Altera o modo (leve e profundo dormem entre as medições)\n\n"
                       "📌 Outros:\n"
+                      "• /blynk on|off - Habilita/desabilita o Blynk\n"
+                      "• /painel on|off - Medições num painel fixado (editado a cada medição) ou em mensagens novas\n"
+                      "• /log - Últimas mensagens de diagnóstico (/log 30, /log nivel debug|info|aviso|erro, /log arquivo on|off)\n"
                       "• /start - Exibe informações do bot\n"
                       "• /help - Exibe esta lista\n";
     enviarMensagemTelegram(mensagem, false, "MarkdownV2");
   }
+  else if (resposta.indexOf("\"text\":\"/saude\"") >= 0) {
+    logInfo("✅ Comando /saude detectado!");
+    String mensagem = "🩺 Saúde dos sensores:\n";
+    for (const Zona& zona : zonas) {
+      if (NUM_ZONAS > 1) {
+        mensagem += "\n🌿 " + String(zona.nome) + "\n";
+      }
+      int indice = 0;
+#define SENSOR_SAUDE_TELEGRAM(campo, chave, rotulo, rotuloLcd, icone, ...) \
+      mensagem += icone " " rotulo ": " + String(pontuacaoSaude(zona.saude[indice])) + "% (" + \
+                  descreverFalha(zona.saude[indice].falha) + ")\n"; \
+      indice++;
+      SENSORES(SENSOR_SAUDE_TELEGRAM)
+#undef SENSOR_SAUDE_TELEGRAM
+    }
+    enviarMensagemTelegram(mensagem, false, "MarkdownV2");
+  }
 
 
   // Comandos para controle da bomba
-  if (resposta.indexOf("\"text\":\"/bombaligar\"") >= 0) {
-    Serial.println("✅ Comando /bombaligar detectado!");
-    ligarBomba();
+  Zona* zona = nullptr;
+  String argumentos;
+  if (argumentosComando(resposta, "/bombaligar", zona, argumentos) && zonaValidaComando(zona)) {
+    // Sem argumento liga até o tempo máximo; /bombaligar SEGUNDOS faz um acionamento temporizado
+    long segundos = argumentos.length() > 0 ? argumentos.toInt() : 0;
+    logInfo("✅ Comando /bombaligar " + argumentos + " detectado!");
+    if (argumentos.length() == 0) {
+      ligarBomba(*zona, ORIGEM_MANUAL);
+    } else if (segundos > 0) {
+      ligarBomba(*zona, ORIGEM_MANUAL, (uint32_t)segundos * 1000);
+    } else {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /bombaligar SEGUNDOS (exemplo: /bombaligar 30)", false, "MarkdownV2");
+    }
   }
-  else if (resposta.indexOf("\"text\":\"/bombadesligar\"") >= 0) {
-    Serial.println("✅ Comando /bombadesligar detectado!");
-    desligarBomba();
+  else if (argumentosComando(resposta, "/bombadesligar", zona, argumentos) && zonaValidaComando(zona)) {
+    logInfo("✅ Comando /bombadesligar detectado!");
+    desligarBomba(*zona, "📱 Desligada pelo Telegram.");
   }
 
-  // Comando para gerar gráfico
-  if (resposta.indexOf("\"text\":\"/grafico\"") >= 0) {
-    Serial.println("✅ Comando /grafico detectado! Gerando gráfico...");
-    enviarGraficoTelegram();
+  // Comandos da irrigação automática
+  if (argumentosComando(resposta, "/irrigacaoauto", zona, argumentos) && zonaValidaComando(zona)) {
+    logInfo("✅ Comando /irrigacaoauto " + argumentos + " detectado!");
+    if (argumentos == "on" || argumentos == "off") {
+      definirModoIrrigacao(*zona, argumentos == "on");
+    } else {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /irrigacaoauto on|off", false, "MarkdownV2");
+    }
   }
 
-  // Comando para alterar o limite de temperatura do alerta
-  int alertaPos = resposta.indexOf("\"text\":\"/alertatemperatura ");
-  if (alertaPos != -1) {
-    int start = alertaPos + 26;
-    int end = resposta.indexOf("\"", start);
-    if (end != -1) {
-      String novoLimite = resposta.substring(start, end);
-      float novoValor = novoLimite.toFloat();
-      if (novoValor > 0) {
-        limiteTemperaturaAlerta = novoValor;
-        Serial.println("✅ Novo limite de temperatura para alerta: " + String(limiteTemperaturaAlerta) + "°C");
-        enviarMensagemTelegram("⚙️ Novo limite de temperatura configurado: " + String(limiteTemperaturaAlerta) + "°C", false, "MarkdownV2");
-      } else {
-        Serial.println("❌ Comando inválido. Use /alertatemperatura XX (onde XX é um número)");
-        enviarMensagemTelegram("❌ Comando inválido! Use: /alertatemperatura XX (exemplo: /alertatemperatura 30)", false, "MarkdownV2");
+  // Log de diagnóstico: /log [N], /log nivel X, /log arquivo on|off
+  if (argumentosComando(resposta, "/log", zona, argumentos)) {
+    logInfo("✅ Comando /log " + argumentos + " detectado!");
+    NivelLog nivel;
+    if (argumentos.startsWith("nivel ") && interpretarNivelLog(argumentos.substring(6), nivel)) {
+      definirNivelLog(nivel);
+      enviarMensagemTelegram(String("📝 Nível do log alterado para ") + nomesNivelLog[nivel] + ".", false, "MarkdownV2");
+    } else if (argumentos == "arquivo on" || argumentos == "arquivo off") {
+      definirLogEmArquivo(argumentos == "arquivo on");
+      enviarMensagemTelegram(String("📝 Cópia do log em flash ") + (logEmArquivo ? "habilitada" : "desabilitada") + ".", false, "MarkdownV2");
+    } else if (argumentos.length() == 0 || argumentos.toInt() > 0) {
+      enviarMensagemTelegram(textoUltimasEntradasLog(argumentos.length() > 0 ? argumentos.toInt() : entradasLogTelegram), false, "MarkdownV2");
+    } else {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /log N, /log nivel debug|info|aviso|erro ou /log arquivo on|off", false, "MarkdownV2");
+    }
+  }
+
+  // Painel fixado: sem argumento mostra o estado e as chamadas à API na última hora
+  if (argumentosComando(resposta, "/painel", zona, argumentos)) {
+    logInfo("✅ Comando /painel " + argumentos + " detectado!");
+    if (argumentos == "on" || argumentos == "off") {
+      definirPainelTelegram(argumentos == "on");
+      enviarMensagemTelegram(String("📌 Painel fixado ") + (painelTelegram ? "habilitado. Ele aparece na próxima medição (ou use /medir)." : "desabilitado."), false, "MarkdownV2");
+    } else if (argumentos.length() == 0) {
+      String mensagem = String("📌 Painel fixado: ") + (painelTelegram ? "habilitado" : "desabilitado") + "\n"
+                        "✏️ Edições puladas (sem mudança): " + String(atualizacoesPainelPuladas) + "\n"
+                        "📊 Chamadas à API na última hora:\n";
+      for (int tipo = 0; tipo < NUM_TIPOS_CHAMADA_TELEGRAM; tipo++) {
+        mensagem += String("• ") + nomesChamadaTelegram[tipo] + ": " + String(chamadasTelegramHora[tipo]) + "\n";
       }
+      enviarMensagemTelegram(mensagem, false, "MarkdownV2");
+    } else {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /painel on|off", false, "MarkdownV2");
     }
   }
 
-// 🛠️ Correção: Alterar o limite de umidade do solo via Telegram
-int alertaUmidadePos = resposta.indexOf("\"text\":\"/alertaumidade ");
-if (alertaUmidadePos != -1) {
-    int start = alertaUmidadePos + 23; // Ajuste conforme o comando
-    int end = resposta.indexOf("\"", start);
-    if (end != -1) {
-        String novoLimite = resposta.substring(start, end);
-        float novoValor = novoLimite.toFloat();
-        if (novoValor >= 0 && novoValor <= 100) {
-            limiteUmidadeSoloAlerta = novoValor;
-            Serial.println("✅ Novo limite de umidade do solo: " + String(limiteUmidadeSoloAlerta) + "%");
-            enviarMensagemTelegram("⚙️ Novo limite de umidade configurado: " + String(limiteUmidadeSoloAlerta) + "%", false, "MarkdownV2");
-        } else {
-            Serial.println("❌ Valor inválido para umidade do solo!");
-            enviarMensagemTelegram("❌ Comando inválido! Use: /alertaumidade XX (exemplo: /alertaumidade 30)", false, "MarkdownV2");
-        }
+  // Modo de energia: sem argumento mostra o consumo estimado
+  if (argumentosComando(resposta, "/energia", zona, argumentos)) {
+    ModoEnergia modo;
+    if (argumentos.length() == 0) {
+      enviarMensagemTelegram("🔋 Modo de energia: " + String(nomeModoEnergia(modoEnergia)) + "\n"
+                             "⏱️ Ciclo de trabalho: " + String(cicloTrabalhoEnergia(), 1) + "%\n"
+                             "⚡ Corrente média estimada: " + String(correnteMediaEstimadaMa(), 1) + " mA\n"
+                             "😴 Despertares: " + String(estadoRtc.despertares) + "\n"
+                             "📤 Fila de envio: " + String(estadoRtc.tamanhoFila), false, "MarkdownV2");
+    } else if (interpretarModoEnergia(argumentos, modo)) {
+      definirModoEnergia(modo);
+      enviarMensagemTelegram("🔋 Modo de energia alterado para " + String(nomeModoEnergia(modo)) + ".", false, "MarkdownV2");
+    } else {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /energia normal|modem|leve|profundo", false, "MarkdownV2");
     }
-}
+  }
+
+  // Habilita/desabilita o Blynk em tempo de execução
+  if (resposta.indexOf("\"text\":\"/blynk on\"") >= 0) {
+    logInfo("✅ Comando /blynk on detectado!");
+    definirBlynkHabilitado(true);
+  }
+  else if (resposta.indexOf("\"text\":\"/blynk off\"") >= 0) {
+    logInfo("✅ Comando /blynk off detectado!");
+    definirBlynkHabilitado(false);
+  }
+
+  if (argumentosComando(resposta, "/irrigacaolimites", zona, argumentos) && zonaValidaComando(zona)) {
+    int espaco = argumentos.indexOf(" ");
+    bool valido = false;
+    if (espaco != -1) {
+      float ligar = argumentos.substring(0, espaco).toFloat();
+      float desligar = argumentos.substring(espaco + 1).toFloat();
+      valido = definirLimitesIrrigacao(*zona, ligar, desligar);
+    }
+    if (!valido) {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /irrigacaolimites LIGA DESLIGA (exemplo: /irrigacaolimites 30 45)", false, "MarkdownV2");
+    }
+  }
 
-  else {
-    Serial.println("⚠️ Nenhum comando reconhecido.");
+  // Comando para gerar gráfico
+  if (argumentosComando(resposta, "/grafico", zona, argumentos) && zonaValidaComando(zona)) {
+    logInfo("✅ Comando /grafico detectado! Gerando gráfico...");
+    enviarGraficoTelegram(*zona);
+  }
+
+  // Comando para alterar o limite de temperatura do alerta
+  if (argumentosComando(resposta, "/alertatemperatura", zona, argumentos) && zonaValidaComando(zona)) {
+    if (!definirLimiteTemperatura(*zona, argumentos.toFloat())) {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /alertatemperatura XX (exemplo: /alertatemperatura 30)", false, "MarkdownV2");
+    }
   }
 
-  telegramClient->stop();
+  // Altera o limite de umidade do solo via Telegram
+  if (argumentosComando(resposta, "/alertaumidade", zona, argumentos) && zonaValidaComando(zona)) {
+    if (!definirLimiteUmidadeSolo(*zona, argumentos.length() > 0 ? argumentos.toFloat() : NAN)) {
+      enviarMensagemTelegram("❌ Comando inválido! Use: /alertaumidade XX (exemplo: /alertaumidade 30)", false, "MarkdownV2");
+    }
+  }
 }
 
 // ---------------------------------------------------------------
 // FUNÇÃO PRINCIPAL LOOP
 // ---------------------------------------------------------------
 void loop() {
+  unsigned long inicioLoopUs = micros();
+
   ArduinoOTA.handle();  // Prioridade máxima para OTA
 
-  server.handleClient();  // Atende o servidor web
+  gerenciarWiFi();      // Registra conexões e reconecta com backoff após uma queda
 
-  Blynk.run();            // Executa o loop do Blynk
-  conectarBlynk();        // Garante que o Blynk esteja conectado
+  processarComandosWeb();  // Executa os comandos recebidos pelo servidor web assíncrono
+
+  executarBlynk();        // Executa o Blynk e reconecta com backoff quando necessário
+
+  executarMqtt();         // Mantém a sessão MQTT e processa comandos
+
+  esvaziarFilaEnvio();    // Envia as medições que ficaram na fila enquanto não havia Wi-Fi
+
+  gravarLogArquivo();     // Cópia do log em flash, em lotes (se habilitada com /log arquivo on)
 
   verificarMensagensTelegram();  // Verifica comandos do Telegram
 
+  encerrarConexoesOciosasTls();  // Fecha as conexões HTTPS paradas (memória do mbedTLS)
+
+  atualizarIrrigacao();          // Máquina de estados da bomba (tempo máximo, repouso, histerese)
+
   // Alternância automática das telas no LCD
   if (millis() - ultimaTrocaTela >= intervaloTrocaTela) {
-    telaAtual = (telaAtual + 1) % 3;
+    telaAtual = (telaAtual + 1) % (telasPorZonaLcd * NUM_ZONAS);
     atualizarLCD();
     ultimaTrocaTela = millis();
   }
 
-  // Realiza medição se o intervalo passou
+  // Medição periódica e as pedidas (Telegram, Blynk V8, web) passam pelo coordenador
   if (millis() - ultimaExecucao >= intervaloMedicao) {
-    realizarMedicao();
+    bool emCache;
+    pedirMedicao(PEDIDO_PERIODICO, emCache);
   }
+  executarMedicaoPendente();
+
+  contabilizarLoop(micros() - inicioLoopUs);
+
+  gerenciarEnergia();     // Nos modos de economia, ocioso ou dormindo até a próxima medição
 
   yield();  // Libera o watchdog
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+// Teste e benchmark no PC dos codificadores de uma passada (include/codificacao.h).
+// Rode com: pio test -e native -v   (o -v mostra a tabela do benchmark)
+//
+// O benchmark compara, por mensagem do Telegram, o caminho atual (codificarJson:
+// uma passada para o Content-Length e outra escrevendo em blocos de 256 bytes, como
+// no socket TLS) com um modelo do caminho antigo (18 String::replace() do
+// MarkdownV2 e mais 2 na URL inteira), e o codificarUrl() do link do QuickChart com
+// o urlEncode() antigo (um String temporário por byte). O modelo usa std::string no
+// lugar do String do Arduino; o que importa é o número de passadas e de alocações.
+
+#include <unity.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "codificacao.h"
+
+// --- Contagem de alocações do heap (cada uma é fragmentação em potencial no ESP32) ---
+static unsigned long alocacoes = 0;
+
+void* operator new(size_t tamanho) {
+  alocacoes++;
+  void* p = malloc(tamanho ? tamanho : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void* operator new[](size_t tamanho) { return operator new(tamanho); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// --- Escrita em blocos, como EscritaTls no firmware (o "socket" só soma os bytes) ---
+const size_t tamanhoBloco = 256;
+struct EscritaMemoria {
+  char bloco[tamanhoBloco];
+  size_t usado;
+  size_t enviados;
+};
+
+void escreverTls(EscritaMemoria& escrita, const char* dados, size_t tamanho) {
+  while (tamanho > 0) {
+    size_t n = tamanho < tamanhoBloco - escrita.usado ? tamanho : tamanhoBloco - escrita.usado;
+    memcpy(escrita.bloco + escrita.usado, dados, n);
+    escrita.usado += n;
+    dados += n;
+    tamanho -= n;
+    if (escrita.usado == tamanhoBloco) {
+      escrita.enviados += escrita.usado;
+      escrita.usado = 0;
+    }
+  }
+}
+
+// Saída de um texto curto (cabe em um bloco), conferindo o tamanho medido
+std::string json(const char* texto, bool escaparMarkdown) {
+  EscritaMemoria escrita = {};
+  size_t tamanho = codificarJson<EscritaMemoria>(texto, nullptr, escaparMarkdown);
+  codificarJson(texto, &escrita, escaparMarkdown);
+  TEST_ASSERT_EQUAL(0, escrita.enviados);
+  TEST_ASSERT_EQUAL(tamanho, escrita.usado);
+  return std::string(escrita.bloco, escrita.usado);
+}
+
+std::string url(const char* texto, bool escaparMarkdown) {
+  char destino[256];
+  size_t tamanho = codificarUrl(texto, destino, sizeof(destino), escaparMarkdown);
+  TEST_ASSERT_EQUAL(tamanho, strlen(destino));
+  return destino;
+}
+
+// --- Modelo do caminho antigo (antes do codificador de uma passada) ---
+// Como o String::replace() do Arduino: uma passada para contar as ocorrências e, se
+// o texto cresce, um buffer novo do tamanho exato (o String não reserva folga)
+void substituir(std::string& s, const char* de, const char* para) {
+  size_t tamanhoDe = strlen(de);
+  size_t tamanhoPara = strlen(para);
+  size_t ocorrencias = 0;
+  for (size_t pos = s.find(de); pos != std::string::npos; pos = s.find(de, pos + tamanhoDe)) {
+    ocorrencias++;
+  }
+  if (ocorrencias == 0) {
+    return;
+  }
+  std::string novo;
+  novo.reserve(s.size() + ocorrencias * (tamanhoPara - tamanhoDe));
+  size_t anterior = 0;
+  for (size_t pos = s.find(de); pos != std::string::npos; pos = s.find(de, anterior)) {
+    novo.append(s, anterior, pos - anterior).append(para);
+    anterior = pos + tamanhoDe;
+  }
+  novo.append(s, anterior, std::string::npos);
+  s.swap(novo);
+}
+
+std::string mensagemAntiga(const std::string& mensagem) {
+  static const char* const especiais[] = {"_", "*", "[", "]", "(", ")", "~", "`", ">", "#", "+", "-", "=", "|",
+                                          "{", "}", ".", "!"};
+  std::string processada = mensagem;
+  for (const char* c : especiais) {
+    substituir(processada, c, (std::string("\\") + c).c_str());
+  }
+  std::string u = std::string("https://api.telegram.org/bot123456:ABCDEF/sendMessage?chat_id=987654321&text=") +
+                  processada + "&parse_mode=MarkdownV2";
+  substituir(u, " ", "%20");
+  substituir(u, "\n", "%0A");
+  return u;
+}
+
+std::string urlEncodeAntigo(const std::string& s) {
+  static const char hex[] = "0123456789abcdef";
+  std::string codificado;
+  for (char c : s) {
+    if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      codificado += c;
+    } else {
+      uint8_t b = (uint8_t)c;
+      std::string digitos = b >= 0x10 ? std::string(1, hex[b >> 4]) + hex[b & 0x0F] : std::string(1, hex[b]);
+      codificado += "%" + digitos;  // String((uint8_t)c, HEX): sem zero à esquerda
+    }
+  }
+  return codificado;
+}
+
+// Mensagem típica de medição (registro padrão, uma zona)
+const char* const mensagemMedicao =
+    "📊 Medição realizada!\n\n"
+    "🌡️ Temperatura Interna: 24.5°C\n"
+    "🌡️ Temperatura Externa: 22.1°C\n"
+    "💧 Umidade Externa: 61.0%\n"
+    "🌱 Umidade do Solo (Sensor Atual): 38.2%\n"
+    "🌱 Umidade do Solo (S12): 41.7%\n"
+    "🕒 Hora: 14:35:02\n";
+
+void setUp() {}
+void tearDown() {}
+
+void test_url_hex_com_dois_digitos() {
+  TEST_ASSERT_EQUAL_STRING("%0A%01%20", url("\n\x01 ", false).c_str());
+  TEST_ASSERT_EQUAL_STRING("%C3%A9", url("é", false).c_str());
+  TEST_ASSERT_EQUAL_STRING("aZ09-._~", url("aZ09-._~", false).c_str());
+  TEST_ASSERT_EQUAL_STRING("30%25%26%23", url("30%&#", false).c_str());
+}
+
+void test_url_markdown() {
+  TEST_ASSERT_EQUAL_STRING("a%5C.b%5C%21", url("a.b!", true).c_str());
+  TEST_ASSERT_EQUAL_STRING("%5C%5C", url("\\", true).c_str());  // A própria barra também
+  TEST_ASSERT_EQUAL_STRING("a.b%21", url("a.b!", false).c_str());  // Sem o escape do MarkdownV2
+}
+
+void test_url_corta_sem_quebrar_sequencia() {
+  char destino[5];
+  TEST_ASSERT_EQUAL(8, codificarUrl("ab\n\n", destino, sizeof(destino), false));
+  TEST_ASSERT_EQUAL_STRING("ab", destino);  // "%0A" não cabe inteiro nos 2 bytes restantes
+  TEST_ASSERT_EQUAL(8, codificarUrl("ab\n\n", nullptr, 0, false));
+}
+
+void test_json() {
+  TEST_ASSERT_EQUAL_STRING("a\\\"b\\\\c\\n\\u0001", json("a\"b\\c\n\x01", false).c_str());
+  TEST_ASSERT_EQUAL_STRING("a\\\\.b", json("a.b", true).c_str());
+  TEST_ASSERT_EQUAL_STRING("🌱 38.2%", json("🌱 38.2%", false).c_str());
+}
+
+// Mensagem longa: a escrita em blocos entrega tudo e o tamanho medido bate
+void test_json_em_blocos() {
+  std::string longa;
+  for (int i = 0; i < 40; i++) longa += mensagemMedicao;
+  EscritaMemoria escrita = {};
+  size_t tamanho = codificarJson<EscritaMemoria>(longa.c_str(), nullptr, true);
+  codificarJson(longa.c_str(), &escrita, true);
+  TEST_ASSERT_EQUAL(tamanho, escrita.enviados + escrita.usado);
+  TEST_ASSERT_GREATER_THAN(10 * tamanhoBloco, escrita.enviados);
+}
+
+struct Medida {
+  double nsPorChamada;
+  double alocacoesPorChamada;
+  size_t bytes;
+};
+
+template <typename Funcao>
+Medida medir(int repeticoes, Funcao funcao) {
+  size_t bytes = 0;
+  unsigned long alocacoesAntes = alocacoes;
+  auto inicio = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeticoes; i++) {
+    bytes = funcao();
+  }
+  auto fim = std::chrono::steady_clock::now();
+  Medida m;
+  m.nsPorChamada = std::chrono::duration<double, std::nano>(fim - inicio).count() / repeticoes;
+  m.alocacoesPorChamada = (double)(alocacoes - alocacoesAntes) / repeticoes;
+  m.bytes = bytes;
+  return m;
+}
+
+void imprimir(const char* nome, const Medida& m) {
+  char linha[160];
+  snprintf(linha, sizeof(linha), "%-34s %9.0f ns  %5.1f alocações  %5zu bytes", nome, m.nsPorChamada,
+           m.alocacoesPorChamada, m.bytes);
+  TEST_MESSAGE(linha);
+}
+
+void test_benchmark_mensagem_telegram() {
+  const int repeticoes = 20000;
+  const std::string mensagem = mensagemMedicao;
+  volatile size_t sumidouro = 0;
+
+  Medida antigo = medir(repeticoes, [&]() {
+    std::string u = mensagemAntiga(mensagem);
+    sumidouro += u[u.size() / 2];
+    return u.size();
+  });
+  Medida atual = medir(repeticoes, [&]() {
+    EscritaMemoria escrita = {};
+    size_t tamanho = codificarJson<EscritaMemoria>(mensagemMedicao, nullptr, true);  // Content-Length
+    codificarJson(mensagemMedicao, &escrita, true);
+    sumidouro += escrita.bloco[0];
+    return tamanho;
+  });
+
+  imprimir("Telegram: 18+2 replace() (antigo)", antigo);
+  imprimir("Telegram: codificarJson x2", atual);
+  TEST_ASSERT_EQUAL(0, (long)atual.alocacoesPorChamada);
+  TEST_ASSERT_GREATER_THAN(5, (long)antigo.alocacoesPorChamada);
+  TEST_ASSERT_TRUE(atual.nsPorChamada < antigo.nsPorChamada);
+}
+
+void test_benchmark_link_quickchart() {
+  const int repeticoes = 5000;
+  std::string config = "{\"type\":\"line\",\"data\":{\"labels\":[";
+  for (int i = 0; i < 50; i++) config += std::string(i ? "," : "") + "\"14:" + std::to_string(10 + i % 50) + "\"";
+  config += "],\"datasets\":[{\"label\":\"Temp Int\",\"data\":[";
+  for (int i = 0; i < 50; i++) config += std::string(i ? "," : "") + std::to_string(20 + i % 7) + ".5";
+  config += "]}]}}";
+  volatile size_t sumidouro = 0;
+
+  Medida antigo = medir(repeticoes, [&]() {
+    std::string u = urlEncodeAntigo(config);
+    sumidouro += u[0];
+    return u.size();
+  });
+  Medida atual = medir(repeticoes, [&]() {
+    size_t tamanho = codificarUrl(config.c_str(), nullptr, 0, false);
+    char* buffer = new char[tamanho + 1];  // urlEncode(): um buffer do tamanho exato
+    codificarUrl(config.c_str(), buffer, tamanho + 1, false);
+    sumidouro += buffer[0];
+    delete[] buffer;
+    return tamanho;
+  });
+
+  imprimir("QuickChart: urlEncode (antigo)", antigo);
+  imprimir("QuickChart: codificarUrl x2", atual);
+  TEST_ASSERT_EQUAL(antigo.bytes, atual.bytes);  // Sem bytes < 0x10 a saída tem o mesmo tamanho
+  TEST_ASSERT_TRUE(atual.nsPorChamada < antigo.nsPorChamada);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_url_hex_com_dois_digitos);
+  RUN_TEST(test_url_markdown);
+  RUN_TEST(test_url_corta_sem_quebrar_sequencia);
+  RUN_TEST(test_json);
+  RUN_TEST(test_json_em_blocos);
+  RUN_TEST(test_benchmark_mensagem_telegram);
+  RUN_TEST(test_benchmark_link_quickchart);
+  return UNITY_END();
+}
@@ -0,0 +1,243 @@
+// Teste no PC da máquina de estados da bomba (include/controle_irrigacao.h)
+// contra um modelo simples de solo e bomba. Rode com: pio test -e native
+//
+// O modelo avança em passos de 100 ms (um loop() do firmware) e aplica as ações
+// de decidirIrrigacao() do mesmo jeito que atualizarIrrigacaoZona(); as transições
+// usam as mesmas registrarBombaLigada()/registrarBombaDesligada() de ligarBomba()/
+// desligarBomba(). Aqui só fica o relé do modelo e a contabilidade do teste.
+// O tempo é uint32_t, como o millis() do ESP32, para a volta acontecer no PC.
+
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include "controle_irrigacao.h"
+
+const uint32_t passoMs = 100;                    // Um loop()
+const uint32_t intervaloMedicaoMs = 300000;      // Medição periódica do firmware (5 min)
+
+// Solo de um vaso e a bomba que o rega
+struct ModeloSoloBomba {
+  float umidade;          // Umidade real do solo (%)
+  float vazao;            // Ganho de umidade com a bomba ligada (%/s); 0 = bomba sem água
+  float secagem;          // Perda contínua de umidade (%/s)
+  bool sensorOk;          // false = sensor desconectado (leitura NAN)
+  bool rele;              // Saída do relé
+  float leitura;          // Última umidade lida pelo controle
+  int acionamentos;
+  int desligamentos[ACAO_FIM_REPOUSO + 1];  // Por motivo
+  uint32_t inicioAcionamento;
+  uint32_t maiorAcionamento;                // ms
+  uint32_t menorRepouso;                    // ms entre desligar e religar
+  uint32_t fimUltimoAcionamento;
+  float maiorUmidade;
+  float menorUmidade;
+  float leituraAoLigar;                     // Maior leitura que ligou a bomba
+};
+
+Irrigacao irrigacao;
+ModeloSoloBomba solo;
+uint32_t agora;
+uint32_t ultimaMedicao;
+
+float lerSensor() {
+  return solo.sensorOk ? solo.umidade : NAN;
+}
+
+void iniciar(float umidade, float vazao, float secagem, bool automatico) {
+  irrigacao = Irrigacao();
+  irrigacao.estado = BOMBA_DESLIGADA;
+  irrigacao.origem = ORIGEM_MANUAL;
+  irrigacao.modoAutomatico = automatico;
+  irrigacao.limiteLigar = 30.0;
+  irrigacao.limiteDesligar = 45.0;
+  irrigacao.tempoMaximoLigada = 60000;
+  irrigacao.tempoMinimoDesligada = 600000;
+
+  solo = ModeloSoloBomba();
+  solo.umidade = umidade;
+  solo.vazao = vazao;
+  solo.secagem = secagem;
+  solo.sensorOk = true;
+  solo.leitura = umidade;
+  solo.menorRepouso = 0xFFFFFFFF;
+  solo.maiorUmidade = umidade;
+  solo.menorUmidade = umidade;
+  solo.leituraAoLigar = -1;
+  agora = 1000;
+  ultimaMedicao = agora;
+}
+
+// ligarBomba(): recusa no repouso, registra a transição e liga o relé
+bool ligar(OrigemBomba origem, uint32_t duracaoMs) {
+  if (irrigacao.estado == BOMBA_LIGADA) {
+    return true;
+  }
+  if (irrigacao.estado == BOMBA_REPOUSO) {
+    return false;
+  }
+  if (solo.acionamentos > 0 && agora - solo.fimUltimoAcionamento < solo.menorRepouso) {
+    solo.menorRepouso = agora - solo.fimUltimoAcionamento;
+  }
+  registrarBombaLigada(irrigacao, origem, duracaoMs, agora);
+  solo.rele = true;
+  solo.acionamentos++;
+  solo.inicioAcionamento = agora;
+  return true;
+}
+
+// desligarBomba(): desliga o relé e registra a transição
+void desligar(AcaoIrrigacao motivo) {
+  solo.rele = false;
+  registrarBombaDesligada(irrigacao, motivo, agora);
+  solo.desligamentos[motivo]++;
+  solo.fimUltimoAcionamento = agora;
+  if (agora - solo.inicioAcionamento > solo.maiorAcionamento) {
+    solo.maiorAcionamento = agora - solo.inicioAcionamento;
+  }
+}
+
+// Um loop() do firmware seguido de 100 ms de física
+void passo() {
+  if (agora - ultimaMedicao >= intervaloMedicaoMs) {
+    ultimaMedicao = agora;
+    solo.leitura = lerSensor();  // realizarMedicao()
+  }
+  bool soloLido = leituraSoloDevida(irrigacao, agora);
+  if (soloLido) {
+    irrigacao.ultimaLeituraSolo = agora;
+    solo.leitura = lerSensor();
+  }
+
+  AcaoIrrigacao acao = decidirIrrigacao(irrigacao, agora, soloLido, true, solo.leitura);
+  switch (acao) {
+    case ACAO_LIGAR:
+      if (solo.leitura > solo.leituraAoLigar) solo.leituraAoLigar = solo.leitura;
+      ligar(ORIGEM_AUTOMATICA, 0);
+      break;
+    case ACAO_DESLIGAR_ALVO:
+    case ACAO_DESLIGAR_SEM_LEITURA:
+    case ACAO_DESLIGAR_TEMPO:
+      desligar(acao);
+      break;
+    case ACAO_FIM_REPOUSO:
+      registrarFimRepouso(irrigacao);
+      break;
+    case ACAO_NENHUMA:
+      break;
+  }
+
+  float dt = passoMs / 1000.0;
+  solo.umidade += (solo.rele ? solo.vazao : 0) * dt - solo.secagem * dt;
+  if (solo.umidade > 100) solo.umidade = 100;
+  if (solo.umidade < 0) solo.umidade = 0;
+  if (solo.umidade > solo.maiorUmidade) solo.maiorUmidade = solo.umidade;
+  if (solo.umidade < solo.menorUmidade) solo.menorUmidade = solo.umidade;
+  agora += passoMs;
+}
+
+void simular(uint32_t duracaoMs) {
+  for (uint32_t t = 0; t < duracaoMs; t += passoMs) {
+    passo();
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Solo secando: liga abaixo de 30%, para no alvo de 45% sem passar muito dele
+void test_histerese_para_no_alvo() {
+  iniciar(40.0, 0.5, 0.002, true);
+  simular(12UL * 3600 * 1000);
+
+  TEST_ASSERT_GREATER_THAN(1, solo.acionamentos);
+  TEST_ASSERT_EQUAL(solo.acionamentos, solo.desligamentos[ACAO_DESLIGAR_ALVO] + (solo.rele ? 1 : 0));
+  TEST_ASSERT_EQUAL(0, solo.desligamentos[ACAO_DESLIGAR_TEMPO]);
+  TEST_ASSERT_TRUE(solo.leituraAoLigar < 30.0);
+  // Leitura a cada 2 s com a bomba ligada: passa do alvo no máximo 2 s de vazão
+  TEST_ASSERT_TRUE(solo.maiorUmidade <= 45.0 + 0.5 * 2.1);
+  // Medição a cada 5 min com a bomba parada: cai no máximo 5 min de secagem abaixo do limite
+  TEST_ASSERT_TRUE(solo.menorUmidade >= 30.0 - 0.002 * 300 - 0.01);
+}
+
+// Bomba sem água: o solo nunca chega ao alvo, então vale o tempo máximo e o repouso mínimo
+void test_tempo_maximo_e_repouso_minimo() {
+  iniciar(20.0, 0.0, 0.0, true);
+  simular(3600UL * 1000);
+
+  TEST_ASSERT_EQUAL(0, solo.desligamentos[ACAO_DESLIGAR_ALVO]);
+  TEST_ASSERT_TRUE(solo.maiorAcionamento <= irrigacao.tempoMaximoLigada);
+  TEST_ASSERT_TRUE(solo.maiorAcionamento >= irrigacao.tempoMaximoLigada - passoMs);
+  TEST_ASSERT_TRUE(solo.menorRepouso >= irrigacao.tempoMinimoDesligada);
+  // 60 s ligada + 600 s de repouso: 6 ciclos em uma hora
+  TEST_ASSERT_EQUAL(6, solo.acionamentos);
+}
+
+// Sensor desconectado com a bomba ligada: desliga na próxima leitura rápida
+void test_sensor_sem_leitura_desliga() {
+  iniciar(25.0, 0.5, 0.0, true);
+  simular(1000);
+  TEST_ASSERT_TRUE(solo.rele);
+
+  solo.sensorOk = false;
+  uint32_t inicio = agora;
+  while (solo.rele && agora - inicio < 10000) {
+    passo();
+  }
+  TEST_ASSERT_FALSE(solo.rele);
+  TEST_ASSERT_EQUAL(1, solo.desligamentos[ACAO_DESLIGAR_SEM_LEITURA]);
+  TEST_ASSERT_EQUAL(ACAO_DESLIGAR_SEM_LEITURA, irrigacao.motivoDesligamento);
+  TEST_ASSERT_TRUE(agora - inicio <= intervaloLeituraSoloIrrigando + passoMs);
+
+  // Sem leitura válida a bomba não volta a ligar
+  simular(3600UL * 1000);
+  TEST_ASSERT_EQUAL(1, solo.acionamentos);
+}
+
+// Modo manual: solo seco não liga a bomba sozinho
+void test_manual_nao_liga_sozinho() {
+  iniciar(10.0, 0.5, 0.0, false);
+  simular(3600UL * 1000);
+  TEST_ASSERT_EQUAL(0, solo.acionamentos);
+}
+
+// Acionamento manual: respeita a duração pedida, limitada ao tempo máximo, e ignora o alvo
+void test_acionamento_manual() {
+  iniciar(50.0, 0.5, 0.0, false);
+  TEST_ASSERT_TRUE(ligar(ORIGEM_MANUAL, 10000));
+  simular(30000);
+  TEST_ASSERT_FALSE(solo.rele);
+  TEST_ASSERT_EQUAL(1, solo.desligamentos[ACAO_DESLIGAR_TEMPO]);
+  TEST_ASSERT_TRUE(solo.maiorAcionamento >= 10000 && solo.maiorAcionamento <= 10000 + passoMs);
+
+  // Em repouso o pedido é recusado, como em ligarBomba()
+  TEST_ASSERT_FALSE(ligar(ORIGEM_MANUAL, 10000));
+  TEST_ASSERT_EQUAL_UINT32(irrigacao.tempoMinimoDesligada - 20000, repousoRestante(irrigacao, agora));
+  simular(irrigacao.tempoMinimoDesligada);
+  TEST_ASSERT_TRUE(ligar(ORIGEM_MANUAL, 3600000));
+  TEST_ASSERT_EQUAL_UINT32(irrigacao.tempoMaximoLigada, irrigacao.duracaoProgramada);
+  simular(120000);
+  TEST_ASSERT_TRUE(solo.maiorAcionamento <= irrigacao.tempoMaximoLigada);
+}
+
+// millis() dá a volta (a cada ~49 dias no ESP32): as contas de tempo não podem quebrar
+void test_volta_do_millis() {
+  iniciar(20.0, 0.0, 0.0, true);
+  agora = UINT32_MAX - 30000 + 1;  // Liga 30 s antes da volta
+  ultimaMedicao = agora;
+  simular(3600UL * 1000);
+  TEST_ASSERT_TRUE(agora < 3600UL * 1000);  // O relógio do teste deu a volta em 32 bits
+  TEST_ASSERT_TRUE(solo.maiorAcionamento <= irrigacao.tempoMaximoLigada);
+  TEST_ASSERT_TRUE(solo.menorRepouso >= irrigacao.tempoMinimoDesligada);
+  TEST_ASSERT_EQUAL(6, solo.acionamentos);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_histerese_para_no_alvo);
+  RUN_TEST(test_tempo_maximo_e_repouso_minimo);
+  RUN_TEST(test_sensor_sem_leitura_desliga);
+  RUN_TEST(test_manual_nao_liga_sozinho);
+  RUN_TEST(test_acionamento_manual);
+  RUN_TEST(test_volta_do_millis);
+  return UNITY_END();
+}
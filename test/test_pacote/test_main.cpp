@@ -0,0 +1,67 @@
+// Teste no PC do pacote binário de ingestão (include/pacote_amostra.h).
+// Rode com: pio test -e native
+//
+// Codifica duas amostras como o firmware (preencherPacoteAmostra) e confere byte a
+// byte com test/dados/pacote_amostra_v1.bin, o mesmo arquivo que
+// tools/test_ingest_growmonitor.py decodifica com tools/ingest_growmonitor.py.
+// Se o layout mudar, os dois lados quebram juntos.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "pacote_amostra.h"
+
+// Registro padrão do firmware: ti, te, ue, s1, s2, todos com 1 casa decimal
+const int numeroSensores = 5;
+const int casas = 1;
+typedef PacoteAmostraSensores<numeroSensores> Pacote;
+
+const char* const arquivoPacotes = "test/dados/pacote_amostra_v1.bin";
+
+void codificar(Pacote& pacote, uint8_t zona, uint32_t epoch, const float (&valores)[numeroSensores]) {
+  preencherCabecalhoPacote(pacote, zona, epoch);
+  for (int i = 0; i < numeroSensores; i++) {
+    pacote.valores[i] = valorPontoFixo(valores[i], casas);
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_layout() {
+  TEST_ASSERT_EQUAL(8 + 2 * numeroSensores, sizeof(Pacote));
+}
+
+void test_ponto_fixo() {
+  TEST_ASSERT_EQUAL(245, valorPontoFixo(24.5f, 1));
+  TEST_ASSERT_EQUAL(-32, valorPontoFixo(-3.2f, 1));
+  TEST_ASSERT_EQUAL(VALOR_AUSENTE_PACOTE, valorPontoFixo(NAN, 1));
+  TEST_ASSERT_EQUAL(32767, valorPontoFixo(5000.0f, 1));    // Satura sem virar "ausente"
+  TEST_ASSERT_EQUAL(-32767, valorPontoFixo(-5000.0f, 1));
+  TEST_ASSERT_EQUAL(1234, valorPontoFixo(1234.4f, 0));
+}
+
+void test_bytes_iguais_ao_arquivo_do_decodificador() {
+  Pacote pacotes[2];
+  const float primeira[numeroSensores] = {24.5f, -3.2f, NAN, 33.36f, 5000.0f};
+  const float segunda[numeroSensores] = {0.04f, -5000.0f, 100.0f, 0.0f, 12.34f};
+  codificar(pacotes[0], 1, 1760000000UL, primeira);
+  codificar(pacotes[1], 0, 0, segunda);  // Relógio sem hora
+
+  uint8_t esperado[2 * sizeof(Pacote) + 1];
+  FILE* arquivo = fopen(arquivoPacotes, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(arquivo, arquivoPacotes);
+  size_t lidos = fread(esperado, 1, sizeof(esperado), arquivo);
+  fclose(arquivo);
+  TEST_ASSERT_EQUAL(sizeof(pacotes), lidos);
+  TEST_ASSERT_EQUAL_MEMORY(esperado, pacotes, sizeof(pacotes));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_layout);
+  RUN_TEST(test_ponto_fixo);
+  RUN_TEST(test_bytes_iguais_ao_arquivo_do_decodificador);
+  return UNITY_END();
+}
@@ -0,0 +1,67 @@
+"""Funções comuns dos scripts de benchmark do GrowMonitor (tools/bench_*.py).
+
+Só usa a biblioteca padrão do Python.
+"""
+
+import json
+import math
+import time
+import urllib.error
+import urllib.request
+
+
+def percentil(valores, p):
+    """Percentil p (0 a 100) pelo método do posto mais próximo."""
+    if not valores:
+        return float("nan")
+    ordenados = sorted(valores)
+    posto = max(1, int(math.ceil(p / 100.0 * len(ordenados))))
+    return ordenados[posto - 1]
+
+
+def resumo(valores):
+    """n, mínimo, p50, p90, p99, máximo e média de uma lista de números."""
+    if not valores:
+        return {"n": 0}
+    return {
+        "n": len(valores),
+        "min": min(valores),
+        "p50": percentil(valores, 50),
+        "p90": percentil(valores, 90),
+        "p99": percentil(valores, 99),
+        "max": max(valores),
+        "media": sum(valores) / len(valores),
+    }
+
+
+def formatar_resumo(nome, valores, unidade="ms"):
+    r = resumo(valores)
+    if r["n"] == 0:
+        return "%-28s sem amostras" % nome
+    return "%-28s n=%-5d p50=%8.2f  p90=%8.2f  p99=%8.2f  max=%8.2f %s" % (
+        nome, r["n"], r["p50"], r["p90"], r["p99"], r["max"], unidade)
+
+
+def buscar(url, timeout=30, cabecalhos=None):
+    """GET simples; devolve (status, cabeçalhos, corpo em bytes, segundos)."""
+    requisicao = urllib.request.Request(url, headers=cabecalhos or {})
+    inicio = time.perf_counter()
+    try:
+        with urllib.request.urlopen(requisicao, timeout=timeout) as resposta:
+            corpo = resposta.read()
+            return resposta.status, dict(resposta.headers), corpo, time.perf_counter() - inicio
+    except urllib.error.HTTPError as erro:
+        return erro.code, dict(erro.headers), erro.read(), time.perf_counter() - inicio
+
+
+def ler_metricas(base):
+    """JSON de /metrics do ESP32 (base = "http://192.168.0.50")."""
+    status, _, corpo, _ = buscar(base.rstrip("/") + "/metrics")
+    if status != 200:
+        raise RuntimeError("/metrics respondeu %d" % status)
+    return json.loads(corpo)
+
+
+def diferenca_metricas(antes, depois, chaves):
+    """Variação de contadores de /metrics entre duas leituras."""
+    return {c: depois.get(c, 0) - antes.get(c, 0) for c in chaves}
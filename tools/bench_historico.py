@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Benchmark de /api/historico servindo 10 mil pontos do histórico em flash (LittleFS).
+
+1) gerar: monta uma pasta de dados com o conteúdo de data/ e um
+   /historico_<zona>.bin com N registros sintéticos no layout de RegistroHistorico
+   (uint32 epoch + um float32 por sensor, little-endian), um a cada 5 min
+   terminando agora. Grave no ESP32 com:
+       PLATFORMIO_DATA_DIR=<pasta> pio run -t uploadfs
+   Atenção: o uploadfs substitui a partição LittleFS inteira (o log em flash e os
+   arquivos de histórico existentes são apagados; a NVS não é tocada).
+
+2) consultar: pede o histórico inteiro em CSV e em binário, repetidas vezes, e
+   mede tempo até o primeiro byte, tempo total, kB/s e pontos/s. Confere a
+   contagem e, no binário, se os registros gerados voltaram iguais. Mostra também
+   historicoUltimaConsultaMs/Pontos de /metrics (tempo medido no próprio ESP32).
+
+Uso:
+    python3 tools/bench_historico.py gerar --pontos 10000 --saida /tmp/growmonitor_bench
+    PLATFORMIO_DATA_DIR=/tmp/growmonitor_bench pio run -t uploadfs
+    python3 tools/bench_historico.py consultar http://192.168.0.50 --pontos 10000
+
+Só usa a biblioteca padrão do Python.
+"""
+
+import argparse
+import http.client
+import json
+import math
+import os
+import shutil
+import struct
+import sys
+import time
+import urllib.parse
+
+from bancada import buscar, formatar_resumo, ler_metricas
+
+PASTA_DATA = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "data"))
+CAMPOS_PADRAO = ["ti", "te", "ue", "s1", "s2"]
+INTERVALO_S = 300
+
+
+def esquema(esp):
+    """(campos, ids das zonas) de /api/esquema, ou o registro padrão."""
+    if esp:
+        status, _, corpo, _ = buscar(esp.rstrip("/") + "/api/esquema")
+        if status == 200:
+            dados = json.loads(corpo)
+            return dados["campos"], dados.get("zonas") or ["grow1"]
+    return CAMPOS_PADRAO, ["grow1"]
+
+
+def valor_sintetico(indice, canal):
+    """Valor determinístico do canal na amostra (confere o que volta do ESP32)."""
+    return round(25.0 + 10.0 * math.sin(indice / 50.0 + canal), 1)
+
+
+def registros(pontos, num_campos, fim):
+    formato = struct.Struct("<I%df" % num_campos)
+    inicio = fim - (pontos - 1) * INTERVALO_S
+    for i in range(pontos):
+        yield formato.pack(inicio + i * INTERVALO_S, *[valor_sintetico(i, c) for c in range(num_campos)])
+
+
+def gerar(args):
+    campos, zonas = esquema(args.esp)
+    zona = zonas[args.zona - 1]
+    if os.path.exists(args.saida):
+        shutil.rmtree(args.saida)
+    shutil.copytree(PASTA_DATA, args.saida)
+
+    fim = int(time.time()) // INTERVALO_S * INTERVALO_S
+    destino = os.path.join(args.saida, "historico_%s.bin" % zona)
+    tamanho_registro = 4 + 4 * len(campos)
+    if args.pontos * tamanho_registro > 512 * 1024:
+        sys.exit("❌ %d pontos passam do limite de 512 KB por arquivo (tamanhoMaximoLogHistorico)" % args.pontos)
+    with open(destino, "wb") as arquivo:
+        for registro in registros(args.pontos, len(campos), fim):
+            arquivo.write(registro)
+    print("✅ %s: %d registros de %d bytes (%d kB), %s a %s" % (
+        destino, args.pontos, tamanho_registro, os.path.getsize(destino) // 1024,
+        time.strftime("%d/%m %H:%M", time.localtime(fim - (args.pontos - 1) * INTERVALO_S)),
+        time.strftime("%d/%m %H:%M", time.localtime(fim))))
+    print("Grave com: PLATFORMIO_DATA_DIR=%s pio run -t uploadfs" % args.saida)
+
+
+def baixar(url):
+    """GET medindo o tempo até o primeiro byte e o total; devolve (ttfb_ms, total_ms, corpo)."""
+    partes = urllib.parse.urlsplit(url)
+    conexao = http.client.HTTPConnection(partes.hostname, partes.port or 80, timeout=60)
+    inicio = time.perf_counter()
+    conexao.request("GET", partes.path + "?" + partes.query)
+    resposta = conexao.getresponse()
+    primeiro = resposta.read(1)
+    ttfb = time.perf_counter() - inicio
+    corpo = primeiro + resposta.read()
+    total = time.perf_counter() - inicio
+    conexao.close()
+    if resposta.status != 200:
+        raise RuntimeError("%s respondeu %d" % (url, resposta.status))
+    return ttfb * 1000.0, total * 1000.0, corpo
+
+
+def consultar(args):
+    esp = args.esp.rstrip("/")
+    campos, _ = esquema(esp)
+    tamanho_registro = 4 + 4 * len(campos)
+    falhas = 0
+
+    for formato in ("csv", "bin"):
+        url = "%s/api/historico?zona=%d&from=0&step=0&formato=%s" % (esp, args.zona, formato)
+        ttfbs, totais, taxas, pontos_s, no_esp = [], [], [], [], []
+        for _ in range(args.repeticoes):
+            ttfb, total, corpo = baixar(url)
+            if formato == "bin":
+                pontos = len(corpo) // tamanho_registro
+            else:
+                pontos = max(corpo.count(b"\n") - 1, 0)
+            ttfbs.append(ttfb)
+            totais.append(total)
+            taxas.append(len(corpo) / 1024.0 / (total / 1000.0))
+            pontos_s.append(pontos / (total / 1000.0))
+            metricas = ler_metricas(esp)
+            no_esp.append(metricas.get("historicoUltimaConsultaMs", 0))
+            if pontos < args.pontos:
+                print("⚠️ %s: %d pontos, esperados pelo menos %d" % (formato, pontos, args.pontos))
+                falhas += 1
+            if formato == "bin" and args.conferir:
+                falhas += conferir_binario(corpo, len(campos), args.pontos)
+
+        print("%s: %d pontos, %d kB por consulta" % (formato.upper(), pontos, len(corpo) // 1024))
+        print(formatar_resumo("  até o primeiro byte", ttfbs))
+        print(formatar_resumo("  total", totais))
+        print(formatar_resumo("  medido no ESP32", no_esp))
+        print(formatar_resumo("  vazão", taxas, "kB/s"))
+        print(formatar_resumo("  pontos por segundo", pontos_s, "pts/s"))
+    return 1 if falhas else 0
+
+
+def conferir_binario(corpo, num_campos, pontos):
+    """Os primeiros `pontos` registros são os gerados por `gerar` (mesma ordem e valores)."""
+    formato = struct.Struct("<I%df" % num_campos)
+    anterior = 0
+    for i in range(pontos):
+        registro = formato.unpack_from(corpo, i * formato.size)
+        if registro[0] < anterior:
+            print("⚠️ registro %d fora de ordem" % i)
+            return 1
+        anterior = registro[0]
+        esperado = [valor_sintetico(i, c) for c in range(num_campos)]
+        if any(abs(v - e) > 0.01 for v, e in zip(registro[1:], esperado)):
+            print("⚠️ registro %d diferente do gerado: %r" % (i, registro))
+            return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark de /api/historico com o histórico em flash")
+    parser.add_argument("--zona", type=int, default=1)
+    sub = parser.add_subparsers(dest="comando")
+    sub.required = True
+
+    p_gerar = sub.add_parser("gerar", help="monta a pasta do LittleFS com N pontos sintéticos")
+    p_gerar.add_argument("--pontos", type=int, default=10000)
+    p_gerar.add_argument("--saida", default="growmonitor_bench_data")
+    p_gerar.add_argument("--esp", help="lê campos e zonas de /api/esquema deste ESP32")
+    p_gerar.set_defaults(funcao=gerar)
+
+    p_consultar = sub.add_parser("consultar", help="mede a consulta ao ESP32")
+    p_consultar.add_argument("esp", help="ex.: http://192.168.0.50")
+    p_consultar.add_argument("--pontos", type=int, default=10000, help="pontos esperados no histórico")
+    p_consultar.add_argument("--repeticoes", type=int, default=3)
+    p_consultar.add_argument("--conferir", action="store_true",
+                             help="confere os valores do binário com os gerados por 'gerar'")
+    p_consultar.set_defaults(funcao=consultar)
+
+    args = parser.parse_args()
+    sys.exit(args.funcao(args) or 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Teste de carga do servidor web do GrowMonitor: N clientes de dashboard simultâneos.
+
+Cada cliente faz o que a página faz no navegador, em uma conexão keep-alive própria:
+carrega "/", o favicon e o histórico das últimas 24 h (/api/historico) e depois
+consulta /dados?since=<cursor> a cada --intervalo segundos (5 s na página; 0 = sem
+pausa, para estressar). No fim mostra p50/p90/p99/máximo por rota e no total,
+erros, reconexões e a variação de heap e do loop() em /metrics.
+
+Uso:
+    python3 tools/bench_http.py http://192.168.0.50                  # 10 clientes, 60 s
+    python3 tools/bench_http.py http://192.168.0.50 --clientes 10 --duracao 120 --intervalo 0
+
+Só usa a biblioteca padrão do Python.
+"""
+
+import argparse
+import http.client
+import json
+import sys
+import threading
+import time
+import urllib.parse
+
+from bancada import formatar_resumo, ler_metricas
+
+
+class ClienteDashboard(threading.Thread):
+    def __init__(self, numero, url, args, fim):
+        super().__init__(daemon=True)
+        self.numero = numero
+        partes = urllib.parse.urlsplit(url)
+        self.host = partes.hostname
+        self.porta = partes.port or 80
+        self.args = args
+        self.fim = fim
+        self.conexao = None
+        self.latencias = {}      # rota -> [ms]
+        self.erros = {}          # descrição -> quantidade
+        self.conexoes = 0
+        self.cursor = 0
+
+    def _conectar(self):
+        if self.conexao is None:
+            self.conexao = http.client.HTTPConnection(self.host, self.porta, timeout=self.args.timeout)
+            self.conexoes += 1
+
+    def _erro(self, descricao):
+        self.erros[descricao] = self.erros.get(descricao, 0) + 1
+
+    def pedir(self, rota, caminho):
+        """GET em keep-alive; reconecta se o servidor fechou. Devolve o corpo ou None."""
+        for tentativa in range(2):
+            self._conectar()
+            inicio = time.perf_counter()
+            try:
+                self.conexao.request("GET", caminho, headers={"Accept-Encoding": "gzip"})
+                resposta = self.conexao.getresponse()
+                corpo = resposta.read()
+            except (http.client.HTTPException, OSError) as erro:
+                self.conexao.close()
+                self.conexao = None
+                if tentativa == 0 and isinstance(erro, (http.client.RemoteDisconnected, ConnectionResetError,
+                                                        BrokenPipeError)):
+                    continue  # Conexão keep-alive fechada pelo servidor: tenta em uma nova
+                self._erro("%s: %s" % (rota, type(erro).__name__))
+                return None
+            self.latencias.setdefault(rota, []).append((time.perf_counter() - inicio) * 1000.0)
+            if resposta.getheader("Connection", "").lower() == "close":
+                self.conexao.close()
+                self.conexao = None
+            if resposta.status not in (200, 304):
+                self._erro("%s: HTTP %d" % (rota, resposta.status))
+                return None
+            return corpo
+        return None
+
+    def run(self):
+        zona = self.args.zona
+        # Carga inicial da página
+        self.pedir("/", "/?zona=%d" % zona)
+        self.pedir("/favicon.png", "/favicon.png")
+        agora = int(time.time())
+        self.pedir("/api/historico", "/api/historico?zona=%d&from=%d&step=300" % (zona, agora - 86400))
+
+        # Polling do dashboard
+        while not self.fim.is_set():
+            corpo = self.pedir("/dados", "/dados?zona=%d&since=%d" % (zona, self.cursor))
+            if corpo is not None:
+                try:
+                    self.cursor = json.loads(corpo)["seq"]
+                except (ValueError, KeyError):
+                    self._erro("/dados: JSON inválido")
+            if self.args.intervalo > 0:
+                self.fim.wait(self.args.intervalo)
+        if self.conexao is not None:
+            self.conexao.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Teste de carga do servidor web do GrowMonitor")
+    parser.add_argument("url", help="endereço do ESP32, ex.: http://192.168.0.50")
+    parser.add_argument("--clientes", type=int, default=10)
+    parser.add_argument("--duracao", type=float, default=60, help="segundos de polling")
+    parser.add_argument("--intervalo", type=float, default=5, help="segundos entre consultas a /dados (0 = sem pausa)")
+    parser.add_argument("--zona", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=10)
+    args = parser.parse_args()
+
+    url = args.url.rstrip("/")
+    try:
+        antes = ler_metricas(url)
+    except (OSError, RuntimeError, ValueError):
+        antes = None
+
+    fim = threading.Event()
+    clientes = [ClienteDashboard(i, url, args, fim) for i in range(args.clientes)]
+    inicio = time.perf_counter()
+    for cliente in clientes:
+        cliente.start()
+    time.sleep(args.duracao)
+    fim.set()
+    for cliente in clientes:
+        cliente.join(args.timeout + 1)
+    duracao = time.perf_counter() - inicio
+
+    rotas = {}
+    erros = {}
+    for cliente in clientes:
+        for rota, valores in cliente.latencias.items():
+            rotas.setdefault(rota, []).extend(valores)
+        for descricao, quantidade in cliente.erros.items():
+            erros[descricao] = erros.get(descricao, 0) + quantidade
+    todas = [v for valores in rotas.values() for v in valores]
+    conexoes = sum(c.conexoes for c in clientes)
+
+    print("%d clientes simultâneos, %.0f s, intervalo de %.1f s entre consultas"
+          % (args.clientes, duracao, args.intervalo))
+    for rota in ("/", "/favicon.png", "/api/historico", "/dados"):
+        print(formatar_resumo(rota, rotas.get(rota, [])))
+    print(formatar_resumo("total", todas))
+    print("%-28s %.1f req/s" % ("vazão", len(todas) / duracao))
+    print("%-28s %d (%.1f requisições por conexão)" % ("conexões TCP", conexoes, len(todas) / max(conexoes, 1)))
+    print("%-28s %s" % ("erros", json.dumps(erros, ensure_ascii=False) if erros else "nenhum"))
+
+    if antes is not None:
+        try:
+            depois = ler_metricas(url)
+            for chave in ("heapLivre", "maiorBlocoLivre", "loopMedioUs"):
+                if chave in antes or chave in depois:
+                    print("%-28s %s -> %s" % (chave, antes.get(chave, "?"), depois.get(chave, "?")))
+        except (OSError, RuntimeError, ValueError):
+            pass
+    sys.exit(1 if erros else 0)
+
+
+if __name__ == "__main__":
+    main()
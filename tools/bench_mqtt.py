@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""Benchmark de latência e vazão do MQTT do GrowMonitor contra um mosquitto local.
+
+Dois modos:
+
+  sintetico    Sem ESP32. Um cliente publica payloads com o mesmo formato e tamanho
+               do <base>/<zona>/estado do firmware (QoS 0, retido, como o
+               PubSubClient) e outro assina o tópico. Mede a latência publish ->
+               entrega (p50/p99) e a vazão em mensagens/s e bytes/s, e confere se o
+               último estado fica retido para quem assinar depois.
+
+  dispositivo  Com o ESP32 apontado para o mesmo broker. Pede medições por
+               /realizar-medicao e mede o tempo até o novo estado chegar pelo broker;
+               no fim mostra a variação das métricas mqtt* de /metrics (latência do
+               publish() no próprio ESP32, publicações e bytes).
+
+Uso:
+    mosquitto -v                                   # broker local na porta 1883
+    python3 tools/bench_mqtt.py sintetico --mensagens 5000
+    python3 tools/bench_mqtt.py sintetico --mensagens 600 --taxa 10 --qos 1
+    python3 tools/bench_mqtt.py dispositivo --esp http://192.168.0.50 --medicoes 5
+
+O cliente MQTT 3.1.1 é mínimo e embutido aqui (só a biblioteca padrão do Python).
+"""
+
+import argparse
+import json
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+from bancada import buscar, formatar_resumo, ler_metricas, diferenca_metricas
+
+CAMPOS_PADRAO = ["ti", "te", "ue", "s1", "s2"]
+
+
+def codificar_tamanho(n):
+    saida = bytearray()
+    while True:
+        byte = n % 128
+        n //= 128
+        saida.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(saida)
+
+
+def texto_mqtt(texto):
+    dados = texto.encode("utf-8")
+    return struct.pack(">H", len(dados)) + dados
+
+
+class ClienteMqtt:
+    """Cliente MQTT 3.1.1 mínimo: CONNECT, SUBSCRIBE, PUBLISH (QoS 0/1) e PUBACK."""
+
+    def __init__(self, host, porta, id_cliente, timeout=10):
+        self.sock = socket.create_connection((host, porta), timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.proximo_id = 1
+        corpo = texto_mqtt("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 60) + texto_mqtt(id_cliente)
+        self._enviar(0x10, corpo)
+        tipo, resposta = self.ler_pacote()
+        if tipo & 0xF0 != 0x20 or resposta[1] != 0:
+            raise RuntimeError("CONNACK recusado: %r" % resposta)
+
+    def _enviar(self, cabecalho, corpo):
+        self.sock.sendall(bytes([cabecalho]) + codificar_tamanho(len(corpo)) + corpo)
+
+    def _ler(self, n):
+        dados = bytearray()
+        while len(dados) < n:
+            pedaco = self.sock.recv(n - len(dados))
+            if not pedaco:
+                raise ConnectionError("broker fechou a conexão")
+            dados += pedaco
+        return bytes(dados)
+
+    def ler_pacote(self):
+        cabecalho = self._ler(1)[0]
+        tamanho, multiplicador = 0, 1
+        while True:
+            byte = self._ler(1)[0]
+            tamanho += (byte & 0x7F) * multiplicador
+            multiplicador *= 128
+            if not byte & 0x80:
+                break
+        return cabecalho, self._ler(tamanho) if tamanho else b""
+
+    def _novo_id(self):
+        id_pacote = self.proximo_id
+        self.proximo_id = self.proximo_id % 65535 + 1
+        return id_pacote
+
+    def assinar(self, filtro, qos=0):
+        self._enviar(0x82, struct.pack(">H", self._novo_id()) + texto_mqtt(filtro) + bytes([qos]))
+        while True:
+            tipo, corpo = self.ler_pacote()
+            if tipo & 0xF0 == 0x90:
+                if corpo[-1] == 0x80:
+                    raise RuntimeError("SUBSCRIBE recusado para %s" % filtro)
+                return
+
+    def publicar(self, topico, payload, qos=0, retido=False):
+        corpo = texto_mqtt(topico)
+        if qos:
+            corpo += struct.pack(">H", self._novo_id())
+        self._enviar(0x30 | (qos << 1) | (1 if retido else 0), corpo + payload)
+
+    def receber(self):
+        """Próxima mensagem publicada: (tópico, payload, retida). Confirma QoS 1."""
+        while True:
+            primeiro, corpo = self.ler_pacote()
+            if primeiro & 0xF0 != 0x30:
+                continue
+            qos = (primeiro >> 1) & 3
+            tamanho_topico = struct.unpack_from(">H", corpo)[0]
+            topico = corpo[2:2 + tamanho_topico].decode("utf-8")
+            posicao = 2 + tamanho_topico
+            if qos:
+                id_pacote = corpo[posicao:posicao + 2]
+                posicao += 2
+                self._enviar(0x40, id_pacote)
+            return topico, corpo[posicao:], bool(primeiro & 1)
+
+    def fechar(self):
+        try:
+            self._enviar(0xE0, b"")
+        finally:
+            self.sock.close()
+
+
+def payload_estado(campos, sequencia):
+    """Mesmo formato do publicarEstadoMqtt(); o carimbo "h" (8 caracteres) leva a sequência."""
+    valores = "".join('"%s":%.1f,' % (campo, 20.0 + (sequencia + i) % 500 / 10.0) for i, campo in enumerate(campos))
+    return ('{%s"b":0,"ia":1,"lt":28.0,"lu":35.0,"h":"%08d"}' % (valores, sequencia)).encode()
+
+
+def carregar_campos(esp):
+    if not esp:
+        return CAMPOS_PADRAO
+    status, _, corpo, _ = buscar(esp.rstrip("/") + "/api/esquema")
+    return json.loads(corpo)["campos"] if status == 200 else CAMPOS_PADRAO
+
+
+def sintetico(args):
+    campos = carregar_campos(args.esp)
+    topico = "growmonitor/bench%d/grow1/estado" % os.getpid()
+    assinante = ClienteMqtt(args.host, args.porta, "bench-sub-%d" % os.getpid())
+    assinante.assinar(topico, args.qos)
+    publicador = ClienteMqtt(args.host, args.porta, "bench-pub-%d" % os.getpid())
+
+    enviados = {}
+    latencias = []
+    recebidos = [0]
+
+    def receber():
+        assinante.sock.settimeout(10)
+        while recebidos[0] < args.mensagens:
+            try:
+                _, payload, _ = assinante.receber()
+            except socket.timeout:
+                return
+            sequencia = int(json.loads(payload)["h"])
+            if sequencia in enviados:
+                latencias.append((time.perf_counter() - enviados[sequencia]) * 1000.0)
+                recebidos[0] += 1
+
+    leitor = threading.Thread(target=receber)
+    leitor.start()
+
+    tamanho = len(payload_estado(campos, 0))
+    intervalo = 1.0 / args.taxa if args.taxa > 0 else 0
+    inicio = time.perf_counter()
+    for sequencia in range(args.mensagens):
+        if intervalo:
+            alvo = inicio + sequencia * intervalo
+            espera = alvo - time.perf_counter()
+            if espera > 0:
+                time.sleep(espera)
+        payload = payload_estado(campos, sequencia)
+        enviados[sequencia] = time.perf_counter()
+        publicador.publicar(topico, payload, qos=0, retido=True)
+    leitor.join()
+    duracao = time.perf_counter() - inicio
+
+    print("Broker %s:%d, %d mensagens de %d bytes (QoS 0 retido, assinante QoS %d)"
+          % (args.host, args.porta, args.mensagens, tamanho, args.qos))
+    print(formatar_resumo("latência publish->entrega", latencias))
+    print("%-28s %d/%d" % ("entregues", recebidos[0], args.mensagens))
+    print("%-28s %.0f msg/s, %.1f kB/s" % ("vazão", recebidos[0] / duracao, recebidos[0] * tamanho / duracao / 1024))
+
+    # Estado retido: quem assina depois recebe logo o último snapshot
+    novo = ClienteMqtt(args.host, args.porta, "bench-ret-%d" % os.getpid())
+    inicio_retido = time.perf_counter()
+    novo.assinar(topico, 0)
+    novo.sock.settimeout(5)
+    _, payload, retido = novo.receber()
+    ultimo = int(json.loads(payload)["h"])
+    print("%-28s %s (sequência %d, %.1f ms)" % ("estado retido", "ok" if retido and ultimo == args.mensagens - 1 else "FALHOU",
+                                                ultimo, (time.perf_counter() - inicio_retido) * 1000.0))
+    publicador.publicar(topico, b"", retido=True)  # Limpa o retido do teste
+    for cliente in (novo, publicador, assinante):
+        cliente.fechar()
+    return 0 if recebidos[0] == args.mensagens and retido else 1
+
+
+CHAVES_METRICAS = ["mqttPublicacoes", "mqttFalhas", "mqttBytes"]
+
+
+def dispositivo(args):
+    esp = args.esp.rstrip("/")
+    metricas = ler_metricas(esp)
+    if not metricas.get("mqttConectado"):
+        sys.exit("❌ O ESP32 não está conectado ao broker (mqttConectado=false)")
+
+    cliente = ClienteMqtt(args.host, args.porta, "bench-esp-%d" % os.getpid())
+    cliente.assinar("growmonitor/+/+/estado", 1)
+    cliente.sock.settimeout(2)
+    try:
+        while True:
+            cliente.receber()  # Descarta os retidos
+    except socket.timeout:
+        pass
+
+    latencias = []
+    for i in range(args.medicoes):
+        if i:
+            time.sleep(args.intervalo)
+        inicio = time.perf_counter()
+        status, _, corpo, _ = buscar(esp + "/realizar-medicao")
+        if status not in (200, 202):
+            print("⚠️ /realizar-medicao respondeu %d" % status)
+            continue
+        cliente.sock.settimeout(args.timeout)
+        try:
+            topico, _, _ = cliente.receber()
+        except socket.timeout:
+            print("⚠️ medição %d: nenhum estado em %d s" % (i + 1, args.timeout))
+            continue
+        latencias.append((time.perf_counter() - inicio) * 1000.0)
+        print("medição %d: %s em %.0f ms" % (i + 1, topico, latencias[-1]))
+
+    depois = ler_metricas(esp)
+    variacao = diferenca_metricas(metricas, depois, CHAVES_METRICAS)
+    print(formatar_resumo("pedido -> estado no broker", latencias))
+    print("%-28s %s" % ("variação em /metrics", json.dumps(variacao)))
+    print("%-28s média %d us, maior %d us (desde o boot)" % ("publish() no ESP32", depois.get("mqttLatenciaMediaUs", 0),
+                                                            depois.get("mqttMaiorLatenciaUs", 0)))
+    print("%-28s %.2f" % ("publicações/min", depois.get("mqttPublicacoesPorMin", 0)))
+    cliente.fechar()
+    return 0 if latencias else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark do MQTT do GrowMonitor")
+    parser.add_argument("--host", default="localhost", help="broker MQTT (padrão: localhost)")
+    parser.add_argument("--porta", type=int, default=1883)
+    sub = parser.add_subparsers(dest="modo")
+    sub.required = True
+
+    p_sintetico = sub.add_parser("sintetico", help="payloads do firmware contra o broker, sem ESP32")
+    p_sintetico.add_argument("--mensagens", type=int, default=2000)
+    p_sintetico.add_argument("--taxa", type=float, default=0, help="mensagens/s (0 = o mais rápido possível)")
+    p_sintetico.add_argument("--qos", type=int, choices=(0, 1), default=0, help="QoS do assinante")
+    p_sintetico.add_argument("--esp", help="lê os campos de /api/esquema deste ESP32")
+    p_sintetico.set_defaults(funcao=sintetico)
+
+    p_dispositivo = sub.add_parser("dispositivo", help="mede o ESP32 real pelo broker")
+    p_dispositivo.add_argument("--esp", required=True, help="ex.: http://192.168.0.50")
+    p_dispositivo.add_argument("--medicoes", type=int, default=5)
+    p_dispositivo.add_argument("--intervalo", type=float, default=35,
+                               help="segundos entre pedidos (acima da janela de frescor de 30 s)")
+    p_dispositivo.add_argument("--timeout", type=int, default=60)
+    p_dispositivo.set_defaults(funcao=dispositivo)
+
+    args = parser.parse_args()
+    sys.exit(args.funcao(args))
+
+
+if __name__ == "__main__":
+    main()
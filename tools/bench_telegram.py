@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Chamadas à Bot API do Telegram por hora: mensagens novas (antes) x painel fixado (depois).
+
+Roda o mesmo roteiro de medições nos dois modos do firmware e compara os contadores
+telegramChamadas de /metrics (envio, edicao, polling, outras):
+
+  mensagens  /salvar?painel=0: cada medição vai como uma sendMessage nova
+  painel     /salvar?painel=1: a primeira medição cria e fixa o painel (sendMessage +
+             pinChatMessage); as seguintes o editam com editMessageText, e só alertas
+             viram mensagens novas
+
+Antes dos ciclos, uma medição de aquecimento em cada modo (no painel, a que cria e
+fixa a mensagem) é contada à parte. Cada ciclo pede uma medição por
+/realizar-medicao (pedido manual: a medição vai ao Telegram na hora) e espera ela
+terminar em /medicao?id=N. Os ciclos ficam a
+--intervalo segundos um do outro, acima da janela de 30 s em que o firmware responde
+com a medição anterior. No fim mostra as chamadas por medição e a projeção por hora
+com a medição periódica do firmware (uma a cada 5 min), além do polling medido.
+O modo original é restaurado ao terminar.
+
+Uso:
+    python3 tools/bench_telegram.py http://192.168.0.50
+    python3 tools/bench_telegram.py http://192.168.0.50 --ciclos 12 --intervalo 35
+
+Atenção: manda de verdade as mensagens ao chat configurado no firmware.
+Só usa a biblioteca padrão do Python.
+"""
+
+import argparse
+import json
+import sys
+import time
+
+from bancada import buscar, ler_metricas
+
+TIPOS = ["envio", "edicao", "polling", "outras"]
+MEDICOES_POR_HORA = 3600 / 300  # intervaloMedicao do firmware (5 min)
+
+
+def definir_modo(esp, painel):
+    status, _, _, _ = buscar("%s/salvar?painel=%d" % (esp, 1 if painel else 0))
+    if status != 200:
+        sys.exit("❌ /salvar respondeu %d" % status)
+    # O comando é executado pelo loop() do ESP32: espera /metrics refletir
+    for _ in range(20):
+        if ler_metricas(esp).get("telegramPainel") == painel:
+            return
+        time.sleep(0.5)
+    sys.exit("❌ O ESP32 não trocou o modo do painel (telegramPainel em /metrics)")
+
+
+def medir(esp, timeout):
+    """Pede uma medição e espera o trabalho terminar; devolve o estado final."""
+    status, _, corpo, _ = buscar(esp + "/realizar-medicao")
+    if status not in (200, 202):
+        return "HTTP %d" % status
+    trabalho = json.loads(corpo)
+    limite = time.time() + timeout
+    while trabalho.get("estado") in ("agendado", "em_andamento") and time.time() < limite:
+        time.sleep(1)
+        _, _, corpo, _ = buscar("%s/medicao?id=%d" % (esp, trabalho["id"]))
+        trabalho = json.loads(corpo)
+    return trabalho.get("estado", "?")
+
+
+def diferenca(antes, depois):
+    return {t: depois["telegramChamadas"].get(t, 0) - antes["telegramChamadas"].get(t, 0) for t in TIPOS}
+
+
+def rodar_modo(esp, painel, args):
+    definir_modo(esp, painel)
+    # Uma medição de aquecimento, contada à parte: no modo painel é a que cria e fixa
+    # a mensagem; depois dela os dois modos ficam em regime
+    inicial = ler_metricas(esp)
+    medir(esp, args.timeout)
+    time.sleep(args.intervalo)
+    antes = ler_metricas(esp)
+    inicio = time.time()
+    estados = []
+    for ciclo in range(args.ciclos):
+        if ciclo:
+            espera = inicio + ciclo * args.intervalo - time.time()
+            if espera > 0:
+                time.sleep(espera)
+        estados.append(medir(esp, args.timeout))
+        print("  %s: medição %d/%d %s" % ("painel" if painel else "mensagens", ciclo + 1, args.ciclos, estados[-1]))
+    depois = ler_metricas(esp)
+    duracao = time.time() - inicio
+
+    return {
+        "aquecimento": diferenca(inicial, antes),
+        "chamadas": diferenca(antes, depois),
+        "duracao": duracao,
+        "concluidas": estados.count("concluido"),
+        "pulos": depois.get("telegramPainelPulos", 0) - antes.get("telegramPainelPulos", 0),
+    }
+
+
+def por_medicao(resultado, tipo):
+    return resultado["chamadas"][tipo] / float(max(resultado["concluidas"], 1))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Chamadas ao Telegram: mensagens novas x painel fixado")
+    parser.add_argument("esp", help="endereço do ESP32, ex.: http://192.168.0.50")
+    parser.add_argument("--ciclos", type=int, default=10, help="medições em cada modo")
+    parser.add_argument("--intervalo", type=float, default=35, help="segundos entre medições (acima de 30)")
+    parser.add_argument("--timeout", type=float, default=60, help="espera máxima por medição (s)")
+    args = parser.parse_args()
+
+    esp = args.esp.rstrip("/")
+    original = ler_metricas(esp).get("telegramPainel")
+    if original is None:
+        sys.exit("❌ /metrics sem telegramPainel: firmware sem o painel do Telegram")
+
+    try:
+        resultados = {
+            "mensagens": rodar_modo(esp, False, args),
+            "painel": rodar_modo(esp, True, args),
+        }
+    finally:
+        definir_modo(esp, original)
+
+    print()
+    print("%-22s %12s %12s" % ("por medição", "mensagens", "painel"))
+    for tipo in ("envio", "edicao", "outras"):
+        print("%-22s %12.2f %12.2f" % (tipo, por_medicao(resultados["mensagens"], tipo),
+                                       por_medicao(resultados["painel"], tipo)))
+    print("%-22s %12s %12d" % ("edições puladas", "-", resultados["painel"]["pulos"]))
+    aquecimento = {m: resultados[m]["aquecimento"] for m in resultados}
+    print("%-22s %12d %12d  (envio %d, outras %d no painel: criar e fixar)" % (
+        "primeira medição", sum(aquecimento["mensagens"][t] for t in ("envio", "edicao", "outras")),
+        sum(aquecimento["painel"][t] for t in ("envio", "edicao", "outras")),
+        aquecimento["painel"]["envio"], aquecimento["painel"]["outras"]))
+
+    print()
+    print("projeção por hora em regime (%d medições/h + polling medido)" % MEDICOES_POR_HORA)
+    totais = {}
+    for modo, r in resultados.items():
+        envios = sum(por_medicao(r, t) for t in ("envio", "edicao", "outras")) * MEDICOES_POR_HORA
+        polling = r["chamadas"]["polling"] / r["duracao"] * 3600
+        totais[modo] = envios
+        print("%-22s %7.0f de medição + %5.0f de polling = %6.0f chamadas/h"
+              % (modo, envios, polling, envios + polling))
+    if totais["mensagens"] > 0:
+        # Cada edição também é uma chamada: a economia de chamadas vem das edições puladas
+        print("%-22s %+.0f%% nas chamadas de medição por hora"
+              % ("variação", 100.0 * (totais["painel"] / totais["mensagens"] - 1)))
+    print("mensagens novas no chat por hora: %.0f -> %.0f" % (
+        por_medicao(resultados["mensagens"], "envio") * MEDICOES_POR_HORA,
+        por_medicao(resultados["painel"], "envio") * MEDICOES_POR_HORA))
+
+    falhas = sum(args.ciclos - r["concluidas"] for r in resultados.values())
+    sys.exit(1 if falhas else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Receptor e decodificador do pacote binário de amostras do GrowMonitor.
+
+Layout (versão 1, little-endian), igual a PacoteAmostraSensores em include/pacote_amostra.h:
+    uint8  versao
+    uint8  numSensores
+    uint8  zona          índice da zona no firmware (0 = primeira)
+    uint8  reservado
+    uint32 epoch         segundos UTC (0 = relógio sem hora)
+    int16  valores[numSensores]   valor x 10^casas; -32768 = sensor com falha
+
+Os nomes e casas decimais dos campos vêm de /api/esquema do próprio ESP32
+(opção --esquema); sem ela vale o registro padrão (ti, te, ue, s1, s2).
+
+Uso:
+    python3 ingest_growmonitor.py servir --porta 8090 --csv medicoes.csv
+    python3 ingest_growmonitor.py decodificar pacote.bin
+Teste contra pacotes do firmware: tools/test_ingest_growmonitor.py.
+Só usa a biblioteca padrão do Python.
+"""
+
+import argparse
+import csv
+import json
+import os
+import struct
+import sys
+import urllib.request
+from datetime import datetime, timezone
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+VERSAO_PACOTE = 1
+VALOR_AUSENTE = -32768
+CABECALHO = struct.Struct("<BBBBI")
+
+ESQUEMA_PADRAO = {
+    "versao": VERSAO_PACOTE,
+    "campos": ["ti", "te", "ue", "s1", "s2"],
+    "casas": [1, 1, 1, 1, 1],
+    "zonas": [],
+}
+
+
+def carregar_esquema(url):
+    if not url:
+        return ESQUEMA_PADRAO
+    with urllib.request.urlopen(url, timeout=10) as resposta:
+        esquema = json.load(resposta)
+    if esquema.get("versao") != VERSAO_PACOTE:
+        sys.exit("Versão de esquema não suportada: %s" % esquema.get("versao"))
+    return esquema
+
+
+def decodificar(dados, esquema):
+    """Decodifica um ou mais pacotes concatenados; devolve uma lista de dicts."""
+    amostras = []
+    posicao = 0
+    while posicao + CABECALHO.size <= len(dados):
+        versao, num_sensores, zona, _, epoch = CABECALHO.unpack_from(dados, posicao)
+        if versao != VERSAO_PACOTE:
+            raise ValueError("versão de pacote desconhecida: %d" % versao)
+        if num_sensores != len(esquema["campos"]):
+            raise ValueError("pacote com %d sensores, esquema com %d"
+                             % (num_sensores, len(esquema["campos"])))
+        formato = struct.Struct("<%dh" % num_sensores)
+        posicao += CABECALHO.size
+        if posicao + formato.size > len(dados):
+            raise ValueError("pacote truncado")
+        brutos = formato.unpack_from(dados, posicao)
+        posicao += formato.size
+
+        zonas = esquema.get("zonas") or []
+        amostra = {
+            "zona": zonas[zona] if zona < len(zonas) else str(zona),
+            "epoch": epoch,
+            "tempo": (datetime.fromtimestamp(epoch, timezone.utc).isoformat()
+                      if epoch else ""),
+        }
+        for campo, casas, bruto in zip(esquema["campos"], esquema["casas"], brutos):
+            amostra[campo] = None if bruto == VALOR_AUSENTE else bruto / (10 ** casas)
+        amostras.append(amostra)
+    if posicao != len(dados):
+        raise ValueError("%d bytes sobrando após o último pacote" % (len(dados) - posicao))
+    return amostras
+
+
+def gravar_csv(caminho, amostras, esquema):
+    colunas = ["zona", "epoch", "tempo"] + list(esquema["campos"])
+    novo = not os.path.exists(caminho) or os.path.getsize(caminho) == 0
+    with open(caminho, "a", newline="") as arquivo:
+        escritor = csv.DictWriter(arquivo, fieldnames=colunas)
+        if novo:
+            escritor.writeheader()
+        for amostra in amostras:
+            escritor.writerow({c: "" if amostra[c] is None else amostra[c] for c in colunas})
+
+
+def servir(args):
+    esquema = carregar_esquema(args.esquema)
+
+    class Receptor(BaseHTTPRequestHandler):
+        def do_POST(self):
+            tamanho = int(self.headers.get("Content-Length", 0))
+            dados = self.rfile.read(tamanho)
+            try:
+                amostras = decodificar(dados, esquema)
+            except ValueError as erro:
+                self.send_error(400, str(erro))
+                return
+            gravar_csv(args.csv, amostras, esquema)
+            for amostra in amostras:
+                print("📦", json.dumps(amostra, ensure_ascii=False))
+            self.send_response(204)
+            self.end_headers()
+
+        def log_message(self, formato, *valores):
+            pass
+
+    servidor = HTTPServer(("", args.porta), Receptor)
+    print("Recebendo amostras na porta %d, gravando em %s" % (args.porta, args.csv))
+    try:
+        servidor.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+def decodificar_arquivo(args):
+    esquema = carregar_esquema(args.esquema)
+    with open(args.arquivo, "rb") as arquivo:
+        for amostra in decodificar(arquivo.read(), esquema):
+            print(json.dumps(amostra, ensure_ascii=False))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Ingestão das amostras binárias do GrowMonitor")
+    parser.add_argument("--esquema", help="URL de /api/esquema do ESP32 (ex.: http://192.168.0.50/api/esquema)")
+    sub = parser.add_subparsers(dest="comando")
+    sub.required = True
+
+    p_servir = sub.add_parser("servir", help="recebe POSTs do ESP32 e grava em CSV")
+    p_servir.add_argument("--porta", type=int, default=8090)
+    p_servir.add_argument("--csv", default="medicoes.csv")
+    p_servir.set_defaults(funcao=servir)
+
+    p_decodificar = sub.add_parser("decodificar", help="decodifica um arquivo com pacotes")
+    p_decodificar.add_argument("arquivo")
+    p_decodificar.set_defaults(funcao=decodificar_arquivo)
+
+    args = parser.parse_args()
+    args.funcao(args)
+
+
+if __name__ == "__main__":
+    main()
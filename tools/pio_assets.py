@@ -0,0 +1,35 @@
+"""Hook do PlatformIO (extra_scripts = pre:tools/pio_assets.py): antes de
+"pio run -t buildfs" ou "-t uploadfs", gera na pasta de dados os assets que faltam
+rodando tools/preparar_assets.py.
+
+Respeita PLATFORMIO_DATA_DIR (ex.: a pasta do tools/bench_historico.py). Se o download
+falhar, só avisa: a imagem é gravada sem o Chart.js e a página usa o CDN.
+"""
+
+import os
+import subprocess
+import sys
+
+Import("env")  # noqa: F821 (injetado pelo PlatformIO)
+
+ALVOS_FS = {"buildfs", "uploadfs", "uploadfsota"}
+
+
+def preparar_assets():
+    pasta_tools = os.path.join(env.subst("$PROJECT_DIR"), "tools")
+    pasta_data = env.subst("$PROJECT_DATA_DIR")
+
+    sys.path.insert(0, pasta_tools)
+    from preparar_assets import ASSETS
+
+    faltando = [nome for _, nome in ASSETS if not os.path.exists(os.path.join(pasta_data, nome + ".gz"))]
+    if not faltando:
+        return
+    print("🔄 Assets ausentes em %s: %s" % (pasta_data, ", ".join(faltando)))
+    comando = [env.subst("$PYTHONEXE"), os.path.join(pasta_tools, "preparar_assets.py"), "--saida", pasta_data]
+    if subprocess.call(comando) != 0:
+        print("⚠️ Não foi possível preparar os assets: a imagem do LittleFS vai sem eles (a página usa o CDN)")
+
+
+if ALVOS_FS.intersection(COMMAND_LINE_TARGETS):  # noqa: F821
+    preparar_assets()
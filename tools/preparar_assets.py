@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Prepara a pasta data/ com os arquivos estáticos do dashboard, já comprimidos.
+
+O firmware procura "<arquivo>.gz" no LittleFS e o envia com Content-Encoding: gzip
+(ver arquivosEstaticos[] no firmware). Sem o arquivo na flash, a página carrega o
+Chart.js do CDN como antes.
+
+Uso:
+    python3 tools/preparar_assets.py                 # baixa o Chart.js e gera data/*.gz
+    python3 tools/preparar_assets.py --local chart.umd.js
+    pio run -t uploadfs                              # grava a pasta data/ no ESP32
+
+O "pio run -t buildfs/uploadfs" já roda este script pelo tools/pio_assets.py quando
+falta algum asset na pasta de dados.
+
+O gzip é gerado com mtime zero, então o mesmo conteúdo dá sempre o mesmo arquivo
+(e o mesmo ETag). Só usa a biblioteca padrão do Python.
+"""
+
+import argparse
+import gzip
+import os
+import sys
+import urllib.request
+
+PASTA_DATA = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "data"))
+
+# (origem no CDN, nome no LittleFS). A versão no nome permite cache imutável no navegador;
+# ao trocar de versão, atualize também arquivosEstaticos[] e o <script> da página.
+ASSETS = [
+    ("https://cdn.jsdelivr.net/npm/chart.js@4.4.0/dist/chart.umd.js", "chart-4.4.0.min.js"),
+]
+
+
+def gravar_gzip(conteudo, nome, pasta=PASTA_DATA):
+    destino = os.path.join(pasta, nome + ".gz")
+    with open(destino, "wb") as arquivo:
+        with gzip.GzipFile(filename="", mode="wb", fileobj=arquivo, compresslevel=9, mtime=0) as saida:
+            saida.write(conteudo)
+    tamanho = os.path.getsize(destino)
+    print("✅ %s: %d → %d bytes (%.0f%%)" % (destino, len(conteudo), tamanho, 100.0 * tamanho / len(conteudo)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Gera os arquivos estáticos comprimidos do GrowMonitor")
+    parser.add_argument("--local", help="usa este arquivo do Chart.js em vez de baixar do CDN")
+    parser.add_argument("--saida", default=PASTA_DATA, help="pasta de dados do LittleFS (padrão: data/)")
+    args = parser.parse_args()
+
+    for url, nome in ASSETS:
+        if args.local:
+            with open(args.local, "rb") as arquivo:
+                conteudo = arquivo.read()
+        else:
+            print("🔄 Baixando %s..." % url)
+            try:
+                with urllib.request.urlopen(url, timeout=30) as resposta:
+                    conteudo = resposta.read()
+            except OSError as erro:
+                sys.exit("❌ Não foi possível baixar %s: %s" % (url, erro))
+        gravar_gzip(conteudo, nome, args.saida)
+
+
+if __name__ == "__main__":
+    main()
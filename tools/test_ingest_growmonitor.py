@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Teste de ida e volta de decodificar() contra pacotes gerados pelo codificador do firmware.
+
+test/dados/pacote_amostra_v1.bin tem duas amostras codificadas por
+include/pacote_amostra.h; test/test_pacote ("pio test -e native") confere que o
+firmware gera exatamente esses bytes. Aqui o decodificador lê o mesmo arquivo,
+e os valores decodificados, codificados de novo, têm que dar os mesmos bytes.
+
+Uso:
+    python3 -m unittest discover -s tools -p "test_*.py"
+Só usa a biblioteca padrão do Python.
+"""
+
+import os
+import struct
+import unittest
+
+from ingest_growmonitor import CABECALHO, ESQUEMA_PADRAO, VALOR_AUSENTE, VERSAO_PACOTE, decodificar
+
+ARQUIVO = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "test", "dados", "pacote_amostra_v1.bin")
+ESQUEMA = dict(ESQUEMA_PADRAO, zonas=["grow1", "grow2"])
+
+# Amostras codificadas em test/test_pacote/test_main.cpp, já em ponto fixo com 1 casa
+ESPERADO = [
+    {"zona": "grow2", "epoch": 1760000000, "tempo": "2025-10-09T08:53:20+00:00",
+     "ti": 24.5, "te": -3.2, "ue": None, "s1": 33.4, "s2": 3276.7},   # s2 saturado
+    {"zona": "grow1", "epoch": 0, "tempo": "",
+     "ti": 0.0, "te": -3276.7, "ue": 100.0, "s1": 0.0, "s2": 12.3},
+]
+
+
+def codificar(amostra, esquema):
+    """Caminho inverso de decodificar(), no layout de PacoteAmostra."""
+    campos = esquema["campos"]
+    valores = [VALOR_AUSENTE if amostra[c] is None else int(round(amostra[c] * 10 ** casas))
+               for c, casas in zip(campos, esquema["casas"])]
+    zona = esquema["zonas"].index(amostra["zona"])
+    return CABECALHO.pack(VERSAO_PACOTE, len(campos), zona, 0, amostra["epoch"]) + struct.pack("<%dh" % len(campos), *valores)
+
+
+class TestDecodificar(unittest.TestCase):
+    def setUp(self):
+        with open(ARQUIVO, "rb") as arquivo:
+            self.dados = arquivo.read()
+
+    def test_pacotes_do_firmware(self):
+        amostras = decodificar(self.dados, ESQUEMA)
+        self.assertEqual(len(amostras), len(ESPERADO))
+        for amostra, esperado in zip(amostras, ESPERADO):
+            for chave, valor in esperado.items():
+                if isinstance(valor, float):
+                    self.assertAlmostEqual(amostra[chave], valor, places=6, msg=chave)
+                else:
+                    self.assertEqual(amostra[chave], valor, chave)
+
+    def test_ida_e_volta(self):
+        amostras = decodificar(self.dados, ESQUEMA)
+        self.assertEqual(b"".join(codificar(a, ESQUEMA) for a in amostras), self.dados)
+
+    def test_zona_sem_nome_no_esquema(self):
+        self.assertEqual(decodificar(self.dados, ESQUEMA_PADRAO)[0]["zona"], "1")
+
+    def test_pacotes_invalidos(self):
+        tamanho = len(self.dados) // 2
+        with self.assertRaisesRegex(ValueError, "truncado"):
+            decodificar(self.dados[:tamanho - 1], ESQUEMA)
+        with self.assertRaisesRegex(ValueError, "sobrando"):
+            decodificar(self.dados + b"\x01", ESQUEMA)
+        with self.assertRaisesRegex(ValueError, "versão"):
+            decodificar(b"\x02" + self.dados[1:tamanho], ESQUEMA)
+        with self.assertRaisesRegex(ValueError, "sensores"):
+            decodificar(self.dados[:tamanho], dict(ESQUEMA, campos=ESQUEMA["campos"][:4], casas=[1] * 4))
+
+
+if __name__ == "__main__":
+    unittest.main()